@@ -0,0 +1,138 @@
+#include "BandRefiner.h"
+#include "DataModel.h"
+#include "GraphBuilder.h"
+#include "SimdOps.h"
+#include "ThreadPool.h"
+#include "Profiler.h"
+#include <cmath>
+#include <memory>
+#include <algorithm>
+
+template <typename Cap>
+BandRefiner<Cap>::BandRefiner(SolverType solver_, int threads_, int band_, double lambda_)
+    : solver(solver_), threads(threads_), band(std::max(0, band_)), lambda(lambda_) {}
+
+template <typename Cap>
+void BandRefiner<Cap>::setHardSeeds(bool fg_hard, bool bg_hard) {
+    fgHard = fg_hard;
+    bgHard = bg_hard;
+}
+
+template <typename Cap>
+size_t BandRefiner<Cap>::refine(const Image& img, const SeedMask& seeds, std::vector<uint8_t>& labels, double* flow) {
+    Profiler::Scope scope("refineBand");
+    const int W = img.width(), H = img.height();
+    const size_t N = static_cast<size_t>(W) * H;
+
+    // 1) pixels next to a label change
+    std::vector<uint8_t> edge(N, 0);
+    for (int y = 0; y < H; ++y) {
+        for (int x = 0; x < W; ++x) {
+            const size_t p = static_cast<size_t>(y) * W + x;
+            if (x + 1 < W && labels[p] != labels[p + 1]) edge[p] = edge[p + 1] = 1;
+            if (y + 1 < H && labels[p] != labels[p + W]) edge[p] = edge[p + W] = 1;
+        }
+    }
+
+    // 2) dilate by `band` in both directions, separable running window counts
+    std::vector<uint8_t> rowHit(N, 0);
+    for (int y = 0; y < H; ++y) {
+        const uint8_t* e = &edge[static_cast<size_t>(y) * W];
+        uint8_t* o = &rowHit[static_cast<size_t>(y) * W];
+        int cnt = 0;
+        for (int x = 0; x < std::min(band, W); ++x) cnt += e[x];
+        for (int x = 0; x < W; ++x) {
+            if (x + band < W) cnt += e[x + band];
+            o[x] = cnt > 0;
+            if (x - band >= 0) cnt -= e[x - band];
+        }
+    }
+    std::vector<uint8_t>& inBand = edge;    // reuse the buffer
+    std::vector<int> colCnt(W, 0);
+    for (int y = 0; y < std::min(band, H); ++y)
+        for (int x = 0; x < W; ++x) colCnt[x] += rowHit[static_cast<size_t>(y) * W + x];
+    for (int y = 0; y < H; ++y) {
+        if (y + band < H)
+            for (int x = 0; x < W; ++x) colCnt[x] += rowHit[static_cast<size_t>(y + band) * W + x];
+        for (int x = 0; x < W; ++x) inBand[static_cast<size_t>(y) * W + x] = colCnt[x] > 0;
+        if (y - band >= 0)
+            for (int x = 0; x < W; ++x) colCnt[x] -= rowHit[static_cast<size_t>(y - band) * W + x];
+    }
+
+    // 3) seeds the coarse cut disagrees with (e.g. a scribble thinner than a coarse pixel)
+    const int8_t* seed = seeds.raw();
+    for (size_t p = 0; p < N; ++p) {
+        if ((seed[p] == 1 && labels[p] == 0) || (seed[p] == 0 && labels[p] == 1)) inBand[p] = 1;
+    }
+
+    // compact node ids for the band, source and sink go last
+    std::vector<int> id(N, -1);
+    std::vector<int> pixels;
+    for (size_t p = 0; p < N; ++p) {
+        if (inBand[p]) {
+            id[p] = static_cast<int>(pixels.size());
+            pixels.push_back(static_cast<int>(p));
+        }
+    }
+    const int n = static_cast<int>(pixels.size());
+    if (flow) *flow = 0.0;
+    if (n == 0) return 0;
+    const int source = n, sink = n + 1;
+
+    DataModel<Cap> dm(bins, 1.0, 1e-9);
+    dm.setHardSeeds(fgHard, bgHard);
+    ThreadPool pool(threads);
+    dm.buildHistograms(img, seeds, &pool);
+    dm.computeDataCosts(img, seeds, pixels);
+
+    const double neg_beta = -GraphBuilder<Cap>::computeBeta(img, nullptr, &pool);
+    auto weight = [&](int x0, int y0, int x1, int y1) {
+        const double diff = simd::colorDistSq(img.getColor(x0, y0), img.getColor(x1, y1));
+        return CapacityTraits<Cap>::quantize(lambda * std::exp(neg_beta * diff));
+    };
+
+    // t-links first (with the folded n-links), then the n-links inside the band
+    std::unique_ptr<MaxFlow<Cap>> G = makeMaxFlow<Cap>(solver, n + 2, threads);
+    G->reserve_edges(static_cast<size_t>(n) * 4);
+    const int dx[4] = {1, -1, 0, 0};
+    const int dy[4] = {0, 0, 1, -1};
+    for (int k = 0; k < n; ++k) {
+        const int p = pixels[k];
+        const int x = p % W, y = p / W;
+        Cap capS = dm.getDpBG(x, y);
+        Cap capT = dm.getDpFG(x, y);
+        for (int d = 0; d < 4; ++d) {
+            const int qx = x + dx[d], qy = y + dy[d];
+            if (qx < 0 || qx >= W || qy < 0 || qy >= H) continue;
+            const size_t q = static_cast<size_t>(qy) * W + qx;
+            if (inBand[q]) continue;
+            // fixed foreground neighbour: the edge is cut if p goes to the background
+            if (labels[q]) capS += weight(x, y, qx, qy);
+            else capT += weight(x, y, qx, qy);
+        }
+        G->add_edge(source, k, capS);
+        G->add_edge(k, sink, capT);
+    }
+    for (int k = 0; k < n; ++k) {
+        const int p = pixels[k];
+        const int x = p % W, y = p / W;
+        if (x + 1 < W && inBand[p + 1]) {
+            const Cap w = weight(x, y, x + 1, y);
+            G->add_edge(k, id[p + 1], w, w);
+        }
+        if (y + 1 < H && inBand[static_cast<size_t>(p) + W]) {
+            const Cap w = weight(x, y, x, y + 1);
+            G->add_edge(k, id[static_cast<size_t>(p) + W], w, w);
+        }
+    }
+
+    const double f = G->max_flow(source, sink);
+    if (flow) *flow = f;
+    const std::vector<bool> cut = G->minCut(source);
+    for (int k = 0; k < n; ++k) labels[pixels[k]] = cut[k] ? 1 : 0;
+    return static_cast<size_t>(n);
+}
+
+template class BandRefiner<double>;
+template class BandRefiner<float>;
+template class BandRefiner<int32_t>;
@@ -0,0 +1,39 @@
+#pragma once
+#include "Image.h"
+#include "SeedMask.h"
+#include "MaxFlow.h"
+#include <vector>
+#include <cstdint>
+
+/*
+Pixel level re-solve of a narrow band around the boundary of a coarse labelling, the last
+step of the pyramid (--levels) and superpixel (--superpixels) modes:
+- band = every pixel within `band` pixels (chessboard distance) of a label change,
+  plus seeded pixels the coarse labelling got wrong
+- pixels outside the band keep their coarse label. An n-link from a band pixel to such a
+  fixed pixel can only be cut one way, so it is folded into the t-link of the band pixel
+  (the fixed pixel acts like a hard terminal)
+- the band graph is solved with the selected engine and its cut overwrites the band
+*/
+template <typename Cap>
+class BandRefiner {
+public:
+    BandRefiner(SolverType solver = SolverType::Dinic, int threads = 0, int band = 4, double lambda = 50.0);
+
+    // same meaning as DataModel::setHardSeeds
+    void setHardSeeds(bool fg_hard, bool bg_hard);
+    // colour histogram bins per channel (8, 16 or 32), see DataModel::setBins
+    void setBins(int binsPerChannel) { bins = binsPerChannel; }
+
+    // labels: 0/1 per pixel, in = coarse guess, out = refined cut.
+    // Returns the number of pixels in the band graph, its max-flow goes to *flow
+    size_t refine(const Image& img, const SeedMask& seeds, std::vector<uint8_t>& labels, double* flow = nullptr);
+
+private:
+    SolverType solver;
+    int threads;
+    int band;
+    double lambda;
+    bool fgHard = true, bgHard = true;
+    int bins = 8;
+};
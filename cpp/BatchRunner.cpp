@@ -0,0 +1,192 @@
+#include "BatchRunner.h"
+#include "SegmentationContext.h"
+#include "Profiler.h"
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <thread>
+#include <stdexcept>
+#include <algorithm>
+
+template <typename Cap>
+std::vector<typename BatchRunner<Cap>::Job> BatchRunner<Cap>::parseManifest(const std::string& path) {
+    std::ifstream in(path);
+    if (!in) throw std::runtime_error("Batch: failed to open manifest " + path);
+
+    std::vector<Job> jobs;
+    std::string text;
+    for (size_t line = 1; std::getline(in, text); ++line) {
+        std::istringstream ss(text);
+        std::vector<std::string> f;
+        for (std::string tok; ss >> tok;) f.push_back(tok);
+        if (f.empty() || f[0][0] == '#') continue;
+
+        auto bad = [&](const std::string& why) {
+            return std::runtime_error("Batch: manifest line " + std::to_string(line) + ": " + why);
+        };
+        Job job;
+        job.line = line;
+        if (f.size() < 6) throw bad("expected image W H mask|rect ...");
+        job.image = f[0];
+        job.W = std::atoi(f[1].c_str());
+        job.H = std::atoi(f[2].c_str());
+        if (job.W <= 0 || job.H <= 0) throw bad("width and height must be positive");
+        if (f[3] == "mask") {
+            if (f.size() != 6) throw bad("mask jobs are: image W H mask seed.bin out_mask.bin");
+            job.seeds = f[4];
+            job.output = f[5];
+        }
+        else if (f[3] == "rect") {
+            if (f.size() != 9) throw bad("rect jobs are: image W H rect x0 y0 x1 y1 out_mask.bin");
+            job.rect = true;
+            job.x0 = std::atoi(f[4].c_str());
+            job.y0 = std::atoi(f[5].c_str());
+            job.x1 = std::atoi(f[6].c_str());
+            job.y1 = std::atoi(f[7].c_str());
+            job.output = f[8];
+        }
+        else throw bad("unknown seed mode " + f[3]);
+        jobs.push_back(std::move(job));
+    }
+    return jobs;
+}
+
+template <typename Cap>
+BatchRunner<Cap>::BatchRunner(SolverType solver_, int workers_, int prefetch_, double lambda_)
+    : solver(solver_), workers(workers_ > 0 ? workers_ : ThreadPool::defaultThreads()),
+      prefetch(prefetch_ > 0 ? prefetch_ : 2 * (workers_ > 0 ? workers_ : ThreadPool::defaultThreads())),
+      lambda(lambda_) {}
+
+template <typename Cap>
+const std::vector<typename BatchRunner<Cap>::Result>& BatchRunner<Cap>::run(const std::vector<Job>& jobs) {
+    results.assign(jobs.size(), Result());
+    queues.clear();
+    for (int w = 0; w < workers; ++w) queues.emplace_back(new WorkQueue());
+    queued = 0;
+    loaderDone = false;
+
+    std::thread loader([&] { loadAll(jobs); });
+    std::vector<std::thread> pool;
+    for (int w = 1; w < workers; ++w) pool.emplace_back([this, &jobs, w] { work(jobs, w); });
+    work(jobs, 0);
+    for (std::thread& t : pool) t.join();
+    loader.join();
+    return results;
+}
+
+template <typename Cap>
+void BatchRunner<Cap>::loadAll(const std::vector<Job>& jobs) {
+    for (size_t i = 0; i < jobs.size(); ++i) {
+        {
+            std::unique_lock<std::mutex> lock(m);
+            cv.wait(lock, [&] { return queued < static_cast<size_t>(prefetch); });
+        }
+
+        const Job& job = jobs[i];
+        Loaded item{i, nullptr, nullptr, std::string()};
+        const auto t0 = std::chrono::steady_clock::now();
+        Profiler::Scope scope("load");
+        try {
+            item.image.reset(new Image(job.image, job.W, job.H, 3));
+            if (job.rect) item.seeds.reset(new SeedMask(job.W, job.H, job.x0, job.y0, job.x1, job.y1));
+            else item.seeds.reset(new SeedMask(job.seeds, job.W, job.H));
+        } catch (const std::exception& e) {
+            item.error = e.what();
+        }
+        results[i].loadMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+
+        {
+            WorkQueue& q = *queues[i % workers];
+            std::lock_guard<std::mutex> lock(q.m);
+            q.jobs.push_back(std::move(item));
+        }
+        {
+            std::lock_guard<std::mutex> lock(m);
+            ++queued;
+        }
+        cv.notify_all();
+    }
+    {
+        std::lock_guard<std::mutex> lock(m);
+        loaderDone = true;
+    }
+    cv.notify_all();
+}
+
+// own deque first (front), then the others (back)
+template <typename Cap>
+bool BatchRunner<Cap>::take(int w, Loaded& out) {
+    for (int k = 0; k < workers; ++k) {
+        WorkQueue& q = *queues[(w + k) % workers];
+        std::lock_guard<std::mutex> lock(q.m);
+        if (q.jobs.empty()) continue;
+        if (k == 0) {
+            out = std::move(q.jobs.front());
+            q.jobs.pop_front();
+        } else {
+            out = std::move(q.jobs.back());
+            q.jobs.pop_back();
+        }
+        return true;
+    }
+    return false;
+}
+
+template <typename Cap>
+void BatchRunner<Cap>::work(const std::vector<Job>& jobs, int w) {
+    // reused from job to job
+    SegmentationContext<Cap> ctx(solver, 1, lambda);
+    ctx.setReduction(reduce, cropMargin);
+    ctx.setHugePages(hugePages);
+    ctx.setBins(bins);
+    std::vector<uint8_t> mask;
+
+    while (true) {
+        Loaded item{0, nullptr, nullptr, std::string()};
+        if (!take(w, item)) {
+            std::unique_lock<std::mutex> lock(m);
+            cv.wait(lock, [&] { return queued > 0 || loaderDone; });
+            if (queued == 0 && loaderDone) return;
+            continue;
+        }
+        {
+            std::lock_guard<std::mutex> lock(m);
+            --queued;
+        }
+        cv.notify_all();    // room for the loader
+
+        Result& res = results[item.index];
+        res.worker = w;
+        if (!item.error.empty()) {
+            res.error = item.error;
+            continue;
+        }
+
+        const auto t0 = std::chrono::steady_clock::now();
+        Profiler::Scope scope("job");
+        try {
+            const Image& img = *item.image;
+            const SeedMask& seeds = *item.seeds;
+            const int W = img.width(), H = img.height();
+            res.flow = ctx.segment(img, seeds);
+            const std::vector<bool>& cut = ctx.mask();
+
+            const size_t N = static_cast<size_t>(W) * H;
+            size_t fg = 0;
+            for (size_t i = 0; i < N; ++i) fg += cut[i];
+            MaskEncoder::encode(cut, W, H, maskFormat, mask);
+            MaskEncoder::writeBuffer(mask, jobs[item.index].output);
+
+            res.foreground = fg;
+            res.reservedBytes = ctx.reservedBytes();
+            res.ok = true;
+        } catch (const std::exception& e) {
+            res.error = e.what();
+        }
+        res.computeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+    }
+}
+
+template class BatchRunner<double>;
+template class BatchRunner<float>;
+template class BatchRunner<int32_t>;
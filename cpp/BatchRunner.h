@@ -0,0 +1,114 @@
+#pragma once
+#include "Image.h"
+#include "SeedMask.h"
+#include "MaxFlow.h"
+#include "MaskEncoder.h"
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+
+/*
+segment --batch manifest.txt: many image/seed pairs in one process, so offline jobs are
+not bounded by process startup and one job at a time.
+
+Manifest: one job per line, the same positional arguments as a single run
+  image.bin W H mask seed.bin out_mask.bin
+  image.bin W H rect x0 y0 x1 y1 out_mask.bin
+Empty lines and lines starting with '#' are skipped.
+
+Pipeline:
+- one loader thread maps the inputs of upcoming jobs (Image / SeedMask are memory mapped
+  with readahead, so the disk works while the workers compute), at most `prefetch` loaded
+  jobs wait at any time
+- loaded jobs are dealt round robin onto one deque per worker. A worker takes from the
+  front of its own deque and steals from the back of the others when it runs dry, so a
+  few slow jobs do not leave the other workers idle
+- every job runs single threaded (the parallelism is across jobs), each worker keeps a
+  SegmentationContext and mask buffer from one job to the next, so after its largest
+  image a worker no longer allocates for the pipeline
+The masks are written in the format set with setMaskFormat (bytes unless told otherwise).
+A failing job (missing file, bad size) is reported in its result and the batch goes on.
+*/
+template <typename Cap>
+class BatchRunner {
+public:
+    struct Job {
+        size_t line = 0;            // manifest line, for messages
+        std::string image, seeds, output;
+        int W = 0, H = 0;
+        bool rect = false;
+        int x0 = 0, y0 = 0, x1 = 0, y1 = 0;
+    };
+
+    struct Result {
+        bool ok = false;
+        std::string error;
+        double flow = 0.0;
+        size_t foreground = 0;      // pixels on the source side
+        double loadMs = 0.0;        // mapping the inputs (loader thread)
+        double computeMs = 0.0;     // histograms .. mask written (worker)
+        size_t reservedBytes = 0;   // held by the worker's context after this job
+        int worker = -1;
+    };
+
+    // throws std::runtime_error naming the line of the first malformed entry
+    static std::vector<Job> parseManifest(const std::string& path);
+
+    // workers: 0 = one per hardware thread, prefetch: 0 = two jobs per worker
+    BatchRunner(SolverType solver, int workers = 0, int prefetch = 0, double lambda = 50.0);
+
+    // runs every job and returns the results in manifest order
+    const std::vector<Result>& run(const std::vector<Job>& jobs);
+
+    int workerCount() const { return workers; }
+
+    // output format of every job's mask, see MaskEncoder.h
+    void setMaskFormat(MaskFormat format) { maskFormat = format; }
+
+    // solve the reduced graph (GraphBuilder::buildReducedGraph, on by default) or the full one
+    void setReduction(bool enabled, int margin = 0) { reduce = enabled; cropMargin = margin; }
+
+    // allocate the workers' buffers with transparent huge pages, see HugePages.h
+    void setHugePages(bool on) { hugePages = on; }
+
+    // colour histogram bins per channel (8, 16 or 32), see DataModel::setBins
+    void setBins(int binsPerChannel) { bins = binsPerChannel; }
+
+private:
+    struct Loaded {
+        size_t index;
+        std::unique_ptr<Image> image;
+        std::unique_ptr<SeedMask> seeds;
+        std::string error;          // set if loading failed
+    };
+    struct WorkQueue {
+        std::mutex m;
+        std::deque<Loaded> jobs;
+    };
+
+    SolverType solver;
+    int workers;
+    int prefetch;
+    double lambda;
+    MaskFormat maskFormat = MaskFormat::Bytes;
+    bool reduce = true;
+    int cropMargin = 0;
+    bool hugePages = false;
+    int bins = 8;
+
+    std::vector<Result> results;
+    std::vector<std::unique_ptr<WorkQueue>> queues;
+    std::mutex m;
+    std::condition_variable cv;
+    size_t queued = 0;              // loaded, not yet taken by a worker
+    bool loaderDone = false;
+
+    void loadAll(const std::vector<Job>& jobs);
+    void work(const std::vector<Job>& jobs, int w);
+    bool take(int w, Loaded& out);
+};
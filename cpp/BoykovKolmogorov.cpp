@@ -0,0 +1,507 @@
+#include "BoykovKolmogorov.h"
+#include "Profiler.h"
+#include "HugePages.h"
+#include <algorithm>
+#include <limits>
+#include <cstdint>
+#include <stdexcept>
+
+template <typename Cap>
+BoykovKolmogorov<Cap>::BoykovKolmogorov(int n_)
+    : n(n_), g(n_), tr(n_, 0), parent(n_, NO_PARENT),
+      isSink(n_, 0), ts(n_, 0), dist(n_, 0), inQueue(n_, 0), isChanged(n_, 0) {}
+
+template <typename Cap>
+void BoykovKolmogorov<Cap>::reset(int n_) {
+    n = n_;
+    const bool huge = this->hugePages;
+    g.hugePages = huge;
+    g.reset(n_);
+    HugePages::assign(tr, n_, Cap(0), huge);
+    HugePages::assign(parent, n_, int(NO_PARENT), huge);
+    HugePages::assign(isSink, n_, char(0), huge);
+    HugePages::assign(ts, n_, 0, huge);
+    HugePages::assign(dist, n_, 0, huge);
+    HugePages::assign(inQueue, n_, char(0), huge);
+    HugePages::assign(isChanged, n_, char(0), huge);
+    active.clear();
+    orphans.clear();
+    changed.clear();
+    time = 0;
+    source = sink = -1;
+    flow = 0;
+    solved = false;
+}
+
+template <typename Cap>
+void BoykovKolmogorov<Cap>::add_edge(int u, int v, Cap cap, Cap rev_cap) {
+    g.add_edge(u, v, cap, rev_cap);
+}
+
+template <typename Cap>
+void BoykovKolmogorov<Cap>::reserve_edges(size_t m) {
+    g.reserve_edges(m);
+}
+
+template <typename Cap>
+void BoykovKolmogorov<Cap>::add_grid_edges(int W, int H, const Cap* capS, const Cap* capT,
+                             const Cap* right, const Cap* down, ThreadPool& pool) {
+    g.add_grid_edges(W, H, capS, capT, right, down, pool);
+}
+
+/* Same bookkeeping as the maxflow library's add_tweights: the part both edges have in
+   common is pushed right away, only the difference stays in tr[v]. Negative values
+   work too, they simply take back flow (the flow value goes down by the same amount). */
+template <typename Cap>
+void BoykovKolmogorov<Cap>::add_tweights(int v, Cap capSource, Cap capSink) {
+    const Cap delta = tr[v];
+    if (delta > 0) capSource += delta;
+    else capSink -= delta;
+    flow += std::min(capSource, capSink);
+    tr[v] = capSource - capSink;
+    markChanged(v);
+}
+
+template <typename Cap>
+void BoykovKolmogorov<Cap>::markChanged(int v) {
+    if (solved && !isChanged[v]) {
+        isChanged[v] = 1;
+        changed.push_back(v);
+    }
+}
+
+/* With flow f on u -> v (residuals c - f and c + f) the new residuals are c' - f and c' + f.
+   If c' < f the surplus e = f - c' is taken back: u keeps e it can no longer send, which
+   goes back to the source (tr[u] += e), v misses e it already passed on, which goes back
+   to the sink (tr[v] -= e), and the flow value drops by e. */
+template <typename Cap>
+void BoykovKolmogorov<Cap>::add_nweights(int u, int v, Cap delta) {
+    int a = g.begin(u);
+    while (a < g.end(u) && g.head[a] != v) ++a;
+    if (a == g.end(u)) throw std::runtime_error("BoykovKolmogorov: no edge between the nodes");
+    const int b = g.sister[a];
+
+    g.cap[a] += delta;
+    g.cap[b] += delta;
+    if (g.cap[a] < 0) {
+        const Cap e = -g.cap[a];
+        g.cap[a] = 0;
+        g.cap[b] -= e;
+        add_tweights(u, e, 0);
+        add_tweights(v, 0, e);
+        flow -= e;
+    } else if (g.cap[b] < 0) {
+        const Cap e = -g.cap[b];
+        g.cap[b] = 0;
+        g.cap[a] -= e;
+        add_tweights(v, e, 0);
+        add_tweights(u, 0, e);
+        flow -= e;
+    }
+    markChanged(u);
+    markChanged(v);
+}
+
+template <typename Cap>
+bool BoykovKolmogorov<Cap>::parentArcResidual(int v) const {
+    const int a = parent[v];
+    return isSink[v] ? g.cap[a] > 0 : g.cap[g.sister[a]] > 0;
+}
+
+template <typename Cap>
+void BoykovKolmogorov<Cap>::setActive(int v) {
+    if (!inQueue[v]) {
+        inQueue[v] = 1;
+        active.push_back(v);
+    }
+}
+
+// pop active nodes until we find one that still belongs to a tree
+template <typename Cap>
+int BoykovKolmogorov<Cap>::nextActive() {
+    while (!active.empty()) {
+        int v = active.front();
+        active.pop_front();
+        inQueue[v] = 0;
+        if (parent[v] != NO_PARENT) return v;
+    }
+    return -1;
+}
+
+/* Move every source->v and v->sink edge into tr[v].
+   If a node has both, the common part min(capS, capT) can be pushed straight away.
+   Arcs to the terminals stay in the CSR ranges with zero capacity and are skipped
+   during the search. */
+template <typename Cap>
+void BoykovKolmogorov<Cap>::foldTerminalEdges() {
+    for (int a = g.begin(source); a < g.end(source); ++a) {
+        const int v = g.head[a];
+        if (v == sink) flow += g.cap[a];
+        else tr[v] += g.cap[a];
+        g.cap[a] = 0;
+    }
+    for (int a = g.begin(sink); a < g.end(sink); ++a) {
+        const int v = g.head[a];
+        if (v == source) continue;
+        const int b = g.sister[a];      // v -> sink
+        const Cap c = g.cap[b];
+        if (c <= 0) continue;
+        if (tr[v] > 0) flow += std::min(tr[v], c);
+        tr[v] -= c;
+        g.cap[b] = 0;
+    }
+}
+
+/* middle is the arc that connects the two trees (its tail is in S, its head in T).
+   Find the bottleneck along source -> ... -> middle -> ... -> sink, push it and turn
+   every node whose parent arc got saturated into an orphan. */
+template <typename Cap>
+void BoykovKolmogorov<Cap>::augment(int middle) {
+    Cap bottleneck = g.cap[middle];
+    uint64_t length = 1;
+
+    // source side: flow runs from parent to child, so the child's arc pair matters
+    for (int v = g.head[g.sister[middle]]; ; ) {
+        const int a = parent[v];
+        if (a == TERMINAL) { bottleneck = std::min(bottleneck, tr[v]); break; }
+        bottleneck = std::min(bottleneck, g.cap[g.sister[a]]);
+        v = g.head[a];
+        ++length;
+    }
+    // sink side: flow runs from child to parent
+    for (int v = g.head[middle]; ; ) {
+        const int a = parent[v];
+        if (a == TERMINAL) { bottleneck = std::min(bottleneck, -tr[v]); break; }
+        bottleneck = std::min(bottleneck, g.cap[a]);
+        v = g.head[a];
+        ++length;
+    }
+
+    g.cap[middle] -= bottleneck;
+    g.cap[g.sister[middle]] += bottleneck;
+
+    for (int v = g.head[g.sister[middle]]; ; ) {
+        const int a = parent[v];
+        if (a == TERMINAL) {
+            tr[v] -= bottleneck;
+            if (tr[v] <= 0) { parent[v] = ORPHAN; orphans.push_front(v); }
+            break;
+        }
+        g.cap[a] += bottleneck;
+        g.cap[g.sister[a]] -= bottleneck;
+        if (g.cap[g.sister[a]] <= 0) { parent[v] = ORPHAN; orphans.push_front(v); }
+        v = g.head[a];
+    }
+    for (int v = g.head[middle]; ; ) {
+        const int a = parent[v];
+        if (a == TERMINAL) {
+            tr[v] += bottleneck;
+            if (tr[v] >= 0) { parent[v] = ORPHAN; orphans.push_front(v); }
+            break;
+        }
+        g.cap[g.sister[a]] += bottleneck;
+        g.cap[a] -= bottleneck;
+        if (g.cap[a] <= 0) { parent[v] = ORPHAN; orphans.push_front(v); }
+        v = g.head[a];
+    }
+
+    flow += bottleneck;
+    ++this->counters.augmentations;
+    this->counters.pathArcs += length;
+}
+
+/* Try to re-attach an orphan of the source tree to another source tree node.
+   A candidate parent j is only valid if its own parent chain reaches the source
+   (not another orphan). Among valid candidates we pick the one closest to the source.
+   The timestamps cache the distances we already verified during this round. */
+template <typename Cap>
+void BoykovKolmogorov<Cap>::adoptSource(int v) {
+    const int INF_D = std::numeric_limits<int>::max();
+    int bestArc = NO_PARENT;
+    int bestDist = INF_D;
+
+    for (int a0 = g.begin(v); a0 < g.end(v); ++a0) {
+        if (g.cap[g.sister[a0]] <= 0) continue;
+        const int j = g.head[a0];
+        if (isTerminalNode(j) || isSink[j] || parent[j] == NO_PARENT) continue;
+
+        int d = 0;
+        int k = j;
+        while (true) {
+            if (ts[k] == time) { d += dist[k]; break; }
+            const int a = parent[k];
+            ++d;
+            if (a == TERMINAL) { ts[k] = time; dist[k] = 1; break; }
+            if (a == ORPHAN) { d = INF_D; break; }
+            k = g.head[a];
+        }
+        if (d < INF_D) {
+            if (d < bestDist) { bestArc = a0; bestDist = d; }
+            for (k = j; ts[k] != time; k = g.head[parent[k]]) {
+                ts[k] = time;
+                dist[k] = d--;
+            }
+        }
+    }
+
+    if (bestArc != NO_PARENT) {
+        parent[v] = bestArc;
+        ts[v] = time;
+        dist[v] = bestDist + 1;
+        return;
+    }
+
+    // no parent found: v becomes free, its children become orphans and
+    // neighbours that could reach v again are reactivated
+    for (int a0 = g.begin(v); a0 < g.end(v); ++a0) {
+        const int j = g.head[a0];
+        if (isTerminalNode(j) || isSink[j]) continue;
+        const int a = parent[j];
+        if (a == NO_PARENT) continue;
+        if (g.cap[g.sister[a0]] > 0) setActive(j);
+        if (a != TERMINAL && a != ORPHAN && g.head[a] == v) {
+            parent[j] = ORPHAN;
+            orphans.push_back(j);
+        }
+    }
+    parent[v] = NO_PARENT;
+}
+
+// mirror image of adoptSource for the sink tree (arc directions flipped)
+template <typename Cap>
+void BoykovKolmogorov<Cap>::adoptSink(int v) {
+    const int INF_D = std::numeric_limits<int>::max();
+    int bestArc = NO_PARENT;
+    int bestDist = INF_D;
+
+    for (int a0 = g.begin(v); a0 < g.end(v); ++a0) {
+        if (g.cap[a0] <= 0) continue;
+        const int j = g.head[a0];
+        if (isTerminalNode(j) || !isSink[j] || parent[j] == NO_PARENT) continue;
+
+        int d = 0;
+        int k = j;
+        while (true) {
+            if (ts[k] == time) { d += dist[k]; break; }
+            const int a = parent[k];
+            ++d;
+            if (a == TERMINAL) { ts[k] = time; dist[k] = 1; break; }
+            if (a == ORPHAN) { d = INF_D; break; }
+            k = g.head[a];
+        }
+        if (d < INF_D) {
+            if (d < bestDist) { bestArc = a0; bestDist = d; }
+            for (k = j; ts[k] != time; k = g.head[parent[k]]) {
+                ts[k] = time;
+                dist[k] = d--;
+            }
+        }
+    }
+
+    if (bestArc != NO_PARENT) {
+        parent[v] = bestArc;
+        ts[v] = time;
+        dist[v] = bestDist + 1;
+        return;
+    }
+
+    for (int a0 = g.begin(v); a0 < g.end(v); ++a0) {
+        const int j = g.head[a0];
+        if (isTerminalNode(j) || !isSink[j]) continue;
+        const int a = parent[j];
+        if (a == NO_PARENT) continue;
+        if (g.cap[a0] > 0) setActive(j);
+        if (a != TERMINAL && a != ORPHAN && g.head[a] == v) {
+            parent[j] = ORPHAN;
+            orphans.push_back(j);
+        }
+    }
+    parent[v] = NO_PARENT;
+}
+
+template <typename Cap>
+void BoykovKolmogorov<Cap>::adoptOrphans() {
+    while (!orphans.empty()) {
+        const int v = orphans.front();
+        orphans.pop_front();
+        if (parent[v] != ORPHAN) continue;     // re-attached in the meantime (reuseTrees)
+        ++this->counters.orphans;
+        if (isSink[v]) adoptSink(v);
+        else adoptSource(v);
+    }
+}
+
+/* Bring the trees of the previous max_flow in line with the changed t-links and n-links
+   (the reuse init of Kolmogorov's maxflow library).
+   - a node with source residual now belongs to the source tree, attached to the terminal.
+     If it was in the sink tree, its sink children lose their parent, and sink tree
+     neighbours it has residual towards are activated: they now border the source tree and
+     may have been passive since the last run (once v is freed again nobody else would look)
+   - the same for the sink side
+   - a node whose terminal edge became empty is an orphan
+   - a node next to a changed n-link whose parent arc has no residual left is an orphan
+   Every changed node that still has a parent after the adoption is activated so the growth
+   stage looks at its neighbours again.
+   All of this is proportional to the number of changed nodes and the orphans they create. */
+template <typename Cap>
+void BoykovKolmogorov<Cap>::reuseTrees() {
+    ++time;
+    for (const int v : changed) {
+        isChanged[v] = 0;
+        if (tr[v] != 0) {
+            const char toSink = tr[v] < 0 ? 1 : 0;
+            if (parent[v] != NO_PARENT && isSink[v] != toSink) {
+                // v switches trees: orphan its children, wake up the old tree around it
+                for (int a0 = g.begin(v); a0 < g.end(v); ++a0) {
+                    const int j = g.head[a0];
+                    if (isTerminalNode(j) || parent[j] == NO_PARENT || isSink[j] != isSink[v]) continue;
+                    const int a = parent[j];
+                    if (a >= 0 && g.head[a] == v) {
+                        parent[j] = ORPHAN;
+                        orphans.push_back(j);
+                    }
+                    // residual j -> v (old source tree) or v -> j (old sink tree)
+                    if (isSink[v] ? g.cap[a0] > 0 : g.cap[g.sister[a0]] > 0) setActive(j);
+                }
+            }
+            isSink[v] = toSink;
+            parent[v] = TERMINAL;
+            ts[v] = time;
+            dist[v] = 1;
+        } else if (parent[v] == TERMINAL) {
+            parent[v] = ORPHAN;
+            orphans.push_back(v);
+        } else if (parent[v] >= 0) {
+            // an n-link next to v changed: the arc to its parent may be gone
+            if (!parentArcResidual(v)) {
+                parent[v] = ORPHAN;
+                orphans.push_back(v);
+            }
+        }
+    }
+    adoptOrphans();
+    for (const int v : changed)
+        if (parent[v] != NO_PARENT) setActive(v);
+    changed.clear();
+}
+
+/* Main loop:
+   1. growth: take an active node and grow its tree into free neighbours until an
+      arc into the other tree is found
+   2. augmentation: push flow along the found path
+   3. adoption: repair the trees by re-attaching the orphans
+   Stops when no active node is left, i.e. the trees are separated by saturated arcs. */
+template <typename Cap>
+double BoykovKolmogorov<Cap>::max_flow(int s, int t) {
+    Profiler::Scope scope("max_flow");
+    this->counters = SolverStats();
+    source = s;
+    sink = t;
+
+    if (solved) {
+        // incremental call: residual graph and trees are kept, only fix the changed nodes
+        reuseTrees();
+    } else {
+        g.finalize();
+        foldTerminalEdges();
+
+        active.clear();
+        orphans.clear();
+        std::fill(inQueue.begin(), inQueue.end(), 0);
+        time = 0;
+
+        for (int v = 0; v < n; ++v) {
+            ts[v] = 0;
+            if (isTerminalNode(v)) { parent[v] = NO_PARENT; continue; }
+            if (tr[v] > 0) {
+                isSink[v] = 0; parent[v] = TERMINAL; dist[v] = 1; setActive(v);
+            } else if (tr[v] < 0) {
+                isSink[v] = 1; parent[v] = TERMINAL; dist[v] = 1; setActive(v);
+            } else {
+                parent[v] = NO_PARENT;
+            }
+        }
+        solved = true;
+    }
+
+    uint64_t steps = 0;
+    int current = -1;
+    while (true) {
+        int i = current;
+        if (i != -1 && parent[i] == NO_PARENT) i = -1;
+        if (i == -1) {
+            i = nextActive();
+            if (i == -1) break;
+        }
+
+        int middle = -1;
+        if (!isSink[i]) {
+            for (int a = g.begin(i); a < g.end(i); ++a) {
+                if (g.cap[a] <= 0) continue;
+                const int j = g.head[a];
+                if (isTerminalNode(j)) continue;
+                if (parent[j] == NO_PARENT) {
+                    isSink[j] = 0; parent[j] = g.sister[a];
+                    ts[j] = ts[i]; dist[j] = dist[i] + 1;
+                    setActive(j);
+                } else if (isSink[j]) {
+                    middle = a;
+                    break;
+                } else if (ts[j] <= ts[i] && dist[j] > dist[i]) {
+                    // j is in our tree too but i offers a shorter path to the source
+                    parent[j] = g.sister[a];
+                    ts[j] = ts[i]; dist[j] = dist[i] + 1;
+                }
+            }
+        } else {
+            for (int a = g.begin(i); a < g.end(i); ++a) {
+                if (g.cap[g.sister[a]] <= 0) continue;
+                const int j = g.head[a];
+                if (isTerminalNode(j)) continue;
+                if (parent[j] == NO_PARENT) {
+                    isSink[j] = 1; parent[j] = g.sister[a];
+                    ts[j] = ts[i]; dist[j] = dist[i] + 1;
+                    setActive(j);
+                } else if (!isSink[j]) {
+                    middle = g.sister[a];
+                    break;
+                } else if (ts[j] <= ts[i] && dist[j] > dist[i]) {
+                    parent[j] = g.sister[a];
+                    ts[j] = ts[i]; dist[j] = dist[i] + 1;
+                }
+            }
+        }
+
+        ++time;
+        ++steps;
+        if (middle != -1) {
+            // i may still have more paths, keep it as the current node
+            current = i;
+            augment(middle);
+            adoptOrphans();
+        } else {
+            current = -1;
+        }
+    }
+    this->counters.phases = steps;
+    this->reportStats("bk", n, g.numArcs(), g.bytes() + n * (sizeof(Cap) + 3 * sizeof(int) + 2)
+        + changed.capacity() * sizeof(int) + isChanged.capacity());
+    return Traits::toCost(flow);
+}
+
+/* The source tree at termination is exactly the set of nodes reachable from the
+   source in the residual graph, free nodes belong to the sink side. */
+template <typename Cap>
+void BoykovKolmogorov<Cap>::minCut(int s, std::vector<bool>& seen) const {
+    Profiler::Scope scope("minCut");
+    seen.assign(n, false);
+    for (int v = 0; v < n; ++v) {
+        if (isTerminalNode(v)) continue;
+        if (parent[v] != NO_PARENT && !isSink[v]) seen[v] = true;
+    }
+    seen[s] = true;
+}
+
+template class BoykovKolmogorov<double>;
+template class BoykovKolmogorov<float>;
+template class BoykovKolmogorov<int32_t>;
@@ -0,0 +1,83 @@
+#pragma once
+#include "MaxFlow.h"
+#include "FlowGraph.h"
+#include <vector>
+#include "RingDeque.h"
+
+/* Boykov-Kolmogorov max-flow ("An Experimental Comparison of Min-Cut/Max-Flow
+   Algorithms for Energy Minimization in Vision", PAMI 2004).
+
+   Instead of rebuilding a level graph from scratch every phase like Dinic, we grow
+   two search trees (one from the source, one from the sink) and keep them alive
+   across augmentations. After an augmentation only the nodes whose parent edge got
+   saturated become orphans, and we try to re-attach (adopt) them to the same tree
+   before falling back to growing again. On grid graphs from vision this touches
+   far fewer nodes than a full BFS per phase.
+
+   Edges to/from the source and sink are folded into a single signed terminal
+   capacity per node (tr > 0: residual from source, tr < 0: residual to sink).
+
+   The trees and the residual graph survive max_flow, so after add_tweights on a few nodes
+   the next max_flow only repairs the trees around those nodes (see reuseTrees). */
+template <typename Cap>
+class BoykovKolmogorov : public MaxFlow<Cap> {
+public:
+    using Traits = CapacityTraits<Cap>;
+    using Sum = typename Traits::Sum;
+
+    int n;
+
+    BoykovKolmogorov(int n = 0);
+    void add_edge(int u, int v, Cap cap, Cap rev_cap = Cap(0)) override;
+    void reserve_edges(size_t m) override;
+    void add_grid_edges(int W, int H, const Cap* capS, const Cap* capT,
+                        const Cap* right, const Cap* down, ThreadPool& pool) override;
+    double max_flow(int s, int t) override;
+    using MaxFlow<Cap>::minCut;
+    void minCut(int s, std::vector<bool>& seen) const override;
+    void reset(int n) override;
+
+    bool supportsIncremental() const override { return true; }
+    void add_tweights(int v, Cap capSource, Cap capSink) override;
+    void add_nweights(int u, int v, Cap delta) override;
+
+private:
+    // special values for parent[]
+    static constexpr int NO_PARENT = -1;   // free node (in no tree)
+    static constexpr int TERMINAL  = -2;   // attached directly to source/sink
+    static constexpr int ORPHAN    = -3;   // lost its parent, waiting for adoption
+
+    // residual graph (arcs, sister arcs and residual capacities)
+    FlowGraph<Cap> g;
+
+    std::vector<Cap> tr;        // signed terminal residual capacity
+    std::vector<int> parent;    // arc from node to its parent in the tree
+    std::vector<char> isSink;   // which tree the node belongs to
+    std::vector<int> ts;        // timestamp of the last distance update
+    std::vector<int> dist;      // distance to terminal (heuristic)
+    std::vector<char> inQueue;
+
+    RingDeque<int> active;
+    RingDeque<int> orphans;
+    int time = 0;
+    int source = -1, sink = -1;
+    Sum flow = 0;
+    bool solved = false;            // max_flow ran at least once, the trees are valid
+
+    // nodes whose t-links or n-links changed since the last max_flow
+    std::vector<int> changed;
+    std::vector<char> isChanged;
+
+    bool isTerminalNode(int v) const { return v == source || v == sink; }
+    void setActive(int v);
+    int nextActive();
+    void foldTerminalEdges();
+    void augment(int middle);
+    void adoptSource(int v);
+    void adoptSink(int v);
+    void adoptOrphans();
+    void reuseTrees();
+    void markChanged(int v);
+    // the residual reaching a source tree node from its parent / leaving a sink tree node towards it
+    bool parentArcResidual(int v) const;
+};
@@ -0,0 +1,76 @@
+#pragma once
+#include <cstdint>
+#include <cmath>
+#include <limits>
+#include <string>
+#include <stdexcept>
+
+/*
+Capacity (precision) policy shared by DataModel, GraphBuilder and every max-flow engine.
+
+Everything that ends up as an edge weight is stored as Cap:
+- double: the original behaviour
+- float:  half the memory traffic on the hot BFS/DFS loops, residues below 1e-6 count as empty
+- int32_t: fixed point with FRACTION_BITS fractional bits, every comparison is exact so
+  there is no floating point residue left for bfs to chase
+
+Costs are computed in double and converted once with quantize(). Flow totals are summed in
+Sum (int64 for the fixed point mode, a single arc fits int32 but a whole image does not)
+and reported back in cost units by toCost(), so the printed flow is comparable between modes.
+*/
+template <typename Cap>
+struct CapacityTraits;
+
+template <>
+struct CapacityTraits<double> {
+    using Sum = double;
+    static constexpr const char* name = "double";
+    static bool positive(double c) { return c > 1e-12; }
+    static double quantize(double v) { return v; }
+    static double toCost(Sum s) { return s; }
+};
+
+template <>
+struct CapacityTraits<float> {
+    using Sum = double;
+    static constexpr const char* name = "float";
+    static bool positive(float c) { return c > 1e-6f; }
+    static float quantize(double v) { return static_cast<float>(v); }
+    static double toCost(Sum s) { return s; }
+};
+
+template <>
+struct CapacityTraits<int32_t> {
+    using Sum = int64_t;
+    static constexpr const char* name = "int32";
+    static constexpr int FRACTION_BITS = 10;
+    static constexpr double SCALE = static_cast<double>(1 << FRACTION_BITS);
+
+    /* Hard seeds (K = 1e9) do not fit after scaling, they are clamped here instead.
+       2^28 is still far above any cut through a single pixel (4 n-links of at most lambda
+       plus a -log(eps) data cost), and leaves room for folding both t-links of a pixel
+       and for reverse residuals without overflowing int32. */
+    static constexpr int32_t MAX_CAP = 1 << 28;
+
+    static bool positive(int32_t c) { return c > 0; }
+    static int32_t quantize(double v) {
+        if (!(v > 0.0)) return 0;
+        const double scaled = std::round(v * SCALE);
+        return scaled >= MAX_CAP ? MAX_CAP : static_cast<int32_t>(scaled);
+    }
+    static double toCost(Sum s) { return static_cast<double>(s) / SCALE; }
+};
+
+enum class Precision {
+    Double,
+    Float,
+    Int32   // fixed point, see CapacityTraits<int32_t>
+};
+
+// "double" / "float" / "int32" -> Precision, throws std::runtime_error on anything else
+inline Precision parsePrecision(const std::string& name) {
+    if (name == "double") return Precision::Double;
+    if (name == "float") return Precision::Float;
+    if (name == "int32") return Precision::Int32;
+    throw std::runtime_error("Unknown precision: " + name + " (expected double|float|int32)");
+}
@@ -1,25 +1,121 @@
 #include "DataModel.h"
-#include "SimdOps.h"
+#include "ThreadPool.h"
+#include "Profiler.h"
+#include "HugePages.h"
 #include <cmath>
 #include <algorithm>
 #include <iostream>
+#include <cstdint>
+#include <stdexcept>
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace {
+
+inline int lowestBit(uint32_t m) {
+#ifdef _MSC_VER
+    unsigned long i;
+    _BitScanForward(&i, m);
+    return static_cast<int>(i);
+#else
+    return __builtin_ctz(m);
+#endif
+}
+
+#ifdef __AVX2__
+// bin indices of 32 pixels, 16 bit each
+template <int BITS>
+inline void binChunk(const uint8_t* R, const uint8_t* G, const uint8_t* B, uint16_t* out) {
+    constexpr int SHIFT = 8 - BITS;
+    for (int half = 0; half < 2; ++half) {
+        const __m256i r = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(R + 16 * half)));
+        const __m256i g = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(G + 16 * half)));
+        const __m256i b = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(B + 16 * half)));
+        const __m256i bin = _mm256_or_si256(
+            _mm256_or_si256(_mm256_slli_epi16(_mm256_srli_epi16(r, SHIFT), 2 * BITS),
+                            _mm256_slli_epi16(_mm256_srli_epi16(g, SHIFT), BITS)),
+            _mm256_srli_epi16(b, SHIFT));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + 16 * half), bin);
+    }
+}
+#endif
+
+/*
+Seed counts of pixels [i0, i1) into one worker's block of uint32 counters: COPIES foreground
+sub-histograms, then COPIES background ones, 1 << 3*BITS bins each.
+BITS is log2 of the bins per channel, so the bin index is three shifts (16 pixels per AVX2 op).
+The labels are scanned 32 at a time, chunks without a seed are skipped (scribbles leave
+almost every chunk empty). Consecutive pixels go round robin into the copies: a scribble or a
+rect border is mostly one colour and with a single table every increment would wait for the
+store of the previous one to the same counter.
+touched (32 bins): counters that went from 0 to 1, so only those are summed and cleared.
+*/
+template <int BITS, int COPIES, bool SPARSE>
+void countSeeds(const uint8_t* R, const uint8_t* G, const uint8_t* B, const int8_t* label, size_t i0, size_t i1,
+                uint32_t* counts, std::vector<uint32_t>& touched) {
+    constexpr int SHIFT = 8 - BITS;
+    constexpr size_t BINS = size_t(1) << (3 * BITS);
+    // label 1 (fg) or 0 (bg) picks the half of the block, k the copy
+    auto add = [&](int8_t l, unsigned k, uint32_t bin) {
+        const size_t at = ((l ^ 1) * COPIES + (k & (COPIES - 1))) * BINS + bin;
+        if (SPARSE) {
+            if (counts[at]++ == 0) touched.push_back(static_cast<uint32_t>(at));
+        } else {
+            ++counts[at];
+        }
+    };
+
+    size_t i = i0;
+#ifdef __AVX2__
+    const __m256i zero = _mm256_setzero_si256(), one = _mm256_set1_epi8(1);
+    alignas(32) uint16_t bin[32];
+    for (; i + 32 <= i1; i += 32) {
+        const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(label + i));
+        uint32_t seeded = static_cast<uint32_t>(
+            _mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(v, zero), _mm256_cmpeq_epi8(v, one))));
+        if (!seeded) continue;
+        binChunk<BITS>(R + i, G + i, B + i, bin);
+        if (seeded == 0xFFFFFFFFu) {
+            for (unsigned j = 0; j < 32; ++j) add(label[i + j], j, bin[j]);
+            continue;
+        }
+        for (; seeded; seeded &= seeded - 1) {
+            const unsigned j = static_cast<unsigned>(lowestBit(seeded));
+            add(label[i + j], j, bin[j]);
+        }
+    }
+#endif
+    for (unsigned k = 0; i < i1; ++i) {
+        if (label[i] != 0 && label[i] != 1) continue;
+        add(label[i], k++, ((uint32_t(R[i]) >> SHIFT) << (2 * BITS)) | ((uint32_t(G[i]) >> SHIFT) << BITS)
+                           | (uint32_t(B[i]) >> SHIFT));
+    }
+}
+
+} // namespace
 
-DataModel::DataModel(int binsPerChannel, double alpha_, double epsilon_)
-    : bins(binsPerChannel), alpha(alpha_), eps(epsilon_)
+template <typename Cap>
+DataModel<Cap>::DataModel(int binsPerChannel, double alpha_, double epsilon_)
+    : alpha(alpha_), eps(epsilon_)
 {
-    totalBins = bins * bins * bins;
-    histFG.assign(totalBins, 0.0);
-    histBG.assign(totalBins, 0.0);
+    setBins(binsPerChannel);
     fgHard = true;
     bgHard = true;
 }
 
-int DataModel::getBinIndex(const Vec3& c) const {
-    // We assume color channels to be in between 0 to 255
-    int rBin = std::min(static_cast<int>(c.r / (256.0 / bins)), bins - 1);
-    int gBin = std::min(static_cast<int>(c.g / (256.0 / bins)), bins - 1);
-    int bBin = std::min(static_cast<int>(c.b / (256.0 / bins)), bins - 1);
-    return rBin * bins * bins + gBin * bins + bBin;
+template <typename Cap>
+void DataModel<Cap>::setBins(int binsPerChannel) {
+    if (binsPerChannel != 8 && binsPerChannel != 16 && binsPerChannel != 32)
+        throw std::runtime_error("DataModel: bins per channel must be 8, 16 or 32");
+    bins = binsPerChannel;
+    bits = bins == 8 ? 3 : bins == 16 ? 4 : 5;
+    totalBins = bins * bins * bins;
+    histFG.assign(totalBins, 0.0);
+    histBG.assign(totalBins, 0.0);
+    // counters are kept at zero between calls, the layout depends on the bin count
+    std::vector<uint32_t>().swap(counts);
 }
 
 /*
@@ -28,7 +124,8 @@ We pass into the color counts for each bin
 Dividing by the total number of elements turns it into probabilities
 We use laplacian smoothing to prevent 0 inside logarithms
 */
-void DataModel::normalize(std::vector<double>& hist) {
+template <typename Cap>
+void DataModel<Cap>::normalize(std::vector<double>& hist) {
     double total = 0.0;
     for (double v : hist) total += v;
     total += alpha * totalBins;
@@ -36,176 +133,237 @@ void DataModel::normalize(std::vector<double>& hist) {
 }
 
 
-void DataModel::buildHistograms(const Image& img, const SeedMask& seeds) {
+template <typename Cap>
+void DataModel<Cap>::buildHistograms(const Image& img, const SeedMask& seeds, ThreadPool* pool) {
     W = img.width();
     H = img.height();
+    clearHistograms();
+    accumulateHistograms(img, seeds, pool);
+    finishHistograms();
+}
+
+template <typename Cap>
+void DataModel<Cap>::clearHistograms() {
+    histFG.assign(totalBins, 0.0);
+    histBG.assign(totalBins, 0.0);
+}
 
-    std::fill(histFG.begin(), histFG.end(), 0.0);
-    std::fill(histBG.begin(), histBG.end(), 0.0);
+template <typename Cap>
+void DataModel<Cap>::accumulateHistograms(const Image& img, const SeedMask& seeds, ThreadPool* pool) {
+    Profiler::Scope scope("buildHistograms");
+    const int w = img.width(), h = img.height();
+    ThreadPool serial(1);
+    ThreadPool& workers = pool ? *pool : serial;
 
-#ifdef __AVX2__
-    buildHistograms_SIMD(img, seeds);
-#else
-    // Scalar fallback
-    for (int y = 0; y < H; ++y) {
-        for (int x = 0; x < W; ++x) {
-            int label = seeds.getLabel(x, y);
-            if (label == 1) {
-                int idx = getBinIndex(img.getColor(x, y));
-                histFG[idx] += 1.0;
+    // integer counts straight from the planar image, only seeded pixels are looked at.
+    // one block of FG and BG sub-histograms per worker (see countSeeds): 8 copies for 8 bins
+    // and 4 for 16 bins (32 / 128 KB per worker), summed as a whole; 32 bins (32768 per table)
+    // use one copy and only sum the counters the worker touched
+    const bool sparse = bits == 5;
+    const int copies = bits == 3 ? 8 : bits == 4 ? 4 : 1;
+    const size_t block = static_cast<size_t>(2 * copies) * totalBins;
+    if (counts.size() < static_cast<size_t>(workers.size()) * block)
+        counts.resize(static_cast<size_t>(workers.size()) * block, 0);
+    if (touched.size() < static_cast<size_t>(workers.size())) touched.resize(workers.size());
+    const uint8_t* R = img.plane(0);
+    const uint8_t* G = img.plane(1);
+    const uint8_t* B = img.plane(2);
+    const int8_t* label = seeds.raw();
+    workers.parallelFor(0, static_cast<size_t>(h), [&](size_t y0, size_t y1, int wk) {
+        uint32_t* c = counts.data() + static_cast<size_t>(wk) * block;
+        const size_t i0 = y0 * w, i1 = y1 * w;
+        switch (bits) {
+            case 3: countSeeds<3, 8, false>(R, G, B, label, i0, i1, c, touched[wk]); break;
+            case 4: countSeeds<4, 4, false>(R, G, B, label, i0, i1, c, touched[wk]); break;
+            default: countSeeds<5, 1, true>(R, G, B, label, i0, i1, c, touched[wk]); break;
+        }
+    });
+
+    // the counts are added to what earlier calls left in histFG/histBG (exact, they are
+    // whole numbers far below 2^53, so neither the worker order nor the copies matter)
+    // and the counters are cleared for the next call
+    if (sparse) {
+        for (int wk = 0; wk < workers.size(); ++wk) {
+            uint32_t* c = counts.data() + static_cast<size_t>(wk) * block;
+            for (uint32_t at : touched[wk]) {
+                if (at < static_cast<uint32_t>(totalBins)) histFG[at] += static_cast<double>(c[at]);
+                else histBG[at - totalBins] += static_cast<double>(c[at]);
+                c[at] = 0;
             }
-            else if (label == 0) {
-                int idx = getBinIndex(img.getColor(x, y));
-                histBG[idx] += 1.0;
+            touched[wk].clear();
+        }
+        return;
+    }
+    for (int wk = 0; wk < workers.size(); ++wk) {
+        uint32_t* c = counts.data() + static_cast<size_t>(wk) * block;
+        for (int k = 0; k < copies; ++k) {
+            uint32_t* fg = c + static_cast<size_t>(k) * totalBins;
+            uint32_t* bg = c + static_cast<size_t>(copies + k) * totalBins;
+            for (int b = 0; b < totalBins; ++b) {
+                histFG[b] += static_cast<double>(fg[b]);
+                histBG[b] += static_cast<double>(bg[b]);
+                fg[b] = 0;
+                bg[b] = 0;
             }
         }
     }
-#endif
+}
 
+template <typename Cap>
+void DataModel<Cap>::finishHistograms() {
     // If histFG or histBG is all zeros (no seeds), smoothing will give uniform distribution
     normalize(histFG);
     normalize(histBG);
-}
 
-void DataModel::buildHistograms_SIMD(const Image& img, const SeedMask& seeds) {
-    // SIMD version: process pixels in batches where possible
-    // For simplicity, we still process individually but could batch seed pixel collection
-    for (int y = 0; y < H; ++y) {
-        for (int x = 0; x < W; ++x) {
-            int label = seeds.getLabel(x, y);
-            if (label == 1) {
-                int idx = getBinIndex(img.getColor(x, y));
-                histFG[idx] += 1.0;
-            }
-            else if (label == 0) {
-                int idx = getBinIndex(img.getColor(x, y));
-                histBG[idx] += 1.0;
-            }
-        }
+    // -log p once per bin (512 logs for 8 bins per channel), every pixel is a lookup after this
+    costFG.resize(totalBins);
+    costBG.resize(totalBins);
+    for (int b = 0; b < totalBins; ++b) {
+        costFG[b] = CapacityTraits<Cap>::quantize(-std::log(histFG[b] + eps));
+        costBG[b] = CapacityTraits<Cap>::quantize(-std::log(histBG[b] + eps));
     }
-    // Note: Full vectorization of histogram building is complex due to:
-    // - Variable seed patterns (not predictable which pixels are seeds)
-    // - Race conditions in histogram updates
-    // - Sparse seed data
-    // The main speedup comes from computeDataCosts instead.
 }
 
 /*
 Sets the values for DpFG and DpBG for each pixel
 DpFG = -log(p(this pixel belongs to foreground))
-the probability is calculated on basis of the histogram
-Further improvement area: use gausian mixture models instead of histograms to build probabilities
+the probability is calculated on basis of the histogram, -log of every bin is already
+in costFG / costBG so a pixel costs one bin index and two loads
+(the GrabCut mode uses gaussian mixture models instead, see the overload further down)
 
 Now model data from the histogram as probabilities to use them as edge weights
 These edge weights are terms of an energy expression
 The function of the graph cuts is to minimize the energy
 */
-void DataModel::computeDataCosts(const Image& img, const SeedMask& seeds) {
+template <typename Cap>
+void DataModel<Cap>::computeDataCosts(const Image& img, const SeedMask& seeds, ThreadPool* pool) {
+    Profiler::Scope scope("computeDataCosts");
 
     // Ensure buildHistograms ran
     W = img.width();
     H = img.height();
-    DpFG.assign(static_cast<size_t>(W) * H, 0.0);
-    DpBG.assign(static_cast<size_t>(W) * H, 0.0);
+    const size_t N = static_cast<size_t>(W) * H;
+    HugePages::resize(DpFG, N, hugePages);
+    HugePages::resize(DpBG, N, hugePages);
+    Profiler::global().memory("data_costs", 2 * N * sizeof(Cap));
+    ThreadPool serial(1);
+    ThreadPool& workers = pool ? *pool : serial;
 
-#ifdef __AVX2__
-    computeDataCosts_SIMD(img, seeds);
-#else
-    // Scalar fallback
-    const double K = 1e9;
-    for (int y = 0; y < H; ++y) {
-        for (int x = 0; x < W; ++x) {
-            int idx = y * W + x;
-            Vec3 c = img.getColor(x, y);
-            int b = getBinIndex(c);
-            double Pfg = histFG[b];
-            double Pbg = histBG[b];
-            double Dfg = -std::log(Pfg + eps);
-            double Dbg = -std::log(Pbg + eps);
-            int label = seeds.getLabel(x, y);
-
-            if (label == 1) {
-                if (fgHard) { Dfg = 0.0; Dbg = K; }
+    // per pixel: bin index from the planes, two table loads, seed override
+    const uint8_t* R = img.plane(0);
+    const uint8_t* G = img.plane(1);
+    const uint8_t* B = img.plane(2);
+    const int8_t* label = seeds.raw();
+    const Cap zero = CapacityTraits<Cap>::quantize(0.0);
+    const Cap hard = CapacityTraits<Cap>::quantize(HARD_COST);
+    workers.parallelFor(0, static_cast<size_t>(H), [&](size_t y0, size_t y1, int) {
+        for (size_t i = y0 * W; i < y1 * W; ++i) {
+            const int b = binIndex(R[i], G[i], B[i]);
+            Cap fg = costFG[b], bg = costBG[b];
+            if (label[i] == 1) {
+                if (fgHard) { fg = zero; bg = hard; }
             }
-            else if (label == 0) {
-                if (bgHard) { Dfg = K; Dbg = 0.0; }
+            else if (label[i] == 0) {
+                if (bgHard) { fg = hard; bg = zero; }
             }
-            DpFG[idx] = Dfg;
-            DpBG[idx] = Dbg;
+            DpFG[i] = fg;
+            DpBG[i] = bg;
         }
-    }
-#endif
+    });
+}
+
+template <typename Cap>
+void DataModel<Cap>::computeDataCosts(const Image& img, const SeedMask& seeds, const std::vector<int>& pixels) {
+    Profiler::Scope scope("computeDataCosts");
+    W = img.width();
+    H = img.height();
+    DpFG.assign(static_cast<size_t>(W) * H, Cap(0));
+    DpBG.assign(static_cast<size_t>(W) * H, Cap(0));
+    updateDataCosts(img, seeds, pixels);
 }
 
-void DataModel::computeDataCosts_SIMD(const Image& img, const SeedMask& seeds) {
-    const double K = 1e9;
-    const int W_aligned = (W / 4) * 4;  // Process in groups of 4
-    
-    for (int y = 0; y < H; ++y) {
-        // SIMD batch processing: process 4 pixels at a time
-        for (int x = 0; x < W_aligned; x += 4) {
-            alignas(32) double colors[12];
-            alignas(32) double Dfg[4], Dbg[4];
-            
-            // Load 4 colors
-            for (int i = 0; i < 4; ++i) {
-                Vec3 c = img.getColor(x + i, y);
-                colors[i*3]     = c.r;
-                colors[i*3 + 1] = c.g;
-                colors[i*3 + 2] = c.b;
+template <typename Cap>
+void DataModel<Cap>::computeDataCosts(const Image& img, const SeedMask& seeds,
+                                      const GaussianMixture& fg, const GaussianMixture& bg, ThreadPool& pool) {
+    Profiler::Scope scope("computeDataCosts");
+    W = img.width();
+    H = img.height();
+    DpFG.resize(static_cast<size_t>(W) * H);
+    DpBG.resize(static_cast<size_t>(W) * H);
+    Profiler::global().memory("data_costs", 2 * static_cast<size_t>(W) * H * sizeof(Cap));
+
+    const double K = HARD_COST;
+    const uint8_t* rgb = img.raw();
+    pool.parallelFor(0, static_cast<size_t>(H), [&](size_t y0, size_t y1, int) {
+        std::vector<double> Dfg(W), Dbg(W);
+        for (size_t y = y0; y < y1; ++y) {
+            const size_t row = y * W;
+            auto hard = [&](int x) {
+                const int label = seeds.getLabel(x, static_cast<int>(y));
+                return (label == 1 && fgHard) || (label == 0 && bgHard);
+            };
+            // the mixtures are evaluated 4 pixels per AVX2 register (see GaussianMixture),
+            // one call per run of pixels without a hard seed (rect mode: only the rectangle)
+            for (int x = 0; x < W;) {
+                if (hard(x)) { ++x; continue; }
+                int end = x + 1;
+                while (end < W && !hard(end)) ++end;
+                fg.negLogDensity(rgb + (row + x) * 3, end - x, eps, &Dfg[x]);
+                bg.negLogDensity(rgb + (row + x) * 3, end - x, eps, &Dbg[x]);
+                x = end;
             }
-            
-            // Compute data costs using SIMD
-            simd::computeDataCosts4_AVX2(colors, bins, totalBins, histFG, histBG, eps, Dfg, Dbg);
-            
-            // Apply hard constraints and store results
-            for (int i = 0; i < 4; ++i) {
-                int idx = y * W + x + i;
-                int label = seeds.getLabel(x + i, y);
-                
+            for (int x = 0; x < W; ++x) {
+                int label = seeds.getLabel(x, static_cast<int>(y));
                 if (label == 1) {
-                    if (fgHard) { Dfg[i] = 0.0; Dbg[i] = K; }
+                    if (fgHard) { Dfg[x] = 0.0; Dbg[x] = K; }
                 }
                 else if (label == 0) {
-                    if (bgHard) { Dfg[i] = K; Dbg[i] = 0.0; }
+                    if (bgHard) { Dfg[x] = K; Dbg[x] = 0.0; }
                 }
-                
-                DpFG[idx] = Dfg[i];
-                DpBG[idx] = Dbg[i];
+                DpFG[row + x] = CapacityTraits<Cap>::quantize(Dfg[x]);
+                DpBG[row + x] = CapacityTraits<Cap>::quantize(Dbg[x]);
             }
         }
-        
-        // Handle remaining pixels (if W not divisible by 4)
-        for (int x = W_aligned; x < W; ++x) {
-            int idx = y * W + x;
-            Vec3 c = img.getColor(x, y);
-            int b = getBinIndex(c);
-            double Pfg = histFG[b];
-            double Pbg = histBG[b];
-            double Dfg = -std::log(Pfg + eps);
-            double Dbg = -std::log(Pbg + eps);
-            int label = seeds.getLabel(x, y);
-            
-            if (label == 1) {
-                if (fgHard) { Dfg = 0.0; Dbg = K; }
-            }
-            else if (label == 0) {
-                if (bgHard) { Dfg = K; Dbg = 0.0; }
-            }
-            DpFG[idx] = Dfg;
-            DpBG[idx] = Dbg;
+    });
+}
+
+template <typename Cap>
+void DataModel<Cap>::updateDataCosts(const Image& img, const SeedMask& seeds, const std::vector<int>& pixels) {
+    const uint8_t* R = img.plane(0);
+    const uint8_t* G = img.plane(1);
+    const uint8_t* B = img.plane(2);
+    const int8_t* label = seeds.raw();
+    const Cap zero = CapacityTraits<Cap>::quantize(0.0);
+    const Cap hard = CapacityTraits<Cap>::quantize(HARD_COST);
+    for (int idx : pixels) {
+        const int b = binIndex(R[idx], G[idx], B[idx]);
+        Cap fg = costFG[b], bg = costBG[b];
+        if (label[idx] == 1) {
+            if (fgHard) { fg = zero; bg = hard; }
         }
+        else if (label[idx] == 0) {
+            if (bgHard) { fg = hard; bg = zero; }
+        }
+        DpFG[idx] = fg;
+        DpBG[idx] = bg;
     }
 }
 
-void DataModel::setHardSeeds(bool fg_hard, bool bg_hard) {
+template <typename Cap>
+void DataModel<Cap>::setHardSeeds(bool fg_hard, bool bg_hard) {
     fgHard = fg_hard;
     bgHard = bg_hard;
 }
 
-double DataModel::getDpFG(int x, int y) const {
-    return DpFG[y * W + x];
+template <typename Cap>
+Cap DataModel<Cap>::getDpFG(int x, int y) const {
+    return DpFG[static_cast<size_t>(y) * W + x];
 }
-double DataModel::getDpBG(int x, int y) const {
-    return DpBG[y * W + x];
+template <typename Cap>
+Cap DataModel<Cap>::getDpBG(int x, int y) const {
+    return DpBG[static_cast<size_t>(y) * W + x];
 }
+
+template class DataModel<double>;
+template class DataModel<float>;
+template class DataModel<int32_t>;
@@ -1,8 +1,19 @@
 #pragma once
 #include "Image.h"
 #include "SeedMask.h"
+#include "Capacity.h"
+#include "GMM.h"
 #include <vector>
 
+class ThreadPool;
+
+/*
+Cap is the capacity type the data costs are stored in (see Capacity.h).
+Histograms and -log(p) are still computed in double, every cost is quantized once when stored.
+The colour histograms have 8, 16 or 32 bins per channel (512 .. 32768 bins), a bin is the top
+3 .. 5 bits of each channel.
+*/
+template <typename Cap>
 class DataModel {
 public:
     DataModel(
@@ -14,38 +25,99 @@ public:
     Build histograms from the image given
     Histograms will be used to model p(colour|FG) or p(colour|BG)
     Initial foreground and background information will be taken from the seedmask
+    pool (optional): every worker counts its rows into its own histogram, the counts are
+    added up in worker order (integers, so the result is the same for any thread count)
     */
-    void buildHistograms(const Image& img, const SeedMask& seeds);
+    void buildHistograms(const Image& img, const SeedMask& seeds, ThreadPool* pool = nullptr);
+
+    // 8, 16 or 32 (throws otherwise), clears the histograms
+    void setBins(int binsPerChannel);
+    int binsPerChannel() const { return bins; }
+
+    // Streaming form of buildHistograms for images that are never in memory as a whole
+    // (tiled mode): clearHistograms, accumulateHistograms once per strip, finishHistograms
+    void clearHistograms();
+    void accumulateHistograms(const Image& img, const SeedMask& seeds, ThreadPool* pool = nullptr);
+    void finishHistograms();
+
+    // Compute per-pixel data costs DpFG and DpBG and store internally (rows split across pool)
+    void computeDataCosts(const Image& img, const SeedMask& seeds, ThreadPool* pool = nullptr);
+
+    // Same as above but only the given pixel indices (y * W + x) get a cost, every other
+    // pixel stays at 0. Used by the pyramid mode, which only builds a graph for a band.
+    void computeDataCosts(const Image& img, const SeedMask& seeds, const std::vector<int>& pixels);
+
+    // GrabCut: DpFG/DpBG = -log(p) under the two colour mixtures instead of the histograms,
+    // rows are split across the pool. Seeded pixels get the same hard costs as above.
+    void computeDataCosts(const Image& img, const SeedMask& seeds,
+                          const GaussianMixture& fg, const GaussianMixture& bg, ThreadPool& pool);
 
-    // Compute per-pixel data costs DpFG and DpBG and store internally
-    void computeDataCosts(const Image& img, const SeedMask& seeds);
+    // Recompute DpFG/DpBG only for the given pixel indices (y * W + x), e.g. after the user
+    // added a stroke. The histograms are not touched.
+    void updateDataCosts(const Image& img, const SeedMask& seeds, const std::vector<int>& pixels);
 
-    double getDpFG(int x, int y) const;
-    double getDpBG(int x, int y) const;
+    Cap getDpFG(int x, int y) const;
+    Cap getDpBG(int x, int y) const;
+
+    // -log p(colour | FG / BG) from the histograms, without any seed override
+    // (the superpixel mode sums these per region instead of storing a W*H plane)
+    Cap colorCostFG(uint8_t r, uint8_t g, uint8_t b) const { return costFG[binIndex(r, g, b)]; }
+    Cap colorCostBG(uint8_t r, uint8_t g, uint8_t b) const { return costBG[binIndex(r, g, b)]; }
+    static double hardCost() { return HARD_COST; }
+
+    // the W*H cost planes, row major
+    const Cap* costsFG() const { return DpFG.data(); }
+    const Cap* costsBG() const { return DpBG.data(); }
 
     // Configure whether scribble-confirmed FG/BG should be treated as hard (infinite)
     // If false, scribbles are treated as soft evidence (use histogram-based costs).
     void setHardSeeds(bool fg_hard, bool bg_hard);
+    bool hardFG() const { return fgHard; }
+    bool hardBG() const { return bgHard; }
+
+    // the cost planes through HugePages (SegmentationContext)
+    void setHugePages(bool on) { hugePages = on; }
+    // memory held: cost planes, histograms and their scratch
+    size_t bytes() const {
+        size_t n = (DpFG.capacity() + DpBG.capacity() + costFG.capacity() + costBG.capacity()) * sizeof(Cap)
+                 + (histFG.capacity() + histBG.capacity()) * sizeof(double) + counts.capacity() * sizeof(uint32_t);
+        for (const auto& t : touched) n += t.capacity() * sizeof(uint32_t);
+        return n;
+    }
 
     int width() const { return W; }
     int height() const { return H; }
 
 private:
     int bins;
+    int bits;                   // log2(bins)
     int totalBins;
     double alpha;
     double eps;
 
     int W, H;
     std::vector<double> histFG, histBG;
-    std::vector<double> DpFG, DpBG;
+    std::vector<Cap> DpFG, DpBG;
     bool fgHard;
     bool bgHard;
 
-    int getBinIndex(const Vec3& c) const;
+    // -log p per histogram bin, filled by buildHistograms
+    std::vector<Cap> costFG, costBG;
+
+    // per worker FG/BG sub-histograms of accumulateHistograms, all zero between calls and
+    // kept so a reused model does not allocate; touched: per worker list of the non-zero
+    // counters (32 bins only)
+    std::vector<uint32_t> counts;
+    std::vector<std::vector<uint32_t>> touched;
+    bool hugePages = false;
+
+    // cost of a pixel against its hard seed (the "infinite" t-link)
+    static constexpr double HARD_COST = 1e9;
+
+    // We assume color channels to be in between 0 to 255, bin = floor(c * bins / 256) = c >> (8 - bits)
+    int binIndex(int r, int g, int b) const {
+        const int s = 8 - bits;
+        return ((r >> s) << (2 * bits)) | ((g >> s) << bits) | (b >> s);
+    }
     void normalize(std::vector<double>& hist);
-    
-    // AVX2-optimized helper functions
-    void buildHistograms_SIMD(const Image& img, const SeedMask& seeds);
-    void computeDataCosts_SIMD(const Image& img, const SeedMask& seeds);
 };
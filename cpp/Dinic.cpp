@@ -1,95 +1,195 @@
 #include "Dinic.h"
+#include "Profiler.h"
+#include "HugePages.h"
+#include <cstdint>
 
-Dinic::Dinic(int n_) : n(n_), adj(n_), level(n_), start(n_) {}
+template <typename Cap>
+Dinic<Cap>::Dinic(int n_) : n(n_), g(n_), level(n_), start(n_) {}
 
-/* For edge u->v, the actual edge is the edge 'a' as it is from u to v
-   and with the capacity stated, while the edge 'b' is the reverse edge that
-   we form with initially zero capacity. */
-void Dinic::add_edge(int u, int v, double cap) {
-    Edge a(v, static_cast<int>(adj[v].size()), cap);
-    Edge b(u, static_cast<int>(adj[u].size()), 0.0);
-    adj[u].push_back(a);
-    adj[v].push_back(b);
+/* For edge u->v, the forward arc gets the capacity stated, while the reverse arc v->u
+   gets rev_cap (zero for a plain directed edge). Both arcs are stored once in the FlowGraph. */
+template <typename Cap>
+void Dinic<Cap>::add_edge(int u, int v, Cap cap, Cap rev_cap) {
+    g.add_edge(u, v, cap, rev_cap);
+}
+
+template <typename Cap>
+void Dinic<Cap>::reset(int n_) {
+    n = n_;
+    g.hugePages = this->hugePages;
+    g.reset(n_);
+    HugePages::resize(level, n_, this->hugePages);
+    HugePages::resize(start, n_, this->hugePages);
+    path.clear();
+}
+
+template <typename Cap>
+void Dinic<Cap>::reserve_edges(size_t m) {
+    g.reserve_edges(m);
+}
+
+template <typename Cap>
+void Dinic<Cap>::add_grid_edges(int W, int H, const Cap* capS, const Cap* capT,
+                             const Cap* right, const Cap* down, ThreadPool& pool) {
+    g.add_grid_edges(W, H, capS, capT, right, down, pool);
 }
 
 /* s: Source, t: Sink
    Traverse from source and mark levels of each node from the source.
-   This also ensures we only consider edges with positive capacity.
+   This also ensures we only consider edges with enough residual capacity
+   (positive for the capacity type, and at least delta during a capacity scaling phase).
    Finally, the boolean of level[t] != -1 is returned which ensures that
    the path is reached from the source to sink or not. */
-bool Dinic::bfs(int s, int t) {
+template <typename Cap>
+bool Dinic<Cap>::bfs(int s, int t, Cap delta) {
     std::fill(level.begin(), level.end(), -1);
-    std::queue<int> q;
+    // every node enters the queue at most once, so a flat array with two cursors is enough
+    HugePages::resize(queue, n, this->hugePages);
+    int qhead = 0, qtail = 0;
     level[s] = 0;
-    q.push(s);
-    while (!q.empty()) {
-        int u = q.front();
-        q.pop();
-        for (const Edge &e : adj[u]) {
-            if (e.cap > 1e-12 && level[e.next] == -1) {
-                level[e.next] = level[u] + 1;
-                q.push(e.next);
+    queue[qtail++] = s;
+    while (qhead < qtail) {
+        int u = queue[qhead++];
+        // the level graph only needs the levels below the sink
+        if (level[t] != -1 && level[u] >= level[t]) break;
+        for (int a = g.begin(u); a < g.end(u); ++a) {
+            const int v = g.head[a];
+            if (usable(g.cap[a], delta) && level[v] == -1) {
+                level[v] = level[u] + 1;
+                queue[qtail++] = v;
             }
         }
     }
     return level[t] != -1;
 }
 
-/* DFS reached the sink so we stop DFS and return the minimum flow of that path.
+/* Blocking flow on the current level graph without recursion.
    
-   Memory address of the start is given and then increased every iteration.
-   It ensures that DFS doesn't keep getting stuck in the same edge or a node
-   whose all outgoing edges are saturated.
+   The current s -> u path is kept as a stack of arcs. From u we advance along the first
+   admissible arc (start[u] remembers where we stopped, like before). When we reach the sink
+   we push the bottleneck along the whole path and only retreat to the tail of the first
+   arc that got saturated, so the untouched prefix of the path is reused for the next
+   augmentation instead of starting again from the source.
    
-   Only follows edges that go exactly one level deeper (level[next] == level[u] + 1).
+   A node with no admissible arc left is a dead end: we drop it from the level graph
+   (level = -1) and step back one arc.
    
-   For each valid edge, recursively push flow. If successful, update the edge capacity
-   and reverse edge capacity. Return the saturation flow pushed. */
-double Dinic::dfs(int u, int t, double pushed) {
-    // DFS reached the sink, return the flow we've pushed
-    if (u == t) return pushed;
-
-    // start[u] tracks current position in adjacency list of u
-    for (int &i = start[u]; i < (int)adj[u].size(); ++i) {
-        Edge &e = adj[u][i];
-        // Only follow edges with positive capacity that go one level deeper
-        if (e.cap > 1e-12 && level[e.next] == level[u] + 1) {
-            double current_saturation = dfs(e.next, t, std::min(pushed, e.cap));
-            if (current_saturation > 0) {
+   Returns: total flow pushed in this level graph */
+template <typename Cap>
+typename Dinic<Cap>::Sum Dinic<Cap>::blockingFlow(int s, int t, Cap delta) {
+    Sum total = 0;
+    uint64_t augmentations = 0, pathArcs = 0, advances = 0;
+    path.clear();
+    int u = s;
+    while (true) {
+        if (u == t) {
+            Cap pushed = std::numeric_limits<Cap>::max();
+            for (int a : path) pushed = std::min(pushed, g.cap[a]);
+
+            size_t firstSaturated = path.size();
+            for (size_t i = 0; i < path.size(); ++i) {
+                const int a = path[i];
                 // Update forward edge capacity
-                e.cap -= current_saturation;
+                g.cap[a] -= pushed;
                 // Update reverse edge capacity
-                adj[e.next][e.backward_edge].cap += current_saturation;
-                return current_saturation;
+                g.cap[g.sister[a]] += pushed;
+                if (firstSaturated == path.size() && !usable(g.cap[a], delta)) firstSaturated = i;
+            }
+            total += pushed;
+            ++augmentations;
+            pathArcs += path.size();
+
+            // continue from the tail of the first saturated arc
+            if (firstSaturated == path.size()) firstSaturated = path.size() - 1;
+            u = g.head[g.sister[path[firstSaturated]]];
+            path.resize(firstSaturated);
+            continue;
+        }
+
+        // start[u] tracks current arc in the CSR range of u
+        bool advanced = false;
+        const int from = u, first = start[u];
+        for (int &a = start[u]; a < g.end(u); ++a) {
+            const int v = g.head[a];
+            // Only follow edges with positive capacity that go one level deeper
+            if (usable(g.cap[a], delta) && level[v] == level[u] + 1) {
+                path.push_back(a);
+                u = v;
+                advanced = true;
+                break;
             }
         }
+        advances += start[from] - first;
+        if (advanced) continue;
+
+        // dead end
+        if (u == s) break;
+        level[u] = -1;
+        const int a = path.back();
+        path.pop_back();
+        u = g.head[g.sister[a]];
+        ++start[u];
+        ++advances;
     }
-    return 0.0;
+    this->counters.augmentations += augmentations;
+    this->counters.pathArcs += pathArcs;
+    this->counters.arcAdvances += advances;
+    return total;
 }
 
-/* BFS ensures that while there is a path from s to t, we build the level graph,
-   find the paths via DFS, and traverse them while pushing flow.
+/* Capacity scaling: first only arcs with residual >= delta take part, for delta going
+   down in powers of two from the largest interior (non-terminal) capacity. The big
+   augmentations over short paths are found with few BFS phases this way. The last round uses every arc
+   with positive residual, which gives the exact maximum flow.
    
-   Multiple DFS calls push flow until no more can be sent in this level graph.
-   Add the saturation flow of each path to get the max flow.
+   Inside every round, BFS builds the level graph and blockingFlow saturates it,
+   repeated while there is a path from s to t.
    
    Returns: maximum flow value from source to sink */
-double Dinic::max_flow(int s, int t) {
-    double flow = 0.0;
-    const double INF = std::numeric_limits<double>::infinity();
-    
-    /* While there exists a path from s to t in the residual graph */
-    while (bfs(s, t)) {
-        // Reset start for every BFS phase
-        std::fill(start.begin(), start.end(), 0);
-        // Find all blocking flows in this level graph
-        while (true) {
-            double f = dfs(s, t, INF);
-            if (f <= 0) break;
-            flow += f;
+template <typename Cap>
+double Dinic<Cap>::max_flow(int s, int t) {
+    Profiler::Scope scope("max_flow");
+    this->counters = SolverStats();
+    Sum flow = 0;
+    g.finalize();
+
+    Cap maxInterior = 0;
+    for (int u = 0; u < n; ++u) {
+        if (u == s || u == t) continue;
+        for (int a = g.begin(u); a < g.end(u); ++a) {
+            const int v = g.head[a];
+            if (v != s && v != t) maxInterior = std::max(maxInterior, g.cap[a]);
+        }
+    }
+
+    // largest power of two not above the biggest interior capacity
+    Cap delta = 0;
+    if (maxInterior > 0) {
+        delta = 1;
+        while (delta * 2 <= maxInterior) delta *= 2;
+        while (delta > maxInterior) delta /= 2;
+    }
+    const Cap minDelta = maxInterior / static_cast<Cap>(SCALING_RANGE);
+
+    while (true) {
+        // the last round (delta = 0) admits every arc with positive residual
+        if (delta < minDelta) delta = 0;
+
+        /* While there exists a path from s to t in the residual graph
+           (a scaling phase also ends as soon as its paths get long, see MAX_SCALED_DEPTH) */
+        while (bfs(s, t, delta) && (delta == 0 || level[t] <= MAX_SCALED_DEPTH)) {
+            ++this->counters.phases;
+            // Reset start for every BFS phase
+            std::copy(g.offset.begin(), g.offset.end() - 1, start.begin());
+            // Find the blocking flow in this level graph
+            flow += blockingFlow(s, t, delta);
         }
+        if (delta == 0) break;
+        delta /= 2;
     }
-    return flow;
+    this->reportStats("dinic", n, g.numArcs(), g.bytes()
+        + (level.capacity() + start.capacity() + queue.capacity() + path.capacity()) * sizeof(int));
+    return Traits::toCost(flow);
 }
 
 /* After max_flow, get which nodes are reachable from source in residual graph.
@@ -97,21 +197,28 @@ double Dinic::max_flow(int s, int t) {
    after all flows have been pushed. These reachable nodes form one side of the cut,
    and unreachable nodes form the other side.
    Uses iterative DFS with a stack to avoid recursion depth issues. */
-std::vector<bool> Dinic::minCut(int s) const {
-    std::vector<bool> seen(n, false);
-    std::vector<int> stack;
-    stack.reserve(n);
-    stack.push_back(s);
+template <typename Cap>
+void Dinic<Cap>::minCut(int s, std::vector<bool>& seen) const {
+    Profiler::Scope scope("minCut");
+    seen.assign(n, false);
     seen[s] = true;
-    while (!stack.empty()) {
-        int u = stack.back();
-        stack.pop_back();
-        for (const Edge &e : adj[u]) {
-            if (e.cap > 1e-12 && !seen[e.next]) {
-                seen[e.next] = true;
-                stack.push_back(e.next);
+    if (!g.finalized()) return;
+    // every node is pushed at most once, the BFS queue is big enough for the stack
+    queue.resize(n);
+    int top = 0;
+    queue[top++] = s;
+    while (top > 0) {
+        int u = queue[--top];
+        for (int a = g.begin(u); a < g.end(u); ++a) {
+            const int v = g.head[a];
+            if (Traits::positive(g.cap[a]) && !seen[v]) {
+                seen[v] = true;
+                queue[top++] = v;
             }
         }
     }
-    return seen;
 }
+
+template class Dinic<double>;
+template class Dinic<float>;
+template class Dinic<int32_t>;
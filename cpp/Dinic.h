@@ -1,48 +1,63 @@
 #pragma once
+#include "MaxFlow.h"
+#include "FlowGraph.h"
 #include <vector>
-#include <queue>
 #include <algorithm>
 #include <limits>
 
-/* each edge we form in graph we will store it's capacity to later check for flow and 'next' node
-   is the direction it is originally and backward edge is formed as if we send less amount of
-   flow then the capacity. It virtually acts as the left over capacity is flowing in the reverse direction*/
-struct Edge {
-    int next;
-    int backward_edge;
-    double cap;
-
-    // constructor
-    Edge(int next_node = 0, int back_index = 0, double capacity = 0.0)
-        : next(next_node), backward_edge(back_index), cap(capacity) {}
-};
-
 /* All helper functions for Dinic's algorithm will be defined in this class.
    Dinic's algorithm finds maximum flow by repeatedly:
    1. Building a level graph via BFS
-   2. Finding blocking flows via DFS */
-class Dinic {
+   2. Finding blocking flows via an iterative DFS (explicit arc stack, no recursion)
+   wrapped in capacity scaling phases (see max_flow).
+   The residual graph itself (arcs, reverse arcs, capacities) lives in a flat CSR FlowGraph. */
+template <typename Cap>
+class Dinic : public MaxFlow<Cap> {
 public:
+    using Traits = CapacityTraits<Cap>;
+    using Sum = typename Traits::Sum;
+
     int n;
-    // adjacency list representation of the flow network
-    std::vector<std::vector<Edge>> adj;
+    // CSR representation of the flow network
+    FlowGraph<Cap> g;
 
     Dinic(int n = 0);
-    void add_edge(int u, int v, double cap);
-    bool bfs(int s, int t);
-    double dfs(int u, int t, double pushed);
-    double max_flow(int s, int t);
-    std::vector<bool> minCut(int s) const;
+    void add_edge(int u, int v, Cap cap, Cap rev_cap = Cap(0)) override;
+    void reserve_edges(size_t m) override;
+    void add_grid_edges(int W, int H, const Cap* capS, const Cap* capT,
+                        const Cap* right, const Cap* down, ThreadPool& pool) override;
+    bool bfs(int s, int t, Cap delta = Cap(0));
+    Sum blockingFlow(int s, int t, Cap delta = Cap(0));
+    double max_flow(int s, int t) override;
+    using MaxFlow<Cap>::minCut;
+    void minCut(int s, std::vector<bool>& seen) const override;
+    void reset(int n) override;
 
 private:
+    /* Scaling phases stop once delta drops below maxCapacity / SCALING_RANGE,
+       the remaining flow is found by the final unrestricted rounds.
+       Within a phase only level graphs up to MAX_SCALED_DEPTH are used: on image graphs most
+       flow goes over very short paths, and chasing long fat paths costs one BFS per extra level. */
+    static constexpr int SCALING_RANGE = 4;
+    static constexpr int MAX_SCALED_DEPTH = 4;
+
+    // an arc takes part in the current phase if its residual is positive and at least delta
+    static bool usable(Cap cap, Cap delta) { return Traits::positive(cap) && cap >= delta; }
+
     /* We track each node's level during BFS from the source.
        This forms the layered residual graph used in Dinic's algorithm. */
     std::vector<int> level;
 
     /* Start array for DFS iteration.
-       Keeps track of the current position in each node's adjacency list.
+       Keeps track of the current arc in each node's CSR range.
        This ensures DFS doesn't keep trying the same saturated edges repeatedly.
        Memory address of start[u] is given and increased every iteration,
        ensuring efficient exploration and avoiding re-visiting saturated edges. */
     std::vector<int> start;
+
+    // BFS queue, kept as a flat array so it is allocated once (minCut uses it as its stack)
+    mutable std::vector<int> queue;
+
+    // arcs of the current source -> u path in blockingFlow
+    std::vector<int> path;
 };
@@ -0,0 +1,100 @@
+#include "FlowGraph.h"
+#include "ThreadPool.h"
+#include "HugePages.h"
+#include <stdexcept>
+#include <cstdint>
+
+template <typename Cap>
+FlowGraph<Cap>::FlowGraph(int n_) : n(n_) {}
+
+template <typename Cap>
+void FlowGraph<Cap>::reset(int n_) {
+    n = n_;
+    pending.clear();
+    built = false;
+    reused = true;
+}
+
+template <typename Cap>
+void FlowGraph<Cap>::reserve_edges(size_t m) {
+    pending.reserve(m);
+}
+
+template <typename Cap>
+void FlowGraph<Cap>::add_edge(int u, int v, Cap c, Cap rev_c) {
+    if (built) throw std::runtime_error("FlowGraph: cannot add edges after the graph was finalized");
+    pending.push_back(PendingEdge(u, v, c, rev_c));
+}
+
+template <typename Cap>
+void FlowGraph<Cap>::add_grid_edges(int W, int H, const Cap* capS, const Cap* capT,
+                                    const Cap* right, const Cap* down, ThreadPool& pool) {
+    if (built) throw std::runtime_error("FlowGraph: cannot add edges after the graph was finalized");
+    const int source = W * H, sink = W * H + 1;
+    const size_t N = static_cast<size_t>(W) * H;
+    const size_t nRight = static_cast<size_t>(W - 1) * H;
+    const size_t nDown = static_cast<size_t>(W) * (H - 1);
+
+    // layout: 2 t-links per pixel, then all right n-links, then all down n-links
+    const size_t base = pending.size();
+    if (base == 0) HugePages::resize(pending, 2 * N + nRight + nDown, hugePages);
+    else pending.resize(base + 2 * N + nRight + nDown);
+    PendingEdge* tl = pending.data() + base;
+    PendingEdge* rl = tl + 2 * N;
+    PendingEdge* dl = rl + nRight;
+
+    pool.parallelFor(0, static_cast<size_t>(H), [&](size_t y0, size_t y1, int) {
+        for (size_t y = y0; y < y1; ++y) {
+            const int row = static_cast<int>(y) * W;
+            for (int x = 0; x < W; ++x) {
+                const int p = row + x;
+                tl[2 * static_cast<size_t>(p)] = PendingEdge(source, p, capS[p], Cap(0));
+                tl[2 * static_cast<size_t>(p) + 1] = PendingEdge(p, sink, capT[p], Cap(0));
+            }
+            const size_t r = y * (W - 1);
+            for (int x = 0; x + 1 < W; ++x)
+                rl[r + x] = PendingEdge(row + x, row + x + 1, right[r + x], right[r + x]);
+            if (static_cast<int>(y) + 1 < H) {
+                for (int x = 0; x < W; ++x)
+                    dl[row + x] = PendingEdge(row + x, row + W + x, down[row + x], down[row + x]);
+            }
+        }
+    });
+}
+
+template <typename Cap>
+void FlowGraph<Cap>::finalize() {
+    if (built) return;
+
+    // pass 1: count degrees, prefix sum gives each node's arc range
+    HugePages::assign(offset, static_cast<size_t>(n) + 1, 0, hugePages);
+    for (const PendingEdge &e : pending) {
+        ++offset[e.u + 1];
+        ++offset[e.v + 1];
+    }
+    for (int u = 0; u < n; ++u) offset[u + 1] += offset[u];
+
+    // pass 2: fill arcs, offset[u] is the next free slot in u's range (it ends up at the
+    // start of u + 1, one shift puts the ranges back)
+    const size_t arcs = pending.size() * 2;
+    HugePages::resize(head, arcs, hugePages);
+    HugePages::resize(sister, arcs, hugePages);
+    HugePages::resize(cap, arcs, hugePages);
+    for (const PendingEdge &e : pending) {
+        const int a = offset[e.u]++;
+        const int b = offset[e.v]++;
+        head[a] = e.v;  sister[a] = b;  cap[a] = e.cap;
+        head[b] = e.u;  sister[b] = a;  cap[b] = e.rev_cap;
+    }
+    for (int u = n; u > 0; --u) offset[u] = offset[u - 1];
+    offset[0] = 0;
+
+    // the edge buffer is not needed anymore (a reused graph keeps it for the next build)
+    if (reused) pending.clear();
+    else std::vector<PendingEdge>().swap(pending);
+    built = true;
+}
+
+template class FlowGraph<double>;
+template class FlowGraph<float>;
+template class FlowGraph<int32_t>;
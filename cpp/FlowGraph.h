@@ -0,0 +1,78 @@
+#pragma once
+#include <vector>
+#include <cstddef>
+
+class ThreadPool;
+
+/* Flat compressed-sparse-row (CSR) storage for a flow network, shared by the max-flow engines.
+
+   Every edge is stored as a pair of arcs u->v and v->u. Each arc has a residual capacity:
+   the forward arc starts at the edge capacity and the reverse arc at rev_cap (0 for a plain
+   directed edge, the same value as cap for an undirected n-link). Sending flow on one arc
+   lowers its residual and raises its sister's residual by the same amount. This models
+   "unused capacity flows backwards".
+
+   Topology (offset/head/sister) and capacities (cap) live in separate arrays, so a
+   BFS that only looks at the structure does not pull the capacities into cache.
+
+   Building is done in two passes over the buffered edges. First we count each node's
+   degree, then we fill every node's arc range. This happens once in finalize(), so we avoid
+   one heap allocation per node and the repeated push_back growth of
+   vector<vector<Edge>>.
+
+   Cap is the capacity type (double, float or int32 fixed point, see Capacity.h). */
+template <typename Cap>
+class FlowGraph {
+public:
+    int n;
+
+    // arcs of node u are [offset[u], offset[u+1])
+    std::vector<int> offset;
+    std::vector<int> head;      // node the arc points to
+    std::vector<int> sister;    // index of the reverse arc
+    std::vector<Cap> cap;       // residual capacity of the arc
+
+    explicit FlowGraph(int n = 0);
+
+    // large arrays go through HugePages (set by the owning engine, see MaxFlow::setHugePages)
+    bool hugePages = false;
+
+    // empty graph with n nodes for the next build, every array keeps its storage
+    // (the edge buffer too: a graph that was reset once holds on to it after finalize)
+    void reset(int n);
+
+    // optional hint so buffering the edges does not reallocate
+    void reserve_edges(size_t m);
+
+    // edge u->v with capacity cap, and v->u with capacity rev_cap
+    void add_edge(int u, int v, Cap cap, Cap rev_cap = Cap(0));
+
+    // the pixel graph in one go, see MaxFlow::add_grid_edges. Every edge has a fixed slot
+    // in the buffer, so the rows are written from the pool in any order.
+    void add_grid_edges(int W, int H, const Cap* capS, const Cap* capT,
+                        const Cap* right, const Cap* down, ThreadPool& pool);
+
+    // turn the buffered edges into CSR arrays (no-op if already done)
+    void finalize();
+    bool finalized() const { return built; }
+
+    int begin(int u) const { return offset[u]; }
+    int end(int u) const { return offset[u + 1]; }
+    size_t numArcs() const { return head.size(); }
+    // memory of the CSR arrays, plus the edge buffer while it is still held
+    size_t bytes() const {
+        return (offset.capacity() + head.capacity() + sister.capacity()) * sizeof(int)
+             + cap.capacity() * sizeof(Cap) + pending.capacity() * sizeof(PendingEdge);
+    }
+
+private:
+    struct PendingEdge {
+        int u, v;
+        Cap cap, rev_cap;
+        PendingEdge() {}    // left uninitialised, resize() would otherwise zero the whole buffer first
+        PendingEdge(int u_, int v_, Cap c, Cap r) : u(u_), v(v_), cap(c), rev_cap(r) {}
+    };
+    std::vector<PendingEdge> pending;
+    bool built = false;
+    bool reused = false;
+};
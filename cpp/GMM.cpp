@@ -0,0 +1,259 @@
+#include "GMM.h"
+#include "ThreadPool.h"
+#include "SimdOps.h"
+#include "Profiler.h"
+#include <cmath>
+#include <algorithm>
+#include <numeric>
+
+namespace {
+
+/* Added to every covariance diagonal. Besides keeping flat (noise free) regions invertible
+   it bounds the peak density by (2 pi)^-1.5 < 1, so -log(p) can never go negative and the
+   data costs stay valid edge capacities. One unit of variance is the uint8 rounding noise. */
+constexpr double COV_REG = 1.0;
+constexpr int KMEANS_ITERATIONS = 10;
+constexpr int STATS = 10;   // per component: weight, 3 sums, 6 outer products
+
+// per-component densities (already multiplied by the mixture weight) for one colour
+template <typename Comp>
+void componentDensities(const Comp* comp, double r, double g, double b, double* pk) {
+    for (int k = 0; k < GaussianMixture::K; ++k) {
+        const Comp& c = comp[k];
+        if (c.coef == 0.0) { pk[k] = 0.0; continue; }
+        const double dr = r - c.mean[0], dg = g - c.mean[1], db = b - c.mean[2];
+        const double q = c.inv[0] * dr * dr + c.inv[3] * dg * dg + c.inv[5] * db * db
+                       + 2.0 * (c.inv[1] * dr * dg + c.inv[2] * dr * db + c.inv[4] * dg * db);
+        pk[k] = c.coef * std::exp(-0.5 * q);
+    }
+}
+
+void addStats(double* s, double w, double r, double g, double b) {
+    s[0] += w;
+    s[1] += w * r; s[2] += w * g; s[3] += w * b;
+    s[4] += w * r * r; s[5] += w * r * g; s[6] += w * r * b;
+    s[7] += w * g * g; s[8] += w * g * b; s[9] += w * b * b;
+}
+
+#ifdef __AVX2__
+// same as componentDensities for 4 colours at once
+template <typename Comp>
+void componentDensities4(const Comp* comp, __m256d r, __m256d g, __m256d b, __m256d* pk) {
+    const __m256d half = _mm256_set1_pd(-0.5);
+    const __m256d two = _mm256_set1_pd(2.0);
+    for (int k = 0; k < GaussianMixture::K; ++k) {
+        const Comp& c = comp[k];
+        if (c.coef == 0.0) { pk[k] = _mm256_setzero_pd(); continue; }
+        const __m256d dr = _mm256_sub_pd(r, _mm256_set1_pd(c.mean[0]));
+        const __m256d dg = _mm256_sub_pd(g, _mm256_set1_pd(c.mean[1]));
+        const __m256d db = _mm256_sub_pd(b, _mm256_set1_pd(c.mean[2]));
+        __m256d diag = _mm256_mul_pd(_mm256_set1_pd(c.inv[0]), _mm256_mul_pd(dr, dr));
+        diag = _mm256_add_pd(diag, _mm256_mul_pd(_mm256_set1_pd(c.inv[3]), _mm256_mul_pd(dg, dg)));
+        diag = _mm256_add_pd(diag, _mm256_mul_pd(_mm256_set1_pd(c.inv[5]), _mm256_mul_pd(db, db)));
+        __m256d cross = _mm256_mul_pd(_mm256_set1_pd(c.inv[1]), _mm256_mul_pd(dr, dg));
+        cross = _mm256_add_pd(cross, _mm256_mul_pd(_mm256_set1_pd(c.inv[2]), _mm256_mul_pd(dr, db)));
+        cross = _mm256_add_pd(cross, _mm256_mul_pd(_mm256_set1_pd(c.inv[4]), _mm256_mul_pd(dg, db)));
+        const __m256d q = _mm256_add_pd(diag, _mm256_mul_pd(two, cross));
+        pk[k] = _mm256_mul_pd(_mm256_set1_pd(c.coef), simd::exp_pd_avx2(_mm256_mul_pd(half, q)));
+    }
+}
+#endif
+
+} // namespace
+
+double GaussianMixture::density(double r, double g, double b) const {
+    double pk[K];
+    componentDensities(comp, r, g, b, pk);
+    double p = 0.0;
+    for (int k = 0; k < K; ++k) p += pk[k];
+    return p;
+}
+
+void GaussianMixture::negLogDensity(const uint8_t* rgb, size_t n, double eps, double* out) const {
+    size_t i = 0;
+#ifdef __AVX2__
+    const __m256d epsv = _mm256_set1_pd(eps);
+    const __m256d minus = _mm256_set1_pd(-1.0);
+    for (; i + 4 <= n; i += 4) {
+        const uint8_t* px = rgb + i * 3;
+        const __m256d r = _mm256_set_pd(px[9], px[6], px[3], px[0]);
+        const __m256d g = _mm256_set_pd(px[10], px[7], px[4], px[1]);
+        const __m256d b = _mm256_set_pd(px[11], px[8], px[5], px[2]);
+        __m256d pk[K];
+        componentDensities4(comp, r, g, b, pk);
+        __m256d p = epsv;
+        for (int k = 0; k < K; ++k) p = _mm256_add_pd(p, pk[k]);
+        _mm256_storeu_pd(out + i, _mm256_mul_pd(minus, simd::log_pd_avx2(p)));
+    }
+#endif
+    for (; i < n; ++i) {
+        const uint8_t* px = rgb + i * 3;
+        out[i] = -std::log(density(px[0], px[1], px[2]) + eps);
+    }
+}
+
+/*
+k-means on the samples, centres start at the luminance quantiles so the result does not
+depend on a random seed. The hard assignment of the last round gives the first estimate
+of weights, means and covariances.
+*/
+void GaussianMixture::initKMeans(const ColorSamples& s) {
+    const size_t n = s.size();
+    std::vector<size_t> order(n);
+    std::iota(order.begin(), order.end(), size_t(0));
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return s.r[a] + s.g[a] + s.b[a] < s.r[b] + s.g[b] + s.b[b];
+    });
+
+    double centre[K][3];
+    for (int k = 0; k < K; ++k) {
+        const size_t i = order[std::min(n - 1, static_cast<size_t>((k + 0.5) * n / K))];
+        centre[k][0] = s.r[i]; centre[k][1] = s.g[i]; centre[k][2] = s.b[i];
+    }
+
+    std::vector<int> label(n, 0);
+    for (int it = 0; it < KMEANS_ITERATIONS; ++it) {
+        double sum[K][3] = {};
+        double cnt[K] = {};
+        for (size_t i = 0; i < n; ++i) {
+            int best = 0;
+            double bestD = 1e300;
+            for (int k = 0; k < K; ++k) {
+                const double dr = s.r[i] - centre[k][0], dg = s.g[i] - centre[k][1], db = s.b[i] - centre[k][2];
+                const double d = dr * dr + dg * dg + db * db;
+                if (d < bestD) { bestD = d; best = k; }
+            }
+            label[i] = best;
+            sum[best][0] += s.r[i]; sum[best][1] += s.g[i]; sum[best][2] += s.b[i];
+            cnt[best] += 1.0;
+        }
+        for (int k = 0; k < K; ++k) {
+            if (cnt[k] == 0.0) continue;    // empty cluster keeps its centre
+            for (int c = 0; c < 3; ++c) centre[k][c] = sum[k][c] / cnt[k];
+        }
+    }
+
+    double stats[K * STATS] = {};
+    for (size_t i = 0; i < n; ++i) addStats(&stats[label[i] * STATS], 1.0, s.r[i], s.g[i], s.b[i]);
+    double w[K], sum[K * 3], outer[K * 6];
+    for (int k = 0; k < K; ++k) {
+        w[k] = stats[k * STATS];
+        for (int c = 0; c < 3; ++c) sum[k * 3 + c] = stats[k * STATS + 1 + c];
+        for (int c = 0; c < 6; ++c) outer[k * 6 + c] = stats[k * STATS + 4 + c];
+    }
+    setFromStats(w, sum, outer, static_cast<double>(n));
+}
+
+void GaussianMixture::setFromStats(const double* w, const double* sum, const double* outer, double total) {
+    const double twoPiCubed = std::pow(2.0 * 3.14159265358979323846, 3.0);
+    for (int k = 0; k < K; ++k) {
+        Component& c = comp[k];
+        if (w[k] < 1e-9 || total <= 0.0) {   // dead component, drops out of the mixture
+            c.weight = 0.0;
+            c.coef = 0.0;
+            continue;
+        }
+        c.weight = w[k] / total;
+        for (int d = 0; d < 3; ++d) c.mean[d] = sum[k * 3 + d] / w[k];
+        const double* o = &outer[k * 6];
+        const double* m = c.mean;
+        // covariance = E[x x^T] - mean mean^T, upper triangle
+        const double a = o[0] / w[k] - m[0] * m[0] + COV_REG;
+        const double b = o[1] / w[k] - m[0] * m[1];
+        const double cc = o[2] / w[k] - m[0] * m[2];
+        const double d = o[3] / w[k] - m[1] * m[1] + COV_REG;
+        const double e = o[4] / w[k] - m[1] * m[2];
+        const double f = o[5] / w[k] - m[2] * m[2] + COV_REG;
+
+        // symmetric 3x3 inverse through the cofactors
+        const double c00 = d * f - e * e, c01 = cc * e - b * f, c02 = b * e - cc * d;
+        double det = a * c00 + b * c01 + cc * c02;
+        if (det < 1.0) det = 1.0;   // only rounding can push it below the COV_REG bound
+        c.inv[0] = c00 / det;
+        c.inv[1] = c01 / det;
+        c.inv[2] = c02 / det;
+        c.inv[3] = (a * f - cc * cc) / det;
+        c.inv[4] = (b * cc - a * e) / det;
+        c.inv[5] = (a * d - b * b) / det;
+        c.coef = c.weight / std::sqrt(twoPiCubed * det);
+    }
+}
+
+void GaussianMixture::fit(const ColorSamples& s, int emSteps, ThreadPool& pool) {
+    Profiler::Scope scope("gmmFit");
+    const size_t n = s.size();
+    if (n == 0) {
+        fitted = false;
+        for (Component& c : comp) { c.weight = 0.0; c.coef = 0.0; }
+        return;
+    }
+    if (!fitted) initKMeans(s);
+    fitted = true;
+
+    // EM: responsibilities of every sample, then weighted statistics per component
+    const int workers = pool.size();
+    std::vector<double> local(static_cast<size_t>(workers) * K * STATS);
+    for (int step = 0; step < emSteps; ++step) {
+        std::fill(local.begin(), local.end(), 0.0);
+        pool.parallelFor(0, n, [&](size_t begin, size_t end, int wk) {
+            double* st = &local[static_cast<size_t>(wk) * K * STATS];
+            size_t i = begin;
+#ifdef __AVX2__
+            __m256d acc[K][STATS];
+            for (int k = 0; k < K; ++k)
+                for (int j = 0; j < STATS; ++j) acc[k][j] = _mm256_setzero_pd();
+            const __m256d tiny = _mm256_set1_pd(1e-300);
+            for (; i + 4 <= end; i += 4) {
+                const __m256d r = _mm256_loadu_pd(&s.r[i]);
+                const __m256d g = _mm256_loadu_pd(&s.g[i]);
+                const __m256d b = _mm256_loadu_pd(&s.b[i]);
+                __m256d pk[K];
+                componentDensities4(comp, r, g, b, pk);
+                __m256d total = tiny;
+                for (int k = 0; k < K; ++k) total = _mm256_add_pd(total, pk[k]);
+                const __m256d invTotal = _mm256_div_pd(_mm256_set1_pd(1.0), total);
+                for (int k = 0; k < K; ++k) {
+                    const __m256d w = _mm256_mul_pd(pk[k], invTotal);
+                    const __m256d wr = _mm256_mul_pd(w, r), wg = _mm256_mul_pd(w, g), wb = _mm256_mul_pd(w, b);
+                    acc[k][0] = _mm256_add_pd(acc[k][0], w);
+                    acc[k][1] = _mm256_add_pd(acc[k][1], wr);
+                    acc[k][2] = _mm256_add_pd(acc[k][2], wg);
+                    acc[k][3] = _mm256_add_pd(acc[k][3], wb);
+                    acc[k][4] = _mm256_add_pd(acc[k][4], _mm256_mul_pd(wr, r));
+                    acc[k][5] = _mm256_add_pd(acc[k][5], _mm256_mul_pd(wr, g));
+                    acc[k][6] = _mm256_add_pd(acc[k][6], _mm256_mul_pd(wr, b));
+                    acc[k][7] = _mm256_add_pd(acc[k][7], _mm256_mul_pd(wg, g));
+                    acc[k][8] = _mm256_add_pd(acc[k][8], _mm256_mul_pd(wg, b));
+                    acc[k][9] = _mm256_add_pd(acc[k][9], _mm256_mul_pd(wb, b));
+                }
+            }
+            for (int k = 0; k < K; ++k) {
+                for (int j = 0; j < STATS; ++j) {
+                    alignas(32) double lane[4];
+                    _mm256_store_pd(lane, acc[k][j]);
+                    st[k * STATS + j] += lane[0] + lane[1] + lane[2] + lane[3];
+                }
+            }
+#endif
+            for (; i < end; ++i) {
+                double pk[K];
+                componentDensities(comp, s.r[i], s.g[i], s.b[i], pk);
+                double total = 1e-300;
+                for (int k = 0; k < K; ++k) total += pk[k];
+                for (int k = 0; k < K; ++k) addStats(&st[k * STATS], pk[k] / total, s.r[i], s.g[i], s.b[i]);
+            }
+        });
+
+        // reduce in worker order, so the result only depends on the pool size
+        double w[K] = {}, sum[K * 3] = {}, outer[K * 6] = {};
+        for (int wk = 0; wk < workers; ++wk) {
+            const double* st = &local[static_cast<size_t>(wk) * K * STATS];
+            for (int k = 0; k < K; ++k) {
+                w[k] += st[k * STATS];
+                for (int c = 0; c < 3; ++c) sum[k * 3 + c] += st[k * STATS + 1 + c];
+                for (int c = 0; c < 6; ++c) outer[k * 6 + c] += st[k * STATS + 4 + c];
+            }
+        }
+        setFromStats(w, sum, outer, static_cast<double>(n));
+    }
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+class ThreadPool;
+
+// colours in structure-of-arrays layout, so 4 samples load straight into one AVX2 register
+struct ColorSamples {
+    std::vector<double> r, g, b;
+
+    size_t size() const { return r.size(); }
+    void clear() { r.clear(); g.clear(); b.clear(); }
+    void push(double R, double G, double B) { r.push_back(R); g.push_back(G); b.push_back(B); }
+};
+
+/*
+Gaussian mixture colour model (full 3x3 covariance), the GrabCut replacement for the
+8x8x8 histograms of DataModel.
+
+fit() starts with k-means when the model is empty, after that every call continues EM
+from the current parameters, so the GrabCut iterations only need one or two EM steps each.
+The per-sample work (responsibilities, densities) runs 4 samples per AVX2 register and
+is split across the thread pool.
+*/
+class GaussianMixture {
+public:
+    static constexpr int K = 5;    // components, same as the GrabCut paper
+
+    // fit to the samples, emSteps EM iterations (k-means init on the first call)
+    void fit(const ColorSamples& samples, int emSteps, ThreadPool& pool);
+
+    bool empty() const { return !fitted; }
+    void clear() { fitted = false; }
+
+    // p(colour), the density of the mixture
+    double density(double r, double g, double b) const;
+
+    // out[i] = -log(p(colour i) + eps) for n interleaved RGB pixels
+    void negLogDensity(const uint8_t* rgb, size_t n, double eps, double* out) const;
+
+private:
+    struct Component {
+        double weight = 0.0;
+        double mean[3] = {0.0, 0.0, 0.0};
+        // inverse covariance, upper triangle: xx, xy, xz, yy, yz, zz
+        double inv[6] = {1.0, 0.0, 0.0, 1.0, 0.0, 1.0};
+        double coef = 0.0;          // weight / sqrt((2 pi)^3 det)
+    };
+    Component comp[K];
+    bool fitted = false;
+
+    void initKMeans(const ColorSamples& samples);
+    // weights, means and covariances from accumulated (soft) statistics
+    void setFromStats(const double* w, const double* sum, const double* outer, double total);
+};
@@ -0,0 +1,121 @@
+#include "GrabCutSegmenter.h"
+#include "GraphBuilder.h"
+#include <chrono>
+#include <algorithm>
+
+// the mixtures have 5 components and 10 parameters each, a few ten thousand colours pin
+// them down as well as a few million, so fitting runs on an evenly strided subset
+static constexpr size_t MAX_SAMPLES = 1 << 16;
+// EM steps for the first fit (after k-means) and for every later warm-started refit
+static constexpr int FIRST_EM_STEPS = 4;
+static constexpr int WARM_EM_STEPS = 2;
+
+template <typename Cap>
+GrabCutSegmenter<Cap>::GrabCutSegmenter(SolverType solver_, int threads_, int iterations_, double lambda_)
+    : solver(solver_), threads(threads_), iterations(std::max(1, iterations_)), lambda(lambda_), pool(threads_) {}
+
+template <typename Cap>
+void GrabCutSegmenter<Cap>::setHardSeeds(bool fg_hard, bool bg_hard) {
+    fgHard = fg_hard;
+    bgHard = bg_hard;
+}
+
+template <typename Cap>
+void GrabCutSegmenter<Cap>::gatherSamples(const Image& img, const std::vector<uint8_t>& labels) {
+    size_t nFG = 0;
+    for (uint8_t l : labels) nFG += l;
+    const size_t nBG = labels.size() - nFG;
+    const size_t strideFG = std::max<size_t>(1, (nFG + MAX_SAMPLES - 1) / MAX_SAMPLES);
+    const size_t strideBG = std::max<size_t>(1, (nBG + MAX_SAMPLES - 1) / MAX_SAMPLES);
+
+    fgSamples.clear();
+    bgSamples.clear();
+    const uint8_t* rgb = img.raw();
+    size_t seenFG = 0, seenBG = 0;
+    for (size_t p = 0; p < labels.size(); ++p) {
+        const uint8_t* px = rgb + p * 3;
+        if (labels[p]) {
+            if (seenFG++ % strideFG == 0) fgSamples.push(px[0], px[1], px[2]);
+        } else {
+            if (seenBG++ % strideBG == 0) bgSamples.push(px[0], px[1], px[2]);
+        }
+    }
+}
+
+template <typename Cap>
+std::vector<bool> GrabCutSegmenter<Cap>::segment(const Image& img, const SeedMask& seeds) {
+    if (seeds.width() != img.width() || seeds.height() != img.height())
+        throw std::runtime_error("GrabCutSegmenter: seed mask size does not match the image");
+    if (img.channels() != 3) throw std::runtime_error("GrabCutSegmenter: expected an RGB image");
+
+    const int W = img.width(), H = img.height();
+    const size_t N = static_cast<size_t>(W) * H;
+    iterationStats.clear();
+    fgModel.clear();
+    bgModel.clear();
+
+    // initial labelling: background seeds are background, everything else foreground
+    std::vector<uint8_t> labels(N);
+    const int8_t* seed = seeds.raw();
+    for (size_t p = 0; p < N; ++p) labels[p] = seed[p] == 0 ? 0 : 1;
+
+    DataModel<Cap> dm(8, 1.0, 1e-9);
+    dm.setHardSeeds(fgHard, bgHard);
+    std::unique_ptr<MaxFlow<Cap>> graph;
+    std::vector<Cap> oldS, oldT;
+
+    for (int it = 0; it < iterations; ++it) {
+        const auto t0 = std::chrono::steady_clock::now();
+
+        gatherSamples(img, labels);
+        const int em = fgModel.empty() ? FIRST_EM_STEPS : WARM_EM_STEPS;
+        fgModel.fit(fgSamples, em, pool);
+        bgModel.fit(bgSamples, em, pool);
+
+        bool reused = false;
+        if (graph && graph->supportsIncremental()) {
+            // warm start: keep the residual graph, only push the change of every t-link
+            oldS.resize(N);
+            oldT.resize(N);
+            for (int y = 0; y < H; ++y) {
+                for (int x = 0; x < W; ++x) {
+                    oldS[static_cast<size_t>(y) * W + x] = dm.getDpBG(x, y);
+                    oldT[static_cast<size_t>(y) * W + x] = dm.getDpFG(x, y);
+                }
+            }
+            dm.computeDataCosts(img, seeds, fgModel, bgModel, pool);
+            for (int y = 0; y < H; ++y) {
+                for (int x = 0; x < W; ++x) {
+                    const size_t p = static_cast<size_t>(y) * W + x;
+                    const Cap dS = dm.getDpBG(x, y) - oldS[p];
+                    const Cap dT = dm.getDpFG(x, y) - oldT[p];
+                    if (dS != Cap(0) || dT != Cap(0)) graph->add_tweights(static_cast<int>(p), dS, dT);
+                }
+            }
+            reused = true;
+        } else {
+            dm.computeDataCosts(img, seeds, fgModel, bgModel, pool);
+            GraphBuilder<Cap> gb(img, dm, lambda, solver, threads);
+            graph = gb.buildGraph();
+        }
+
+        const double flow = graph->max_flow(W * H, W * H + 1);
+        const std::vector<bool> cut = graph->minCut(W * H);
+        size_t changed = 0;
+        for (size_t p = 0; p < N; ++p) {
+            const uint8_t l = cut[p] ? 1 : 0;
+            changed += (l != labels[p]);
+            labels[p] = l;
+        }
+
+        const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+        iterationStats.push_back({flow, changed, reused, ms});
+        if (changed == 0 && it > 0) break;
+    }
+
+    return std::vector<bool>(labels.begin(), labels.end());
+}
+
+template class GrabCutSegmenter<double>;
+template class GrabCutSegmenter<float>;
+template class GrabCutSegmenter<int32_t>;
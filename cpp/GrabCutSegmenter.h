@@ -0,0 +1,62 @@
+#pragma once
+#include "Image.h"
+#include "SeedMask.h"
+#include "DataModel.h"
+#include "GMM.h"
+#include "MaxFlow.h"
+#include "ThreadPool.h"
+#include <vector>
+#include <memory>
+#include <cstdint>
+
+/*
+Iterative GrabCut (Rother, Kolmogorov, Blake, "GrabCut: Interactive Foreground Extraction
+using Iterated Graph Cuts", SIGGRAPH 2004) on top of the normal pipeline.
+
+Seeded pixels are fixed (rect mode: everything outside the rectangle is background),
+every unknown pixel starts as foreground. Each iteration
+- fits one colour mixture to the current foreground and one to the background
+  (k-means + EM the first time, a few more EM steps from the previous fit afterwards)
+- recomputes the data costs of every pixel from the two mixtures
+- solves the cut and takes it as the new labelling
+The n-links only depend on the image, so the graph is built once. With bk/grid the
+t-link changes go in through add_tweights and max_flow continues from the previous
+residual graph, the other engines rebuild it every iteration.
+Stops early once an iteration does not move a single pixel.
+*/
+template <typename Cap>
+class GrabCutSegmenter {
+public:
+    struct IterationStats {
+        double flow;
+        size_t changed;     // pixels whose label flipped in this iteration
+        bool reusedGraph;
+        double ms;
+    };
+
+    GrabCutSegmenter(SolverType solver = SolverType::Grid, int threads = 0,
+                     int iterations = 5, double lambda = 50.0);
+
+    // same meaning as DataModel::setHardSeeds
+    void setHardSeeds(bool fg_hard, bool bg_hard);
+
+    // source side of the final cut, W*H entries (true = foreground)
+    std::vector<bool> segment(const Image& img, const SeedMask& seeds);
+
+    const std::vector<IterationStats>& stats() const { return iterationStats; }
+
+private:
+    SolverType solver;
+    int threads;
+    int iterations;
+    double lambda;
+    bool fgHard = true, bgHard = true;
+
+    ThreadPool pool;
+    GaussianMixture fgModel, bgModel;
+    ColorSamples fgSamples, bgSamples;
+    std::vector<IterationStats> iterationStats;
+
+    // colours of the current foreground / background, strided down to a bounded sample
+    void gatherSamples(const Image& img, const std::vector<uint8_t>& labels);
+};
@@ -1,146 +1,453 @@
 #include "GraphBuilder.h"
 #include "SimdOps.h"
+#include "ThreadPool.h"
+#include "Profiler.h"
+#include "HugePages.h"
+#include <atomic>
 #include <cmath>
+#include <cstdint>
+#include <algorithm>
+#include <stdexcept>
+#include <cstddef>
 
-GraphBuilder::GraphBuilder(const Image& img, const DataModel& dm, double lambda_)
-    : image(img), dataModel(dm), W(img.width()), H(img.height()), lambda(lambda_) {}
+template <typename Cap>
+GraphBuilder<Cap>::GraphBuilder(const Image& img, const DataModel<Cap>& dm, double lambda_, SolverType solver_, int threads_)
+    : image(img), dataModel(dm), W(img.width()), H(img.height()), lambda(lambda_), solver(solver_), threads(threads_) {}
 
-/*
-beta is the mean color difference in neighbouring edges
-we will use this as an important constant in the weight of the n-links (pixel to pixel links)
-*/
-double GraphBuilder::computeBeta(const Image& img) {
-    const int W = img.width(), H = img.height();
-    double sum = 0.0;
-    long long cnt = 0;
+namespace {
 
-//process 4 at a time by using AVX2
+// squared colour distance of n pixel pairs from planar data, exact int32 (max 3 * 255^2)
+void distancesSq(const uint8_t* const a[3], const uint8_t* const b[3], int n, int32_t* out) {
+    int i = 0;
 #ifdef __AVX2__
-    // AVX2 
-    for (int y = 0; y < H; ++y) {
-        int x = 0;
-        // Process 4 pixels at a time
-        for (; x + 4 < W; x += 4) {
-            alignas(32) double colors_a[12], colors_b[12], dists[4];
-            
-            // Load 4 adjacent color pairs
-            for (int i = 0; i < 4; ++i) {
-                Vec3 c1 = img.getColor(x + i, y);
-                Vec3 c2 = img.getColor(x + i + 1, y);
-                colors_a[i*3] = c1.r; colors_a[i*3+1] = c1.g; colors_a[i*3+2] = c1.b;
-                colors_b[i*3] = c2.r; colors_b[i*3+1] = c2.g; colors_b[i*3+2] = c2.b;
-            }
-            
-            simd::colorDistSq4_AVX2(colors_a, colors_b, dists);
-            sum += dists[0] + dists[1] + dists[2] + dists[3];
-            cnt += 4;
-        }
-        
-        // Handle remaining pixels
-        for (; x + 1 < W; ++x) {
-            Vec3 c1 = img.getColor(x, y);
-            Vec3 c2 = img.getColor(x + 1, y);
-            sum += simd::colorDistSq(c1, c2);
-            ++cnt;
+    for (; i + 8 <= n; i += 8) {
+        __m256i d = _mm256_setzero_si256();
+        for (int c = 0; c < 3; ++c) {
+            const __m256i va = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(a[c] + i)));
+            const __m256i vb = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(b[c] + i)));
+            const __m256i diff = _mm256_sub_epi32(va, vb);
+            d = _mm256_add_epi32(d, _mm256_mullo_epi32(diff, diff));
         }
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), d);
     }
-    
-   
-    for (int y = 0; y + 1 < H; ++y) {
-        for (int x = 0; x < W; ++x) {
-            Vec3 c1 = img.getColor(x, y);
-            Vec3 c2 = img.getColor(x, y + 1);
-            sum += simd::colorDistSq(c1, c2);
-            ++cnt;
+#endif
+    for (; i < n; ++i) {
+        int32_t d = 0;
+        for (int c = 0; c < 3; ++c) {
+            const int32_t diff = static_cast<int32_t>(a[c][i]) - static_cast<int32_t>(b[c][i]);
+            d += diff * diff;
         }
+        out[i] = d;
     }
+}
 
-//is AVX2 not present, calculate in scalar mannner
-#else
-    // Scalar 
-    for (int y = 0; y < H; ++y) {
-        for (int x = 0; x < W; ++x) {
-            Vec3 c = img.getColor(x, y);
-            if (x + 1 < W) {
-                Vec3 c2 = img.getColor(x+1, y);
-                sum += simd::colorDistSq(c, c2);
-                ++cnt;
+// distancesSq over a whole row through a buffer on the stack, fn(offset, dist, count) per block
+template <typename Fn>
+void distanceBlocks(const uint8_t* const a[3], const uint8_t* const b[3], int n, Fn&& fn) {
+    constexpr int BLOCK = 512;
+    int32_t dist[BLOCK];
+    for (int x = 0; x < n; x += BLOCK) {
+        const int len = std::min(BLOCK, n - x);
+        const uint8_t* pa[3] = {a[0] + x, a[1] + x, a[2] + x};
+        const uint8_t* pb[3] = {b[0] + x, b[1] + x, b[2] + x};
+        distancesSq(pa, pb, len, dist);
+        fn(x, dist, len);
+    }
+}
+
+// integer min / max across workers, the result does not depend on the order of the updates
+template <typename T>
+void atomicMin(std::atomic<T>& target, T value) {
+    T cur = target.load(std::memory_order_relaxed);
+    while (value < cur && !target.compare_exchange_weak(cur, value, std::memory_order_relaxed)) {}
+}
+template <typename T>
+void atomicMax(std::atomic<T>& target, T value) {
+    T cur = target.load(std::memory_order_relaxed);
+    while (value > cur && !target.compare_exchange_weak(cur, value, std::memory_order_relaxed)) {}
+}
+
+} // namespace
+
+/*
+beta is the mean color difference in neighbouring edges
+we will use this as an important constant in the weight of the n-links (pixel to pixel links)
+The distances are exact integers, so is their sum (no rounding, same result on every machine
+and for every number of threads: each worker sums its rows and adds them to one integer total)
+*/
+template <typename Cap>
+double GraphBuilder<Cap>::computeBeta(const Image& img, int32_t* maxDist, ThreadPool* pool) {
+    Profiler::Scope scope("computeBeta");
+    const int W = img.width(), H = img.height();
+    const uint8_t* P[3] = {img.plane(0), img.plane(1), img.plane(2)};
+    ThreadPool serial(1);
+    ThreadPool& workers = pool ? *pool : serial;
+
+    std::atomic<uint64_t> total{0};
+    std::atomic<int32_t> maxAll{0};
+    workers.parallelFor(0, static_cast<size_t>(H), [&](size_t y0, size_t y1, int) {
+        uint64_t sum = 0;
+        int32_t maxD = 0;
+        auto add = [&](int, const int32_t* dist, int n) {
+            for (int x = 0; x < n; ++x) { sum += dist[x]; maxD = std::max(maxD, dist[x]); }
+        };
+        for (size_t y = y0; y < y1; ++y) {
+            const size_t row = y * W;
+            const uint8_t* cur[3] = {P[0] + row, P[1] + row, P[2] + row};
+            if (W > 1) {
+                const uint8_t* right[3] = {cur[0] + 1, cur[1] + 1, cur[2] + 1};
+                distanceBlocks(cur, right, W - 1, add);
             }
-            if (y + 1 < H) {
-                Vec3 c2 = img.getColor(x, y+1);
-                sum += simd::colorDistSq(c, c2);
-                ++cnt;
+            if (static_cast<int>(y) + 1 < H) {
+                const uint8_t* below[3] = {cur[0] + W, cur[1] + W, cur[2] + W};
+                distanceBlocks(cur, below, W, add);
             }
         }
-    }
-#endif
-    
-    const double mean = (cnt > 0) ? (sum / cnt) : 1.0;
+        total.fetch_add(sum, std::memory_order_relaxed);
+        atomicMax(maxAll, maxD);
+    });
+
+    const uint64_t sum = total.load();
+    const int32_t maxD = maxAll.load();
+    const long long cnt = static_cast<long long>(W - 1) * H + static_cast<long long>(W) * (H - 1);
+    if (maxDist) *maxDist = maxD;
+
+    const double mean = (cnt > 0) ? (static_cast<double>(sum) / cnt) : 1.0;
     const double beta = 1.0 / (2.0 * mean + 1e-9);
     return beta;
 }
 
-std::unique_ptr<Dinic> GraphBuilder::buildGraph() {
-    int nodes = W * H;
-    int source = nodes;
-    int sink = nodes + 1;
-    //create new dinic object (graph) and return pointer to it
-    std::unique_ptr<Dinic> G(new Dinic(nodes + 2));
+/*
+lambda * exp(-beta * d) only depends on the integer distance d (0 .. 3*255^2), so it is
+computed once per distance that occurs and every edge is a table lookup. The table
+holds at most 195076 entries, the per-edge work is integer math plus one load.
+*/
+template <typename Cap>
+std::vector<Cap> GraphBuilder<Cap>::nlinkTable(double lambda, double beta, int32_t maxDist, ThreadPool* pool) {
+    std::vector<Cap> lut;
+    nlinkTable(lambda, beta, maxDist, lut, pool);
+    return lut;
+}
 
-    double beta = computeBeta(image);
+template <typename Cap>
+void GraphBuilder<Cap>::nlinkTable(double lambda, double beta, int32_t maxDist, std::vector<Cap>& lut,
+                                   ThreadPool* pool) {
+    ThreadPool serial(1);
+    ThreadPool& workers = pool ? *pool : serial;
+    lut.resize(static_cast<size_t>(maxDist) + 1);
+    workers.parallelFor(0, lut.size(), [&](size_t d0, size_t d1, int) {
+        for (size_t d = d0; d < d1; ++d)
+            lut[d] = CapacityTraits<Cap>::quantize(lambda * std::exp(-beta * static_cast<double>(d)));
+    });
+}
 
-    // add t-links
-    for (int y = 0; y < H; ++y) {
-        for (int x = 0; x < W; ++x) {
-            int idx = y * W + x;
-            double capS = dataModel.getDpBG(x, y); // source -> node (use bg cost that we calculated in the datamodel file)
-            double capT = dataModel.getDpFG(x, y); // node -> sink (use fg cost)
-
-            // add source->node with capS
-            G->add_edge(source, idx, capS);
-            // add node->sink with capT
-            G->add_edge(idx, sink, capT);
+template <typename Cap>
+void GraphBuilder<Cap>::nlinkWeights(double beta, int32_t maxDist, std::vector<Cap>& right, std::vector<Cap>& down,
+                                     ThreadPool* pool) const {
+    nlinkWeights(beta, maxDist, 0, 0, W, H, right, down, pool);
+}
+
+template <typename Cap>
+void GraphBuilder<Cap>::nlinkWeights(double beta, int32_t maxDist, int x0, int y0, int w, int h,
+                                     std::vector<Cap>& right, std::vector<Cap>& down, ThreadPool* pool) const {
+    ThreadPool serial(1);
+    ThreadPool& workers = pool ? *pool : serial;
+    const std::vector<Cap> lut = nlinkTable(lambda, beta, maxDist, &workers);
+    nlinkPlanes(lut, x0, y0, w, h, right, down, workers);
+}
+
+template <typename Cap>
+void GraphBuilder<Cap>::nlinkPlanes(const std::vector<Cap>& lut, int x0, int y0, int w, int h,
+                                    std::vector<Cap>& right, std::vector<Cap>& down, ThreadPool& pool,
+                                    bool huge) const {
+    Profiler::Scope scope("nlinkWeights");
+    HugePages::resize(right, static_cast<size_t>(w > 0 ? w - 1 : 0) * h, huge);
+    HugePages::resize(down, static_cast<size_t>(w) * (h > 0 ? h - 1 : 0), huge);
+    Profiler::global().memory("nlink_weights", (right.size() + down.size()) * sizeof(Cap));
+
+    const uint8_t* P[3] = {image.plane(0), image.plane(1), image.plane(2)};
+    pool.parallelFor(0, static_cast<size_t>(h), [&](size_t r0, size_t r1, int) {
+        for (size_t y = r0; y < r1; ++y) {
+            const size_t row = (y0 + y) * W + x0;
+            const uint8_t* cur[3] = {P[0] + row, P[1] + row, P[2] + row};
+            if (w > 1) {
+                const uint8_t* next[3] = {cur[0] + 1, cur[1] + 1, cur[2] + 1};
+                Cap* r = right.data() + y * (w - 1);
+                distanceBlocks(cur, next, w - 1, [&](int off, const int32_t* dist, int n) {
+                    for (int x = 0; x < n; ++x) r[off + x] = lut[dist[x]];
+                });
+            }
+            if (static_cast<int>(y) + 1 < h) {
+                const uint8_t* below[3] = {cur[0] + W, cur[1] + W, cur[2] + W};
+                Cap* d = down.data() + y * w;
+                distanceBlocks(cur, below, w, [&](int off, const int32_t* dist, int n) {
+                    for (int x = 0; x < n; ++x) d[off + x] = lut[dist[x]];
+                });
+            }
         }
+    });
+}
+
+template <typename Cap>
+std::unique_ptr<MaxFlow<Cap>> GraphBuilder<Cap>::buildGraph() {
+    ThreadPool pool(threads);
+    GraphWorkspace<Cap> ws;
+    std::unique_ptr<MaxFlow<Cap>> G;
+    buildGraph(G, ws, pool);
+    return G;
+}
+
+template <typename Cap>
+void GraphBuilder<Cap>::buildGraph(std::unique_ptr<MaxFlow<Cap>>& G, GraphWorkspace<Cap>& ws, ThreadPool& pool) {
+    Profiler::Scope scope("buildGraph");
+    int32_t maxDist = 0;
+    double beta = computeBeta(image, &maxDist, &pool);
+    if (fixedBeta > 0.0) beta = fixedBeta;
+    buildFull(G, beta, maxDist, ws, pool);
+}
+
+template <typename Cap>
+void GraphBuilder<Cap>::prepareEngine(std::unique_ptr<MaxFlow<Cap>>& G, int w, int h) const {
+    if (G) G->resetGrid(w, h);
+    else G = makeGridMaxFlow<Cap>(solver, w, h, threads);
+}
+
+template <typename Cap>
+void GraphBuilder<Cap>::buildFull(std::unique_ptr<MaxFlow<Cap>>& G, double beta, int32_t maxDist,
+                                  GraphWorkspace<Cap>& ws, ThreadPool& pool) {
+    // the graph on the selected engine
+    prepareEngine(G, W, H);
+
+    // n-links (4-neighborhood : up down, left. right)
+    nlinkTable(lambda, beta, maxDist, ws.lut, &pool);
+    nlinkPlanes(ws.lut, 0, 0, W, H, ws.right, ws.down, pool, ws.hugePages);
+
+    // t-links: source -> node gets the bg cost, node -> sink the fg cost (see DataModel),
+    // then one undirected edge per horizontal / vertical neighbour pair, rows filled in parallel
+    {
+        Profiler::Scope edges("addEdges");
+        G->add_grid_edges(W, H, dataModel.costsBG(), dataModel.costsFG(), ws.right.data(), ws.down.data(), pool);
     }
+}
 
-    // add n-links (4-neighborhood : up down, left. right)
-    const double neg_beta = -beta;
-    
-    
-    for (int y = 0; y < H; ++y) {
-        const int row_offset = y * W;
-        for (int x = 0; x + 1 < W; ++x) {
-            const int u = row_offset + x;
-            const int v = row_offset + x + 1;
-            
-            const Vec3 cu = image.getColor(x, y);
-            const Vec3 cv = image.getColor(x + 1, y);
-            const double diff = simd::colorDistSq(cu, cv);
-            const double w = lambda * std::exp(neg_beta * diff);
-            
-            // Undirected edge
-            G->add_edge(u, v, w);
-            G->add_edge(v, u, w);
+/*
+The reduction in two passes over the labels:
+ 1. bounding box of the pixels that are not hard seeds, and the n-links between a hard fg and
+    a hard bg pixel (both ends fixed, the edge is in every cut and only adds to the flow)
+ 2. the crop (box plus at least one ring of hard pixels): t-links of the unknown pixels plus
+    the n-links to their hard neighbours, then every n-link with a hard end is zeroed, the
+    hard pixels inside the crop are isolated nodes
+n-link weights are only computed for the crop. beta is still the mean over the whole image,
+so every weight is the one buildGraph would use.
+*/
+template <typename Cap>
+std::unique_ptr<MaxFlow<Cap>> GraphBuilder<Cap>::buildReducedGraph(const SeedMask& seeds, int margin,
+                                                                   GraphReduction& red) {
+    ThreadPool pool(threads);
+    GraphWorkspace<Cap> ws;
+    std::unique_ptr<MaxFlow<Cap>> G;
+    buildReducedGraph(G, seeds, margin, red, ws, pool);
+    return G;
+}
+
+template <typename Cap>
+void GraphBuilder<Cap>::buildReducedGraph(std::unique_ptr<MaxFlow<Cap>>& G, const SeedMask& seeds, int margin,
+                                          GraphReduction& red, GraphWorkspace<Cap>& ws, ThreadPool& pool) {
+    Profiler::Scope scope("buildGraph");
+    using Sum = typename CapacityTraits<Cap>::Sum;
+    if (seeds.width() != W || seeds.height() != H) throw std::runtime_error("buildReducedGraph: seed mask size mismatch");
+
+    int32_t maxDist = 0;
+    double beta = computeBeta(image, &maxDist, &pool);
+    if (fixedBeta > 0.0) beta = fixedBeta;
+
+    red.W = W;
+    red.H = H;
+    red.fgHard = dataModel.hardFG();
+    red.bgHard = dataModel.hardBG();
+    const int8_t* labels = seeds.raw();
+    const bool fgHard = red.fgHard, bgHard = red.bgHard;
+    // 0 = in the graph, 1 = hard foreground, 2 = hard background
+    auto hard = [&](size_t i) -> int {
+        const int8_t l = labels[i];
+        return (l == 1 && fgHard) ? 1 : (l == 0 && bgHard) ? 2 : 0;
+    };
+    const Cap* DpBG = dataModel.costsBG();
+    const Cap* DpFG = dataModel.costsFG();
+    const uint8_t* P[3] = {image.plane(0), image.plane(1), image.plane(2)};
+    nlinkTable(lambda, beta, maxDist, ws.lut, &pool);
+    const std::vector<Cap>& lut = ws.lut;
+    auto weight = [&](size_t a, size_t b) {
+        int32_t d = 0;
+        for (int c = 0; c < 3; ++c) {
+            const int32_t diff = static_cast<int32_t>(P[c][a]) - static_cast<int32_t>(P[c][b]);
+            d += diff * diff;
         }
+        return lut[d];
+    };
+
+    // pass 1, the constant is summed per row and the rows in order (same value for any thread
+    // count), the box and the count are integers
+    int minX = W, minY = H, maxX = -1, maxY = -1;
+    {
+        Profiler::Scope reduce("reduceScan");
+        std::vector<Sum>& rowConst = ws.rowConst;
+        rowConst.assign(H, Sum(0));
+        std::atomic<int> boxMin[2] = {{W}, {H}}, boxMax[2] = {{-1}, {-1}};
+        std::atomic<size_t> unknownAll{0};
+        pool.parallelFor(0, static_cast<size_t>(H), [&](size_t r0, size_t r1, int) {
+            int box[4] = {W, H, -1, -1};
+            size_t unknown = 0;
+            for (size_t y = r0; y < r1; ++y) {
+                const size_t row = y * W;
+                Sum c = 0;
+                for (int x = 0; x < W; ++x) {
+                    const size_t i = row + x;
+                    const int h = hard(i);
+                    if (!h) {
+                        ++unknown;
+                        box[0] = std::min(box[0], x);
+                        box[1] = std::min(box[1], static_cast<int>(y));
+                        box[2] = std::max(box[2], x);
+                        box[3] = std::max(box[3], static_cast<int>(y));
+                        continue;
+                    }
+                    if (x + 1 < W) { const int o = hard(i + 1); if (o && o != h) c += weight(i, i + 1); }
+                    if (static_cast<int>(y) + 1 < H) { const int o = hard(i + W); if (o && o != h) c += weight(i, i + W); }
+                }
+                rowConst[y] = c;
+            }
+            atomicMin(boxMin[0], box[0]);
+            atomicMin(boxMin[1], box[1]);
+            atomicMax(boxMax[0], box[2]);
+            atomicMax(boxMax[1], box[3]);
+            unknownAll.fetch_add(unknown, std::memory_order_relaxed);
+        });
+        Sum total = 0;
+        for (int y = 0; y < H; ++y) total += rowConst[y];
+        red.constantFlow = CapacityTraits<Cap>::toCost(total);
+        minX = boxMin[0].load();
+        minY = boxMin[1].load();
+        maxX = boxMax[0].load();
+        maxY = boxMax[1].load();
+        red.unknown = unknownAll.load();
+    }
+
+    // with few hard pixels the extra passes cost more than the smaller graph saves:
+    // build the full graph, the reduction is then the identity (hard pixels keep their
+    // t-links and end up on their side of the cut anyway)
+    const size_t N = static_cast<size_t>(W) * H;
+    if ((N - red.unknown) * 8 < N) {
+        red.x0 = red.y0 = 0;
+        red.width = W;
+        red.height = H;
+        red.constantFlow = 0.0;
+        red.folded = false;
+        buildFull(G, beta, maxDist, ws, pool);
+        return;
+    }
+
+    // everything is seeded: keep a single (isolated) pixel so the engines still get a graph.
+    // The crop keeps at least one ring of hard pixels around the unknown ones, so every n-link
+    // that gets folded has both ends inside the crop
+    if (maxX < 0) { minX = maxX = 0; minY = maxY = 0; }
+    const int ring = std::max(1, margin);
+    red.x0 = std::max(0, minX - ring);
+    red.y0 = std::max(0, minY - ring);
+    red.width = std::min(W - 1, maxX + ring) - red.x0 + 1;
+    red.height = std::min(H - 1, maxY + ring) - red.y0 + 1;
+    const int cx = red.x0, cy = red.y0, cw = red.width, ch = red.height;
+    red.folded = true;
+
+    std::vector<Cap>& right = ws.right;
+    std::vector<Cap>& down = ws.down;
+    nlinkPlanes(lut, cx, cy, cw, ch, right, down, pool, ws.hugePages);
+
+    const size_t n = static_cast<size_t>(cw) * ch;
+    std::vector<Cap>& capS = ws.capS;
+    std::vector<Cap>& capT = ws.capT;
+    HugePages::resize(capS, n, ws.hugePages);
+    HugePages::resize(capT, n, ws.hugePages);
+    {
+        Profiler::Scope reduce("reduceFold");
+        pool.parallelFor(0, static_cast<size_t>(ch), [&](size_t r0, size_t r1, int) {
+            for (size_t ly = r0; ly < r1; ++ly) {
+                const size_t row = (cy + ly) * W + cx;
+                const bool lastRow = static_cast<int>(ly) + 1 == ch;
+                Cap* r = right.data() + ly * (cw - 1);
+                Cap* d = down.data() + ly * cw;
+                for (int lx = 0; lx < cw; ++lx) {
+                    const size_t i = row + lx, li = ly * cw + lx;
+                    if (hard(i)) {
+                        // isolated node, its n-links go to the neighbours' t-links
+                        capS[li] = 0;
+                        capT[li] = 0;
+                        continue;
+                    }
+                    // a fg neighbour pulls towards the source, a bg neighbour towards the sink.
+                    // Not on the crop border (the ring is hard), the image border has no neighbour
+                    Sum s = DpBG[i], t = DpFG[i];
+                    auto fold = [&](size_t q, Cap wq) {
+                        const int o = hard(q);
+                        if (o == 1) s += wq;
+                        else if (o == 2) t += wq;
+                    };
+                    if (lx > 0) fold(i - 1, r[lx - 1]);
+                    if (lx + 1 < cw) fold(i + 1, r[lx]);
+                    if (ly > 0) fold(i - W, d[static_cast<std::ptrdiff_t>(lx) - cw]);
+                    if (!lastRow) fold(i + W, d[lx]);
+                    capS[li] = static_cast<Cap>(s);
+                    capT[li] = static_cast<Cap>(t);
+                }
+            }
+        });
+        // only now drop the n-links with a hard end (the fold above still reads them)
+        pool.parallelFor(0, static_cast<size_t>(ch), [&](size_t r0, size_t r1, int) {
+            for (size_t ly = r0; ly < r1; ++ly) {
+                const size_t row = (cy + ly) * W + cx;
+                const bool lastRow = static_cast<int>(ly) + 1 == ch;
+                Cap* r = right.data() + ly * (cw - 1);
+                Cap* d = down.data() + ly * cw;
+                for (int lx = 0; lx < cw; ++lx) {
+                    const size_t i = row + lx;
+                    const bool h = hard(i) != 0;
+                    if (lx + 1 < cw && (h || hard(i + 1))) r[lx] = 0;
+                    if (!lastRow && (h || hard(i + W))) d[lx] = 0;
+                }
+            }
+        });
     }
-    
-    // Vertical edges
-    for (int y = 0; y + 1 < H; ++y) {
-        const int row_offset = y * W;
-        const int next_row = row_offset + W;
+    prepareEngine(G, cw, ch);
+    {
+        Profiler::Scope edges("addEdges");
+        G->add_grid_edges(cw, ch, capS.data(), capT.data(), right.data(), down.data(), pool);
+    }
+}
+
+std::vector<bool> GraphReduction::expand(const std::vector<bool>& cut, const SeedMask& seeds) const {
+    std::vector<bool> mask;
+    expand(cut, seeds, mask);
+    return mask;
+}
+
+void GraphReduction::expand(const std::vector<bool>& cut, const SeedMask& seeds, std::vector<bool>& mask) const {
+    // the full graph: the hard pixels are on their side of the cut already
+    if (!folded) {
+        mask.assign(cut.begin(), cut.begin() + static_cast<size_t>(W) * H);
+        return;
+    }
+    mask.assign(static_cast<size_t>(W) * H, false);
+    const int8_t* labels = seeds.raw();
+    for (int y = 0; y < H; ++y) {
         for (int x = 0; x < W; ++x) {
-            const int u = row_offset + x;
-            const int v = next_row + x;
-            
-            const Vec3 cu = image.getColor(x, y);
-            const Vec3 cv = image.getColor(x, y + 1);
-            const double diff = simd::colorDistSq(cu, cv);
-            const double w = lambda * std::exp(neg_beta * diff);
-            
-            G->add_edge(u, v, w);
-            G->add_edge(v, u, w);
+            const size_t i = static_cast<size_t>(y) * W + x;
+            const int8_t l = labels[i];
+            if ((l == 1 && fgHard) || (l == 0 && bgHard)) mask[i] = (l == 1);
+            else mask[i] = cut[static_cast<size_t>(y - y0) * width + (x - x0)];
         }
     }
-
-    return G;
 }
+
+template class GraphBuilder<double>;
+template class GraphBuilder<float>;
+template class GraphBuilder<int32_t>;
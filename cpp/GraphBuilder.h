@@ -1,26 +1,126 @@
 #pragma once
 #include "DataModel.h"
 #include "Image.h"
-#include "Dinic.h"
+#include "MaxFlow.h"
+#include "SeedMask.h"
 #include <memory>
+#include <vector>
+#include <cstdint>
 
+class ThreadPool;
+
+/*
+What GraphBuilder::buildReducedGraph left out of the graph.
+The graph is the crop (x0, y0, width, height) of the image: node (y - y0) * width + (x - x0),
+source = width * height, sink = width * height + 1. Hard seeded pixels inside the crop
+are isolated nodes, every pixel outside the crop is a hard seed.
+*/
+struct GraphReduction {
+    int W = 0, H = 0;                   // the whole image
+    int x0 = 0, y0 = 0, width = 0, height = 0;
+    bool fgHard = true, bgHard = true;  // which seeds counted as hard (DataModel::setHardSeeds)
+    bool folded = false;                // false: the full graph was built (few hard pixels), nothing to expand
+    size_t unknown = 0;                 // pixels that are not hard seeds
+    double constantFlow = 0.0;          // n-links between a hard fg and a hard bg pixel, cut by every solution
+
+    // W*H mask from the source side of the reduced graph's cut, hard seeds keep their label
+    std::vector<bool> expand(const std::vector<bool>& cut, const SeedMask& seeds) const;
+    // same into a caller buffer (its storage is reused)
+    void expand(const std::vector<bool>& cut, const SeedMask& seeds, std::vector<bool>& mask) const;
+};
+
+/*
+Buffers of one graph build: the n-link table and planes, the folded t-links of the reduced
+graph and its per-row sums. The plain buildGraph / buildReducedGraph use a fresh one every
+call, SegmentationContext keeps one from run to run so they never allocate again.
+*/
+template <typename Cap>
+struct GraphWorkspace {
+    std::vector<Cap> lut, right, down, capS, capT;
+    std::vector<typename CapacityTraits<Cap>::Sum> rowConst;
+    bool hugePages = false;     // the planes go through HugePages
+
+    size_t bytes() const {
+        return (lut.capacity() + right.capacity() + down.capacity() + capS.capacity() + capT.capacity()) * sizeof(Cap)
+             + rowConst.capacity() * sizeof(typename CapacityTraits<Cap>::Sum);
+    }
+};
+
+// Cap: capacity type of the graph, n-link weights are quantized with CapacityTraits<Cap>
+template <typename Cap>
 class GraphBuilder {
 public:
     GraphBuilder(
         const Image& img, 
-        const DataModel& dm, 
-        double lambda = 50.0
+        const DataModel<Cap>& dm, 
+        double lambda = 50.0,
+        SolverType solver = SolverType::Dinic,
+        int threads = 0
     );
 
-    // builds Dinic graph and returns owned pointer to it
+    // builds the graph on the selected max-flow engine and returns owned pointer to it
     // nodes: 0 .. (W*H-1), source = W*H, sink = W*H+1
-    std::unique_ptr<Dinic> buildGraph();
+    // beta, the n-link weights and the edge insertion run on `threads` workers
+    std::unique_ptr<MaxFlow<Cap>> buildGraph();
 
-    static double computeBeta(const Image& img);
+    /* Same cut with a smaller graph: every pixel with a hard seed (see DataModel::setHardSeeds)
+       is folded into its terminal, an n-link to an unknown neighbour becomes part of that
+       neighbour's t-link (source side for a foreground seed, sink side for background),
+       and the graph is cropped to the bounding box of the remaining pixels plus `margin`.
+       The hard seeds never change sides (their t-link is far above any cut through a
+       pixel), so the source side of the reduced cut plus the foreground seeds is the mask
+       of the full graph. `red` gets the crop, see GraphReduction. When less than 1/8 of
+       the pixels are hard the full graph is built instead (red is then the whole image). */
+    std::unique_ptr<MaxFlow<Cap>> buildReducedGraph(const SeedMask& seeds, int margin, GraphReduction& red);
+
+    /* Same two builds for reuse (SegmentationContext): the graph goes into G, which is reset
+       to the new size (MaxFlow::resetGrid) or created if it is null, every buffer comes from
+       ws and the work is split across pool. */
+    void buildGraph(std::unique_ptr<MaxFlow<Cap>>& G, GraphWorkspace<Cap>& ws, ThreadPool& pool);
+    void buildReducedGraph(std::unique_ptr<MaxFlow<Cap>>& G, const SeedMask& seeds, int margin, GraphReduction& red,
+                           GraphWorkspace<Cap>& ws, ThreadPool& pool);
+
+    // use this beta instead of the one of the image, e.g. every tile of a tiled run
+    // shares the beta of the whole image so the n-links agree across the seams
+    void setBeta(double b) { fixedBeta = b; }
+
+    // maxDist (optional): largest squared colour distance between two neighbours
+    // pool (optional): rows are split across it, the sum is exact so the result never
+    // depends on the number of workers
+    static double computeBeta(const Image& img, int32_t* maxDist = nullptr, ThreadPool* pool = nullptr);
+
+    /* n-link weight planes lambda * exp(-beta * |Ip - Iq|^2), quantized to Cap
+       right[y * (W-1) + x]: edge (x, y) - (x+1, y)
+       down[y * W + x]:      edge (x, y) - (x, y+1)
+       Distances are exact int32 from the planar image (8 pixels per AVX2 op), the weight
+       comes from a table indexed by the distance (maxDist from computeBeta).
+       Rows are split across the pool if one is given. */
+    void nlinkWeights(double beta, int32_t maxDist, std::vector<Cap>& right, std::vector<Cap>& down,
+                      ThreadPool* pool = nullptr) const;
+    // same for the w x h region at (x0, y0): right[(y-y0) * (w-1) + (x-x0)], down[(y-y0) * w + (x-x0)]
+    void nlinkWeights(double beta, int32_t maxDist, int x0, int y0, int w, int h,
+                      std::vector<Cap>& right, std::vector<Cap>& down, ThreadPool* pool = nullptr) const;
+
+    // the table behind nlinkWeights: entry d is the weight of an n-link with squared colour
+    // distance d, for d = 0 .. maxDist
+    static std::vector<Cap> nlinkTable(double lambda, double beta, int32_t maxDist, ThreadPool* pool = nullptr);
+    static void nlinkTable(double lambda, double beta, int32_t maxDist, std::vector<Cap>& lut, ThreadPool* pool = nullptr);
 
 private:
     const Image& image;
-    const DataModel& dataModel;
+    const DataModel<Cap>& dataModel;
     int W, H;
     double lambda;
+    SolverType solver;
+    int threads;
+    double fixedBeta = 0.0;     // <= 0: compute from the image
+
+    // buildGraph once beta is known
+    void buildFull(std::unique_ptr<MaxFlow<Cap>>& G, double beta, int32_t maxDist, GraphWorkspace<Cap>& ws,
+                   ThreadPool& pool);
+    // G reset to (or created as) an empty w x h pixel graph
+    void prepareEngine(std::unique_ptr<MaxFlow<Cap>>& G, int w, int h) const;
+    // the planes of nlinkWeights from a filled table (nlinkTable)
+    void nlinkPlanes(const std::vector<Cap>& lut, int x0, int y0, int w, int h, std::vector<Cap>& right,
+                     std::vector<Cap>& down, ThreadPool& pool, bool huge = false) const;
 };
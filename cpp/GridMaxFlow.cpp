@@ -0,0 +1,514 @@
+#include "GridMaxFlow.h"
+#include "Profiler.h"
+#include "ThreadPool.h"
+#include "HugePages.h"
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <cstdint>
+
+template <typename Cap>
+GridMaxFlow<Cap>::GridMaxFlow(int W_, int H_)
+    : W(W_), H(H_), N(W_ * H_), offs{1, -1, W_, -W_},
+      tr(static_cast<size_t>(W_) * H_, 0),
+      parent(static_cast<size_t>(W_) * H_, NO_PARENT),
+      isSink(static_cast<size_t>(W_) * H_, 0),
+      ts(static_cast<size_t>(W_) * H_, 0),
+      dist(static_cast<size_t>(W_) * H_, 0),
+      inQueue(static_cast<size_t>(W_) * H_, 0),
+      isChanged(static_cast<size_t>(W_) * H_, 0)
+{
+    for (auto &plane : cap) plane.assign(static_cast<size_t>(N), 0);
+}
+
+template <typename Cap>
+void GridMaxFlow<Cap>::resetGrid(int W_, int H_) {
+    W = W_;
+    H = H_;
+    N = W_ * H_;
+    offs[0] = 1; offs[1] = -1; offs[2] = W_; offs[3] = -W_;
+    const size_t n = static_cast<size_t>(N);
+    const bool huge = this->hugePages;
+    for (auto &plane : cap) HugePages::assign(plane, n, Cap(0), huge);
+    HugePages::assign(tr, n, Cap(0), huge);
+    HugePages::assign(parent, n, NO_PARENT, huge);
+    HugePages::assign(isSink, n, char(0), huge);
+    HugePages::assign(ts, n, 0, huge);
+    HugePages::assign(dist, n, 0, huge);
+    HugePages::assign(inQueue, n, char(0), huge);
+    HugePages::assign(isChanged, n, char(0), huge);
+    active.clear();
+    orphans.clear();
+    changed.clear();
+    time = 0;
+    flow = 0;
+    solved = false;
+}
+
+/* Terminal edges go into tr[], if a pixel gets both a source and a sink edge the common
+   part is pushed right away (same trick as BoykovKolmogorov::foldTerminalEdges).
+   Pixel-pixel edges are mapped to the direction plane from the index difference. */
+template <typename Cap>
+void GridMaxFlow<Cap>::add_edge(int u, int v, Cap c, Cap rev_c) {
+    const int source = N, sink = N + 1;
+    if (u == source && v < N) {
+        if (tr[v] < 0) flow += std::min(-tr[v], c);
+        tr[v] += c;
+        return;
+    }
+    if (v == sink && u < N) {
+        if (tr[u] > 0) flow += std::min(tr[u], c);
+        tr[u] -= c;
+        return;
+    }
+    if (u == source && v == sink) { flow += c; return; }
+    if (u >= N || v >= N) return;   // edges into the source / out of the sink never carry flow
+
+    for (int d = 0; d < 4; ++d) {
+        if (v - u == offs[d] && hasNeighbor(u, d)) {
+            cap[d][u] += c;
+            cap[d ^ 1][v] += rev_c;
+            return;
+        }
+    }
+    throw std::runtime_error("GridMaxFlow: edge is not between 4-neighbours");
+}
+
+/* Same result as the add_edge calls, but every row only touches its own slots of tr and
+   the planes (the -y plane of the row below is only written by this row's down edges).
+   The flow pushed while folding terminal edges is summed per row and the rows are added
+   in order afterwards, so the total does not depend on how the rows were split. */
+template <typename Cap>
+void GridMaxFlow<Cap>::add_grid_edges(int W_, int H_, const Cap* capS, const Cap* capT,
+                                      const Cap* right, const Cap* down, ThreadPool& pool) {
+    if (W_ != W || H_ != H) throw std::runtime_error("GridMaxFlow: grid size does not match the graph");
+    rowFlow.assign(H, 0);
+    pool.parallelFor(0, static_cast<size_t>(H), [&](size_t y0, size_t y1, int) {
+        for (size_t y = y0; y < y1; ++y) {
+            const int row = static_cast<int>(y) * W;
+            Sum f = 0;
+            for (int p = row; p < row + W; ++p) {
+                Cap t = tr[p];
+                if (t < 0) f += std::min(-t, capS[p]);
+                t += capS[p];
+                if (t > 0) f += std::min(t, capT[p]);
+                tr[p] = t - capT[p];
+            }
+            rowFlow[y] = f;
+
+            const Cap* r = right + y * (W - 1);
+            for (int x = 0; x + 1 < W; ++x) {
+                cap[0][row + x] += r[x];
+                cap[1][row + x + 1] += r[x];
+            }
+            if (static_cast<int>(y) + 1 < H) {
+                const Cap* d = down + row;
+                for (int x = 0; x < W; ++x) {
+                    cap[2][row + x] += d[x];
+                    cap[3][row + W + x] += d[x];
+                }
+            }
+        }
+    });
+    for (int y = 0; y < H; ++y) flow += rowFlow[y];
+}
+
+// see BoykovKolmogorov::add_tweights
+template <typename Cap>
+void GridMaxFlow<Cap>::add_tweights(int v, Cap capSource, Cap capSink) {
+    const Cap delta = tr[v];
+    if (delta > 0) capSource += delta;
+    else capSink -= delta;
+    flow += std::min(capSource, capSink);
+    tr[v] = capSource - capSink;
+    markChanged(v);
+}
+
+template <typename Cap>
+void GridMaxFlow<Cap>::markChanged(int v) {
+    if (solved && !isChanged[v]) {
+        isChanged[v] = 1;
+        changed.push_back(v);
+    }
+}
+
+// see BoykovKolmogorov::add_nweights
+template <typename Cap>
+void GridMaxFlow<Cap>::add_nweights(int u, int v, Cap delta) {
+    int d = 0;
+    while (d < 4 && !(v - u == offs[d] && hasNeighbor(u, d))) ++d;
+    if (d == 4) throw std::runtime_error("GridMaxFlow: edge is not between 4-neighbours");
+    Cap& forward = cap[d][u];
+    Cap& backward = cap[d ^ 1][v];
+
+    forward += delta;
+    backward += delta;
+    if (forward < 0) {
+        const Cap e = -forward;
+        forward = 0;
+        backward -= e;
+        add_tweights(u, e, 0);
+        add_tweights(v, 0, e);
+        flow -= e;
+    } else if (backward < 0) {
+        const Cap e = -backward;
+        backward = 0;
+        forward -= e;
+        add_tweights(v, e, 0);
+        add_tweights(u, 0, e);
+        flow -= e;
+    }
+    markChanged(u);
+    markChanged(v);
+}
+
+template <typename Cap>
+bool GridMaxFlow<Cap>::parentArcResidual(int v) const {
+    const int p = parent[v];
+    return isSink[v] ? cap[p][v] > 0 : cap[p ^ 1][v + offs[p]] > 0;
+}
+
+template <typename Cap>
+void GridMaxFlow<Cap>::setActive(int v) {
+    if (!inQueue[v]) {
+        inQueue[v] = 1;
+        active.push_back(v);
+    }
+}
+
+template <typename Cap>
+int GridMaxFlow<Cap>::nextActive() {
+    while (!active.empty()) {
+        int v = active.front();
+        active.pop_front();
+        inQueue[v] = 0;
+        if (parent[v] != NO_PARENT) return v;
+    }
+    return -1;
+}
+
+/* the path goes source -> ... -> i -> (i + offs[d]) -> ... -> sink
+   S side: a node's parent pushes into it, so the arc used is parent -> node
+   T side: a node pushes into its parent, so the arc used is node -> parent */
+template <typename Cap>
+void GridMaxFlow<Cap>::augment(int i, int d) {
+    Cap bottleneck = cap[d][i];
+    uint64_t length = 1;
+
+    for (int v = i; ; ) {
+        const int p = parent[v];
+        if (p == TERMINAL) { bottleneck = std::min(bottleneck, tr[v]); break; }
+        const int u = v + offs[p];
+        bottleneck = std::min(bottleneck, cap[p ^ 1][u]);
+        v = u;
+        ++length;
+    }
+    for (int v = i + offs[d]; ; ) {
+        const int p = parent[v];
+        if (p == TERMINAL) { bottleneck = std::min(bottleneck, -tr[v]); break; }
+        bottleneck = std::min(bottleneck, cap[p][v]);
+        v += offs[p];
+        ++length;
+    }
+
+    cap[d][i] -= bottleneck;
+    cap[d ^ 1][i + offs[d]] += bottleneck;
+
+    for (int v = i; ; ) {
+        const int p = parent[v];
+        if (p == TERMINAL) {
+            tr[v] -= bottleneck;
+            if (tr[v] <= 0) { parent[v] = ORPHAN; orphans.push_front(v); }
+            break;
+        }
+        const int u = v + offs[p];
+        cap[p ^ 1][u] -= bottleneck;
+        cap[p][v] += bottleneck;
+        if (cap[p ^ 1][u] <= 0) { parent[v] = ORPHAN; orphans.push_front(v); }
+        v = u;
+    }
+    for (int v = i + offs[d]; ; ) {
+        const int p = parent[v];
+        if (p == TERMINAL) {
+            tr[v] += bottleneck;
+            if (tr[v] >= 0) { parent[v] = ORPHAN; orphans.push_front(v); }
+            break;
+        }
+        const int u = v + offs[p];
+        cap[p][v] -= bottleneck;
+        cap[p ^ 1][u] += bottleneck;
+        if (cap[p][v] <= 0) { parent[v] = ORPHAN; orphans.push_front(v); }
+        v = u;
+    }
+
+    flow += bottleneck;
+    ++this->counters.augmentations;
+    this->counters.pathArcs += length;
+}
+
+// same as BoykovKolmogorov::adoptSource, with neighbours computed from the direction
+template <typename Cap>
+void GridMaxFlow<Cap>::adoptSource(int v) {
+    const int INF_D = std::numeric_limits<int>::max();
+    int bestDir = NO_PARENT;
+    int bestDist = INF_D;
+
+    for (int d = 0; d < 4; ++d) {
+        if (!hasNeighbor(v, d)) continue;
+        const int j = v + offs[d];
+        if (cap[d ^ 1][j] <= 0) continue;
+        if (isSink[j] || parent[j] == NO_PARENT) continue;
+
+        int dd = 0;
+        int k = j;
+        while (true) {
+            if (ts[k] == time) { dd += dist[k]; break; }
+            const int p = parent[k];
+            ++dd;
+            if (p == TERMINAL) { ts[k] = time; dist[k] = 1; break; }
+            if (p == ORPHAN) { dd = INF_D; break; }
+            k += offs[p];
+        }
+        if (dd < INF_D) {
+            if (dd < bestDist) { bestDir = d; bestDist = dd; }
+            for (k = j; ts[k] != time; k += offs[parent[k]]) {
+                ts[k] = time;
+                dist[k] = dd--;
+            }
+        }
+    }
+
+    if (bestDir != NO_PARENT) {
+        parent[v] = static_cast<int8_t>(bestDir);
+        ts[v] = time;
+        dist[v] = bestDist + 1;
+        return;
+    }
+
+    for (int d = 0; d < 4; ++d) {
+        if (!hasNeighbor(v, d)) continue;
+        const int j = v + offs[d];
+        if (isSink[j]) continue;
+        const int p = parent[j];
+        if (p == NO_PARENT) continue;
+        if (cap[d ^ 1][j] > 0) setActive(j);
+        if (p == (d ^ 1)) {
+            parent[j] = ORPHAN;
+            orphans.push_back(j);
+        }
+    }
+    parent[v] = NO_PARENT;
+}
+
+template <typename Cap>
+void GridMaxFlow<Cap>::adoptSink(int v) {
+    const int INF_D = std::numeric_limits<int>::max();
+    int bestDir = NO_PARENT;
+    int bestDist = INF_D;
+
+    for (int d = 0; d < 4; ++d) {
+        if (cap[d][v] <= 0) continue;     // zero on the border, so j is valid below
+        const int j = v + offs[d];
+        if (!isSink[j] || parent[j] == NO_PARENT) continue;
+
+        int dd = 0;
+        int k = j;
+        while (true) {
+            if (ts[k] == time) { dd += dist[k]; break; }
+            const int p = parent[k];
+            ++dd;
+            if (p == TERMINAL) { ts[k] = time; dist[k] = 1; break; }
+            if (p == ORPHAN) { dd = INF_D; break; }
+            k += offs[p];
+        }
+        if (dd < INF_D) {
+            if (dd < bestDist) { bestDir = d; bestDist = dd; }
+            for (k = j; ts[k] != time; k += offs[parent[k]]) {
+                ts[k] = time;
+                dist[k] = dd--;
+            }
+        }
+    }
+
+    if (bestDir != NO_PARENT) {
+        parent[v] = static_cast<int8_t>(bestDir);
+        ts[v] = time;
+        dist[v] = bestDist + 1;
+        return;
+    }
+
+    for (int d = 0; d < 4; ++d) {
+        if (!hasNeighbor(v, d)) continue;
+        const int j = v + offs[d];
+        if (!isSink[j]) continue;
+        const int p = parent[j];
+        if (p == NO_PARENT) continue;
+        if (cap[d][v] > 0) setActive(j);
+        if (p == (d ^ 1)) {
+            parent[j] = ORPHAN;
+            orphans.push_back(j);
+        }
+    }
+    parent[v] = NO_PARENT;
+}
+
+template <typename Cap>
+void GridMaxFlow<Cap>::adoptOrphans() {
+    while (!orphans.empty()) {
+        const int v = orphans.front();
+        orphans.pop_front();
+        if (parent[v] != ORPHAN) continue;
+        ++this->counters.orphans;
+        if (isSink[v]) adoptSink(v);
+        else adoptSource(v);
+    }
+}
+
+// same as BoykovKolmogorov::reuseTrees, children are the neighbours whose parent direction points back at v
+template <typename Cap>
+void GridMaxFlow<Cap>::reuseTrees() {
+    ++time;
+    for (const int v : changed) {
+        isChanged[v] = 0;
+        if (tr[v] != 0) {
+            const char toSink = tr[v] < 0 ? 1 : 0;
+            if (parent[v] != NO_PARENT && isSink[v] != toSink) {
+                for (int d = 0; d < 4; ++d) {
+                    if (!hasNeighbor(v, d)) continue;
+                    const int j = v + offs[d];
+                    if (parent[j] == NO_PARENT || isSink[j] != isSink[v]) continue;
+                    if (parent[j] == (d ^ 1)) {
+                        parent[j] = ORPHAN;
+                        orphans.push_back(j);
+                    }
+                    // residual j -> v (old source tree) or v -> j (old sink tree)
+                    if (isSink[v] ? cap[d][v] > 0 : cap[d ^ 1][j] > 0) setActive(j);
+                }
+            }
+            isSink[v] = toSink;
+            parent[v] = TERMINAL;
+            ts[v] = time;
+            dist[v] = 1;
+        } else if (parent[v] == TERMINAL) {
+            parent[v] = ORPHAN;
+            orphans.push_back(v);
+        } else if (parent[v] < TERMINAL) {
+            // see BoykovKolmogorov::reuseTrees
+            if (!parentArcResidual(v)) {
+                parent[v] = ORPHAN;
+                orphans.push_back(v);
+            }
+        }
+    }
+    adoptOrphans();
+    for (const int v : changed)
+        if (parent[v] != NO_PARENT) setActive(v);
+    changed.clear();
+}
+
+template <typename Cap>
+double GridMaxFlow<Cap>::max_flow(int s, int t) {
+    if (s != N || t != N + 1)
+        throw std::runtime_error("GridMaxFlow: source/sink must be W*H and W*H+1");
+    Profiler::Scope scope("max_flow");
+    this->counters = SolverStats();
+
+    if (solved) {
+        reuseTrees();
+    } else {
+        active.clear();
+        orphans.clear();
+        std::fill(inQueue.begin(), inQueue.end(), 0);
+        time = 0;
+
+        for (int v = 0; v < N; ++v) {
+            ts[v] = 0;
+            if (tr[v] > 0) {
+                isSink[v] = 0; parent[v] = TERMINAL; dist[v] = 1; setActive(v);
+            } else if (tr[v] < 0) {
+                isSink[v] = 1; parent[v] = TERMINAL; dist[v] = 1; setActive(v);
+            } else {
+                parent[v] = NO_PARENT;
+            }
+        }
+        solved = true;
+    }
+
+    uint64_t steps = 0;
+    int current = -1;
+    while (true) {
+        int i = current;
+        if (i != -1 && parent[i] == NO_PARENT) i = -1;
+        if (i == -1) {
+            i = nextActive();
+            if (i == -1) break;
+        }
+
+        int middleDir = -1;     // arc i -> i + offs[middleDir] (S side -> T side)
+        int middleFrom = -1;
+        if (!isSink[i]) {
+            for (int d = 0; d < 4; ++d) {
+                if (cap[d][i] <= 0) continue;
+                const int j = i + offs[d];
+                if (parent[j] == NO_PARENT) {
+                    isSink[j] = 0; parent[j] = static_cast<int8_t>(d ^ 1);
+                    ts[j] = ts[i]; dist[j] = dist[i] + 1;
+                    setActive(j);
+                } else if (isSink[j]) {
+                    middleFrom = i; middleDir = d;
+                    break;
+                } else if (ts[j] <= ts[i] && dist[j] > dist[i]) {
+                    parent[j] = static_cast<int8_t>(d ^ 1);
+                    ts[j] = ts[i]; dist[j] = dist[i] + 1;
+                }
+            }
+        } else {
+            for (int d = 0; d < 4; ++d) {
+                if (!hasNeighbor(i, d)) continue;
+                const int j = i + offs[d];
+                if (cap[d ^ 1][j] <= 0) continue;
+                if (parent[j] == NO_PARENT) {
+                    isSink[j] = 1; parent[j] = static_cast<int8_t>(d ^ 1);
+                    ts[j] = ts[i]; dist[j] = dist[i] + 1;
+                    setActive(j);
+                } else if (!isSink[j]) {
+                    middleFrom = j; middleDir = d ^ 1;
+                    break;
+                } else if (ts[j] <= ts[i] && dist[j] > dist[i]) {
+                    parent[j] = static_cast<int8_t>(d ^ 1);
+                    ts[j] = ts[i]; dist[j] = dist[i] + 1;
+                }
+            }
+        }
+
+        ++time;
+        ++steps;
+        if (middleDir != -1) {
+            current = i;
+            augment(middleFrom, middleDir);
+            adoptOrphans();
+        } else {
+            current = -1;
+        }
+    }
+    this->counters.phases = steps;
+    const size_t arcs = 2 * (static_cast<size_t>(W - 1) * H + static_cast<size_t>(W) * (H - 1)) + 2 * static_cast<size_t>(N);
+    this->reportStats("grid", static_cast<size_t>(N) + 2, arcs,
+        static_cast<size_t>(N) * (5 * sizeof(Cap) + sizeof(int8_t) + 2 + 2 * sizeof(int))
+        + changed.capacity() * sizeof(int) + isChanged.capacity());
+    return Traits::toCost(flow);
+}
+
+template <typename Cap>
+void GridMaxFlow<Cap>::minCut(int s, std::vector<bool>& seen) const {
+    Profiler::Scope scope("minCut");
+    seen.assign(static_cast<size_t>(N) + 2, false);
+    for (int v = 0; v < N; ++v) {
+        if (parent[v] != NO_PARENT && !isSink[v]) seen[v] = true;
+    }
+    seen[s] = true;
+}
+
+template class GridMaxFlow<double>;
+template class GridMaxFlow<float>;
+template class GridMaxFlow<int32_t>;
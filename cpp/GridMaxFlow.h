@@ -0,0 +1,87 @@
+#pragma once
+#include "MaxFlow.h"
+#include <vector>
+#include "RingDeque.h"
+#include <cstdint>
+
+/* Boykov-Kolmogorov max-flow specialised for the 4-connected pixel grid GraphBuilder creates.
+
+   Every node is a pixel and its neighbours sit at fixed offsets (+1, -1, +W, -W), so we never
+   store adjacency at all: no head, no sister, no offsets. We only keep
+   - one residual capacity plane per direction (cap[d][p] = residual of p -> neighbour in d)
+   - the signed terminal capacity tr[p] (> 0: from source, < 0: to sink)
+   - the search tree state, with the parent stored as a direction (1 byte)
+   That is ~50 bytes per pixel instead of ~150 for the CSR graph, which is what lets us
+   handle very large scans.
+
+   Node numbering follows GraphBuilder: pixels 0 .. W*H-1, source = W*H, sink = W*H+1.
+   add_edge() accepts only terminal edges and edges between 4-neighbours.
+   Like BoykovKolmogorov it supports add_tweights + another max_flow (dynamic graph cuts). */
+template <typename Cap>
+class GridMaxFlow : public MaxFlow<Cap> {
+public:
+    using Traits = CapacityTraits<Cap>;
+    using Sum = typename Traits::Sum;
+
+    GridMaxFlow(int W, int H);
+    void add_edge(int u, int v, Cap cap, Cap rev_cap = Cap(0)) override;
+    void add_grid_edges(int W, int H, const Cap* capS, const Cap* capT,
+                        const Cap* right, const Cap* down, ThreadPool& pool) override;
+    double max_flow(int s, int t) override;
+    using MaxFlow<Cap>::minCut;
+    void minCut(int s, std::vector<bool>& seen) const override;
+    void resetGrid(int W, int H) override;
+
+    bool supportsIncremental() const override { return true; }
+    void add_tweights(int v, Cap capSource, Cap capSink) override;
+    void add_nweights(int u, int v, Cap delta) override;
+
+private:
+    // directions: 0 = +x, 1 = -x, 2 = +y, 3 = -y, the opposite direction is d ^ 1
+    static constexpr int8_t TERMINAL  = 4;
+    static constexpr int8_t ORPHAN    = 5;
+    static constexpr int8_t NO_PARENT = 6;
+
+    int W, H, N;
+    int offs[4];
+
+    std::vector<Cap> cap[4];        // residual capacity planes
+    std::vector<Cap> tr;            // signed terminal residual capacity
+    std::vector<int8_t> parent;     // direction to the parent in the tree
+    std::vector<char> isSink;
+    std::vector<int> ts;
+    std::vector<int> dist;
+    std::vector<char> inQueue;
+
+    RingDeque<int> active;
+    RingDeque<int> orphans;
+    int time = 0;
+    Sum flow = 0;
+    bool solved = false;
+
+    // pixels whose t-links or n-links changed since the last max_flow
+    std::vector<int> changed;
+    std::vector<char> isChanged;
+
+    std::vector<Sum> rowFlow;       // add_grid_edges, flow folded per row
+
+    // is there a pixel next to p in direction d
+    bool hasNeighbor(int p, int d) const {
+        switch (d) {
+            case 0: return p % W != W - 1;
+            case 1: return p % W != 0;
+            case 2: return p + W < N;
+            default: return p >= W;
+        }
+    }
+    void setActive(int v);
+    int nextActive();
+    void augment(int i, int d);
+    void adoptSource(int v);
+    void adoptSink(int v);
+    void adoptOrphans();
+    void reuseTrees();
+    void markChanged(int v);
+    // the residual reaching a source tree node from its parent / leaving a sink tree node towards it
+    bool parentArcResidual(int v) const;
+};
@@ -0,0 +1,20 @@
+#include "HugePages.h"
+#include <cstdint>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+size_t HugePages::advise(void* p, size_t bytes) {
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+    const uintptr_t begin = (reinterpret_cast<uintptr_t>(p) + PAGE - 1) & ~(uintptr_t(PAGE) - 1);
+    const uintptr_t end = (reinterpret_cast<uintptr_t>(p) + bytes) & ~(uintptr_t(PAGE) - 1);
+    if (end <= begin) return 0;
+    if (madvise(reinterpret_cast<void*>(begin), end - begin, MADV_HUGEPAGE) != 0) return 0;
+    return end - begin;
+#else
+    (void)p;
+    (void)bytes;
+    return 0;
+#endif
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include <vector>
+#include <cstddef>
+
+/*
+Transparent huge pages for the big per-pixel arrays (--huge-pages, SegmentationContext).
+
+A 1080p graph is a few hundred MB of arrays that are walked in no particular order by the
+solvers, with 4 KB pages that is tens of thousands of TLB entries. madvise(MADV_HUGEPAGE)
+asks the kernel to back a range with 2 MB pages as it gets touched, it has to happen
+before the first write (pages already faulted in are only merged later, if at all).
+The kernel may still fall back to small pages (THP disabled, fragmented memory), nothing
+changes functionally either way. Linux only, elsewhere advise is a no-op.
+*/
+struct HugePages {
+    static constexpr size_t PAGE = size_t(2) << 20;
+
+    // madvise the 2 MB aligned part of [p, p + bytes), returns the bytes covered
+    static size_t advise(void* p, size_t bytes);
+
+    /* v.size() == n afterwards. If huge is set and v has to grow to at least one huge page,
+       the new buffer is advised before anything is written to it; the old contents are NOT
+       kept in that case, so this is only for buffers that are overwritten next. */
+    template <typename T>
+    static void resize(std::vector<T>& v, size_t n, bool huge) {
+        if (huge && n > v.capacity() && n * sizeof(T) >= PAGE) {
+            std::vector<T>().swap(v);
+            v.reserve(n);
+            advise(v.data(), n * sizeof(T));
+        }
+        v.resize(n);
+    }
+
+    // same with every element set to value
+    template <typename T>
+    static void assign(std::vector<T>& v, size_t n, const T& value, bool huge) {
+        if (huge && n > v.capacity() && n * sizeof(T) >= PAGE) {
+            std::vector<T>().swap(v);
+            v.reserve(n);
+            advise(v.data(), n * sizeof(T));
+        }
+        v.assign(n, value);
+    }
+};
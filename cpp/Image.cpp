@@ -1,28 +1,78 @@
 #include "Image.h"
-#include <fstream>
-#include <iostream>
+#include "MappedFile.h"
+#include "Profiler.h"
+#include <utility>
+#include <algorithm>
 
 Image::Image(const std::string& path, int width, int height, int channels)
     : W(width), H(height), C(channels)
 {
     const size_t expected = static_cast<size_t>(W) * H * C;
-    data.reserve(expected);  // Reserve before resize for efficiency
-    data.resize(expected);
-    
-    std::ifstream in(path, std::ios::binary);
-    if (!in) throw std::runtime_error("Image: failed to open " + path);
-    
-    in.read(reinterpret_cast<char*>(data.data()), expected);
-    if (!in) throw std::runtime_error("Image: failed to read expected bytes from " + path);
+    mapping = std::make_shared<const MappedFile>(path);
+    if (mapping->size() < expected)
+        throw std::runtime_error("Image: failed to read expected bytes from " + path);
+    data = mapping->data();
 }
 
 
-//Alternative constructur not being used in our project
-Image::Image(const std::vector<uint8_t>& raw, int width, int height, int channels)
-    : W(width), H(height), C(channels), data(raw)
+Image::Image(std::vector<uint8_t> raw, int width, int height, int channels)
+    : W(width), H(height), C(channels), owned(std::move(raw))
 {
-    if (data.size() != static_cast<size_t>(W) * H * C)
+    if (owned.size() != static_cast<size_t>(W) * H * C)
         throw std::runtime_error("Image: raw data size mismatch");
+    data = owned.data();
 }
 
+Image::Image(const uint8_t* pixels, int width, int height, int channels)
+    : W(width), H(height), C(channels), data(pixels)
+{
+    if (!pixels || W <= 0 || H <= 0) throw std::runtime_error("Image: empty pixel buffer");
+}
 
+const uint8_t* Image::plane(int c) const {
+    if (!planar->built.load(std::memory_order_acquire)) {
+        std::lock_guard<std::mutex> lock(planar->m);
+        if (!planar->built.load(std::memory_order_relaxed)) {
+            Profiler::Scope scope("imagePlanes");
+            const size_t N = static_cast<size_t>(W) * H;
+            planar->planes.resize(N * C);
+            Profiler::global().memory("image_planes", N * C);
+            for (int k = 0; k < C; ++k) {
+                uint8_t* dst = planar->planes.data() + k * N;
+                const uint8_t* src = data + k;
+                for (size_t i = 0; i < N; ++i) dst[i] = src[i * C];
+            }
+            planar->built.store(true, std::memory_order_release);
+        }
+    }
+    return planar->planes.data() + static_cast<size_t>(c) * W * H;
+}
+
+void Image::lendPlanes(std::vector<uint8_t>& storage) const {
+    std::lock_guard<std::mutex> lock(planar->m);
+    if (!planar->built.load(std::memory_order_relaxed)) planar->planes.swap(storage);
+}
+
+void Image::returnPlanes(std::vector<uint8_t>& storage) const {
+    std::lock_guard<std::mutex> lock(planar->m);
+    planar->planes.swap(storage);
+    planar->built.store(false, std::memory_order_relaxed);
+}
+
+Image Image::downsample2x() const {
+    const int w = (W + 1) / 2, h = (H + 1) / 2;
+    std::vector<uint8_t> out(static_cast<size_t>(w) * h * C);
+    for (int y = 0; y < h; ++y) {
+        const int y0 = 2 * y, y1 = std::min(2 * y + 1, H - 1);
+        for (int x = 0; x < w; ++x) {
+            const int x0 = 2 * x, x1 = std::min(2 * x + 1, W - 1);
+            // edge blocks of odd sized images just count a pixel twice
+            const size_t a = (static_cast<size_t>(y0) * W + x0) * C, b = (static_cast<size_t>(y0) * W + x1) * C;
+            const size_t c = (static_cast<size_t>(y1) * W + x0) * C, d = (static_cast<size_t>(y1) * W + x1) * C;
+            uint8_t* o = &out[(static_cast<size_t>(y) * w + x) * C];
+            for (int k = 0; k < C; ++k)
+                o[k] = static_cast<uint8_t>((data[a + k] + data[b + k] + data[c + k] + data[d + k] + 2) / 4);
+        }
+    }
+    return Image(std::move(out), w, h, C);
+}
@@ -1,9 +1,14 @@
 #pragma once
 #include <string>
 #include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
 #include <cstdint>
 #include <stdexcept>
 
+class MappedFile;
+
 struct Vec3 {
     double r, g, b;
 };
@@ -11,10 +16,24 @@ struct Vec3 {
 class Image {
 public:
     // Load from raw binary file written by Python: uint8 RGB interleaved, row-major
+    // The file is memory mapped, pixels are read straight from the mapping (no copy)
     Image(const std::string& path, int width, int height, int channels = 3);
 
-    //Alternative approach but we have not used it here
-    Image(const std::vector<uint8_t>& raw, int width, int height, int channels = 3);
+    // Pixels already in memory (used by the server), the vector is moved in
+    Image(std::vector<uint8_t> raw, int width, int height, int channels = 3);
+
+    // Pixels owned by the caller (C API / Python bindings), nothing is copied:
+    // the buffer has to stay alive and unchanged as long as the Image
+    Image(const uint8_t* pixels, int width, int height, int channels = 3);
+
+    // `data` points into our own storage, a plain copy would alias it
+    Image(const Image&) = delete;
+    Image& operator=(const Image&) = delete;
+    Image(Image&&) = default;
+
+    // half resolution copy, every output pixel is the mean of its (up to) 2x2 block
+    // size: (W+1)/2 x (H+1)/2, used by the pyramid mode
+    [[nodiscard]] Image downsample2x() const;
 
     [[nodiscard]] constexpr int width() const noexcept { return W; }
     [[nodiscard]] constexpr int height() const noexcept { return H; }
@@ -36,12 +55,39 @@ public:
         };
     }
 
-    //return the whole table (if needed)
-    [[nodiscard]] const std::vector<uint8_t>& raw() const noexcept { return data; }
+    //return the whole table (if needed), W*H*C bytes
+    [[nodiscard]] const uint8_t* raw() const noexcept { return data; }
+
+    /*
+    Planar (structure of arrays) copy: plane(0) holds the W*H red values, plane(1) green,
+    plane(2) blue. The integer kernels (histograms, beta, n-link distances) load 8+
+    neighbouring pixels of one channel with a single instruction from it instead of
+    going through getColor and doubles.
+    Built on the first call (thread safe), costs one extra byte per channel and pixel.
+    */
+    [[nodiscard]] const uint8_t* plane(int c) const;
+
+    /*
+    Storage for the planar copy from the caller (SegmentationContext, one buffer for every
+    image it sees): lendPlanes hands a buffer in before the planes are built (no-op if they
+    already are), returnPlanes takes it back once the image is done with. A later plane()
+    builds them again. Neither may run while another thread uses the planes.
+    */
+    void lendPlanes(std::vector<uint8_t>& storage) const;
+    void returnPlanes(std::vector<uint8_t>& storage) const;
 
 private:
     int W, H, C;
-    
-    // Aligned memory for potential SIMD operations
-    alignas(32) std::vector<uint8_t> data;
+
+    // pixels live in the file mapping, in `owned` or in the caller's buffer, `data` points at whichever it is
+    std::shared_ptr<const MappedFile> mapping;
+    std::vector<uint8_t> owned;
+    const uint8_t* data = nullptr;
+
+    struct Planar {
+        std::mutex m;
+        std::atomic<bool> built{false};
+        std::vector<uint8_t> planes;
+    };
+    std::unique_ptr<Planar> planar = std::make_unique<Planar>();
 };
@@ -0,0 +1,155 @@
+#include "IncrementalSegmenter.h"
+#include "GraphBuilder.h"
+#include "MinCut.h"
+#include "ThreadPool.h"
+#include <stdexcept>
+
+template <typename Cap>
+IncrementalSegmenter<Cap>::IncrementalSegmenter(const Image& img, SolverType solver_, int threads_, double lambda_)
+    : image(img), W(img.width()), H(img.height()), solver(solver_), threads(threads_), lambda(lambda_),
+      dm(8, 1.0, 1e-9) {}
+
+template <typename Cap>
+void IncrementalSegmenter<Cap>::setHardSeeds(bool fg_hard, bool bg_hard) {
+    // the seeded pixels of the current graph still carry the old hard t-links
+    if (fg_hard != dm.hardFG() || bg_hard != dm.hardBG()) hardChanged = true;
+    dm.setHardSeeds(fg_hard, bg_hard);
+}
+
+template <typename Cap>
+void IncrementalSegmenter<Cap>::setBins(int binsPerChannel) {
+    dm.setBins(binsPerChannel);
+    reset();
+}
+
+template <typename Cap>
+void IncrementalSegmenter<Cap>::reset() {
+    graph.reset();
+    labels.clear();
+    flow = 0.0;
+    hardChanged = false;
+}
+
+// build the whole graph from the current data costs and solve it
+template <typename Cap>
+double IncrementalSegmenter<Cap>::solveFromScratch(const SeedMask& seeds) {
+    GraphBuilder<Cap> gb(image, dm, lambda, solver, threads);
+    graph = gb.buildGraph();
+    labels.assign(seeds.raw(), seeds.raw() + static_cast<size_t>(W) * H);
+    lastChanged = static_cast<size_t>(W) * H;
+    lastReused = false;
+    flow = graph->max_flow(W * H, W * H + 1);
+    return flow;
+}
+
+// setRefitModel: new histograms and data costs, every t-link that moved goes into the
+// residual graph (same as the GrabCut warm start)
+template <typename Cap>
+double IncrementalSegmenter<Cap>::refit(const SeedMask& seeds) {
+    ThreadPool pool(threads);
+    const size_t N = static_cast<size_t>(W) * H;
+    if (!graph->supportsIncremental()) {
+        dm.buildHistograms(image, seeds, &pool);
+        dm.computeDataCosts(image, seeds, &pool);
+        const size_t edited = changed.size();
+        solveFromScratch(seeds);
+        lastChanged = edited;
+        return flow;
+    }
+
+    oldS.resize(N);
+    oldT.resize(N);
+    for (int y = 0; y < H; ++y) {
+        for (int x = 0; x < W; ++x) {
+            oldS[static_cast<size_t>(y) * W + x] = dm.getDpBG(x, y);
+            oldT[static_cast<size_t>(y) * W + x] = dm.getDpFG(x, y);
+        }
+    }
+    dm.buildHistograms(image, seeds, &pool);
+    dm.computeDataCosts(image, seeds, &pool);
+    for (int y = 0; y < H; ++y) {
+        for (int x = 0; x < W; ++x) {
+            const size_t p = static_cast<size_t>(y) * W + x;
+            const Cap dS = dm.getDpBG(x, y) - oldS[p];
+            const Cap dT = dm.getDpFG(x, y) - oldT[p];
+            if (dS != Cap(0) || dT != Cap(0)) graph->add_tweights(static_cast<int>(p), dS, dT);
+        }
+    }
+    labels.assign(seeds.raw(), seeds.raw() + N);
+
+    flow = graph->max_flow(W * H, W * H + 1);
+    return flow;
+}
+
+template <typename Cap>
+double IncrementalSegmenter<Cap>::segment(const SeedMask& seeds) {
+    if (seeds.width() != W || seeds.height() != H)
+        throw std::runtime_error("IncrementalSegmenter: seed mask size does not match the image");
+
+    if (!graph) {
+        ThreadPool pool(threads);
+        dm.buildHistograms(image, seeds, &pool);
+        dm.computeDataCosts(image, seeds, &pool);
+        hardChanged = false;
+        return solveFromScratch(seeds);
+    }
+
+    // the diff itself is a plain byte compare, everything after it only sees the changed pixels
+    // (after setHardSeeds changed the flags every seeded pixel counts as changed)
+    const int8_t* now = seeds.raw();
+    changed.clear();
+    for (size_t i = 0; i < labels.size(); ++i) {
+        if (now[i] != labels[i] || (hardChanged && now[i] >= 0)) changed.push_back(static_cast<int>(i));
+    }
+    hardChanged = false;
+    lastChanged = changed.size();
+    lastReused = true;
+    if (changed.empty()) return flow;
+    if (refitModel) return refit(seeds);
+
+    if (!graph->supportsIncremental()) {
+        dm.updateDataCosts(image, seeds, changed);
+        return solveFromScratch(seeds);
+    }
+
+    oldS.resize(changed.size());
+    oldT.resize(changed.size());
+    for (size_t k = 0; k < changed.size(); ++k) {
+        const int x = changed[k] % W, y = changed[k] / W;
+        oldS[k] = dm.getDpBG(x, y);
+        oldT[k] = dm.getDpFG(x, y);
+    }
+    dm.updateDataCosts(image, seeds, changed);
+
+    // same t-link layout as GraphBuilder: source -> pixel = DpBG, pixel -> sink = DpFG
+    for (size_t k = 0; k < changed.size(); ++k) {
+        const int p = changed[k];
+        const int x = p % W, y = p / W;
+        graph->add_tweights(p, dm.getDpBG(x, y) - oldS[k], dm.getDpFG(x, y) - oldT[k]);
+        labels[p] = now[p];
+    }
+
+    flow = graph->max_flow(W * H, W * H + 1);
+    return flow;
+}
+
+template <typename Cap>
+std::vector<bool> IncrementalSegmenter<Cap>::mask() const {
+    if (!graph) throw std::runtime_error("IncrementalSegmenter: segment() was not called yet");
+    return graph->minCut(W * H);
+}
+
+template <typename Cap>
+void IncrementalSegmenter<Cap>::mask(uint8_t* out) const {
+    const std::vector<bool> side = mask();
+    for (size_t i = 0; i < side.size(); ++i) out[i] = side[i] ? 1 : 0;
+}
+
+template <typename Cap>
+void IncrementalSegmenter<Cap>::writeMask(const std::string& outMaskPath, MaskFormat format) const {
+    MinCut::writeMaskToFile(mask(), W, H, outMaskPath, format);
+}
+
+template class IncrementalSegmenter<double>;
+template class IncrementalSegmenter<float>;
+template class IncrementalSegmenter<int32_t>;
@@ -0,0 +1,82 @@
+#pragma once
+#include "Image.h"
+#include "SeedMask.h"
+#include "DataModel.h"
+#include "MaxFlow.h"
+#include "MaskEncoder.h"
+#include <vector>
+#include <memory>
+#include <string>
+#include <cstdint>
+
+/*
+Interactive re-segmentation: the user adds a stroke and runs the segmentation again.
+
+The first segment() call works like the normal pipeline (histograms, data costs, graph,
+max-flow). Later calls compare the new seeds against the previous ones and only touch
+the pixels whose label changed:
+- their data costs are recomputed with the colour model of the first call
+- the difference to the old costs goes into the engine with add_tweights
+- max_flow continues from the residual graph (and search trees) of the previous solve
+So the solver work per edit follows the size of the edit, not the image size.
+
+By default the colour model stays fixed: rebuilding the histograms would change the
+t-links of every pixel. Call reset() to start over with a fresh model.
+setRefitModel(true) rebuilds the histograms and data costs from the current seeds on
+every call instead (the result is the one of a full run with these seeds), the change of
+every t-link still goes into the kept residual graph, only the n-links are reused.
+Engines without incremental support (Dinic, push-relabel) rebuild the graph every time.
+*/
+template <typename Cap>
+class IncrementalSegmenter {
+public:
+    IncrementalSegmenter(const Image& img, SolverType solver = SolverType::Grid,
+                         int threads = 0, double lambda = 50.0);
+
+    // same meaning as DataModel::setHardSeeds, takes effect for the next segment() call
+    void setHardSeeds(bool fg_hard, bool bg_hard);
+    // colour histogram bins per channel, see DataModel::setBins (drops the colour model, like reset())
+    void setBins(int binsPerChannel);
+
+    // rebuild the colour model from the seeds of every segment() call (off: keep the first one)
+    void setRefitModel(bool on) { refitModel = on; }
+
+    // segment with the current seeds, returns the max-flow value
+    double segment(const SeedMask& seeds);
+
+    // source side of the last cut, W*H entries (true = foreground)
+    std::vector<bool> mask() const;
+    // same, written as W*H bytes 0/1 into a buffer of the caller
+    void mask(uint8_t* out) const;
+    void writeMask(const std::string& outMaskPath, MaskFormat format = MaskFormat::Bytes) const;
+
+    // pixels whose seed label (or hard flag) changed in the last segment() call (W*H for a full solve)
+    size_t changedPixels() const { return lastChanged; }
+    // the last segment() call reused the residual graph
+    bool reusedGraph() const { return lastReused; }
+
+    // forget the graph and the colour model
+    void reset();
+
+private:
+    const Image& image;
+    int W, H;
+    SolverType solver;
+    int threads;
+    double lambda;
+
+    DataModel<Cap> dm;
+    std::unique_ptr<MaxFlow<Cap>> graph;
+    std::vector<int8_t> labels;     // seeds of the last solve
+    std::vector<int> changed;
+    std::vector<Cap> oldS, oldT;
+
+    double flow = 0.0;
+    size_t lastChanged = 0;
+    bool lastReused = false;
+    bool hardChanged = false;       // setHardSeeds changed the flags since the last solve
+    bool refitModel = false;
+
+    double solveFromScratch(const SeedMask& seeds);
+    double refit(const SeedMask& seeds);
+};
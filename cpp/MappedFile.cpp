@@ -0,0 +1,121 @@
+#include "MappedFile.h"
+#include <stdexcept>
+
+uint8_t* MappedFile::writableData() {
+    if (!writable) throw std::runtime_error("MappedFile: mapping is read only");
+    return ptr;
+}
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+
+MappedFile::MappedFile(const std::string& path) {
+    HANDLE f = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                           FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (f == INVALID_HANDLE_VALUE) throw std::runtime_error("MappedFile: failed to open " + path);
+    file = f;
+
+    LARGE_INTEGER sz;
+    if (!GetFileSizeEx(f, &sz)) {
+        CloseHandle(f);
+        throw std::runtime_error("MappedFile: failed to stat " + path);
+    }
+    len = static_cast<size_t>(sz.QuadPart);
+    if (len == 0) return;   // an empty file can not be mapped, data() stays null
+
+    mapping = CreateFileMappingA(f, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapping) {
+        CloseHandle(f);
+        throw std::runtime_error("MappedFile: failed to map " + path);
+    }
+    ptr = static_cast<uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+    if (!ptr) {
+        CloseHandle(mapping);
+        CloseHandle(f);
+        throw std::runtime_error("MappedFile: failed to map " + path);
+    }
+}
+
+MappedFile::MappedFile(const std::string& path, size_t size) : len(size), writable(true) {
+    HANDLE f = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS,
+                           FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (f == INVALID_HANDLE_VALUE) throw std::runtime_error("MappedFile: failed to create " + path);
+    file = f;
+    if (len == 0) return;
+
+    // mapping a new file with an explicit size extends it (zero filled)
+    mapping = CreateFileMappingA(f, nullptr, PAGE_READWRITE, static_cast<DWORD>(static_cast<uint64_t>(len) >> 32),
+                                 static_cast<DWORD>(len & 0xffffffffu), nullptr);
+    if (!mapping) {
+        CloseHandle(f);
+        throw std::runtime_error("MappedFile: failed to map " + path);
+    }
+    ptr = static_cast<uint8_t*>(MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, 0));
+    if (!ptr) {
+        CloseHandle(mapping);
+        CloseHandle(f);
+        throw std::runtime_error("MappedFile: failed to map " + path);
+    }
+}
+
+MappedFile::~MappedFile() {
+    if (ptr) UnmapViewOfFile(ptr);
+    if (mapping) CloseHandle(mapping);
+    if (file) CloseHandle(file);
+}
+
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+MappedFile::MappedFile(const std::string& path) {
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) throw std::runtime_error("MappedFile: failed to open " + path);
+
+    struct stat st;
+    if (::fstat(fd, &st) != 0) {
+        ::close(fd);
+        throw std::runtime_error("MappedFile: failed to stat " + path);
+    }
+    len = static_cast<size_t>(st.st_size);
+    if (len == 0) {             // an empty file can not be mapped, data() stays null
+        ::close(fd);
+        return;
+    }
+
+    void* p = ::mmap(nullptr, len, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);                // the mapping keeps its own reference to the file
+    if (p == MAP_FAILED) throw std::runtime_error("MappedFile: failed to map " + path);
+
+    // the whole file is read front to back right after loading (histograms, data costs)
+    ::madvise(p, len, MADV_WILLNEED);
+    ptr = static_cast<uint8_t*>(p);
+}
+
+MappedFile::MappedFile(const std::string& path, size_t size) : len(size), writable(true) {
+    const int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) throw std::runtime_error("MappedFile: failed to create " + path);
+    if (::ftruncate(fd, static_cast<off_t>(len)) != 0) {
+        ::close(fd);
+        throw std::runtime_error("MappedFile: failed to resize " + path);
+    }
+    if (len == 0) {
+        ::close(fd);
+        return;
+    }
+
+    void* p = ::mmap(nullptr, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (p == MAP_FAILED) throw std::runtime_error("MappedFile: failed to map " + path);
+    ptr = static_cast<uint8_t*>(p);
+}
+
+MappedFile::~MappedFile() {
+    if (ptr) ::munmap(ptr, len);
+}
+#endif
@@ -0,0 +1,179 @@
+#include "MaskEncoder.h"
+#include "Profiler.h"
+#include <fstream>
+#include <stdexcept>
+#include <cstddef>
+
+MaskFormat parseMaskFormat(const std::string& name) {
+    if (name == "bytes") return MaskFormat::Bytes;
+    if (name == "bits") return MaskFormat::Bits;
+    if (name == "rle") return MaskFormat::RLE;
+    if (name == "polygons") return MaskFormat::Polygons;
+    throw std::runtime_error("Unknown mask format: " + name + " (expected bytes, bits, rle or polygons)");
+}
+
+namespace {
+
+// the encoders only need "is pixel i foreground", Mask wraps the two ways we hold a cut
+template <typename Mask>
+void encodeBytes(const Mask& fg, int W, int H, std::vector<uint8_t>& out) {
+    const size_t N = static_cast<size_t>(W) * H;
+    out.resize(N);
+    for (size_t i = 0; i < N; ++i) out[i] = fg(i) ? 1 : 0;
+}
+
+template <typename Mask>
+void encodeBits(const Mask& fg, int W, int H, std::vector<uint8_t>& out) {
+    const size_t rowBytes = (static_cast<size_t>(W) + 7) / 8;
+    out.assign(rowBytes * H, 0);
+    for (int y = 0; y < H; ++y) {
+        const size_t row = static_cast<size_t>(y) * W;
+        uint8_t* dst = out.data() + static_cast<size_t>(y) * rowBytes;
+        for (int x = 0; x < W; ++x)
+            if (fg(row + x)) dst[x >> 3] |= static_cast<uint8_t>(1u << (x & 7));
+    }
+}
+
+void putVarint(std::vector<uint8_t>& out, uint32_t v) {
+    while (v >= 0x80) {
+        out.push_back(static_cast<uint8_t>(v | 0x80));
+        v >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(v));
+}
+
+template <typename Mask>
+void encodeRLE(const Mask& fg, int W, int H, std::vector<uint8_t>& out) {
+    out.clear();
+    for (int y = 0; y < H; ++y) {
+        const size_t row = static_cast<size_t>(y) * W;
+        bool label = false;     // every row starts with a background run
+        int start = 0;
+        for (int x = 0; x < W; ++x) {
+            if (fg(row + x) != label) {
+                putVarint(out, static_cast<uint32_t>(x - start));
+                label = !label;
+                start = x;
+            }
+        }
+        putVarint(out, static_cast<uint32_t>(W - start));
+    }
+}
+
+void putText(std::vector<uint8_t>& out, const std::string& s) {
+    out.insert(out.end(), s.begin(), s.end());
+}
+
+/*
+Crack following on the pixel grid: the boundary runs along pixel edges between a foreground
+and a background pixel (outside the image counts as background) with the foreground on its
+right. At every vertex the next edge is picked from the two pixels ahead:
+  front-right background -> turn right, front-left background -> straight, else turn left
+Turning right first keeps diagonal foreground pixels apart, so at a saddle the two regions
+get separate boundaries. Every boundary contains a horizontal edge, so scanning those for
+one not visited yet finds each boundary once. Only the corners are emitted.
+*/
+template <typename Mask>
+void encodePolygons(const Mask& mask, int W, int H, std::vector<uint8_t>& out) {
+    auto fg = [&](int x, int y) {
+        return x >= 0 && y >= 0 && x < W && y < H && mask(static_cast<size_t>(y) * W + x);
+    };
+    // directions clockwise on screen: east, south, west, north
+    static const int dx[4] = {1, 0, -1, 0};
+    static const int dy[4] = {0, 1, 0, -1};
+    // front-left / front-right pixel relative to the vertex, per direction
+    static const int flx[4] = {0, 0, -1, -1}, fly[4] = {-1, 0, 0, -1};
+    static const int frx[4] = {0, -1, -1, 0}, fry[4] = {0, 0, -1, -1};
+
+    std::vector<bool> seenH(static_cast<size_t>(W) * (H + 1), false);   // edge (x,y)-(x+1,y)
+    std::vector<bool> seenV(static_cast<size_t>(W + 1) * H, false);     // edge (x,y)-(x,y+1)
+
+    std::string body;
+    std::vector<int> pts;
+    size_t count = 0;
+    for (int y = 0; y <= H; ++y) {
+        for (int x = 0; x < W; ++x) {
+            const bool above = fg(x, y - 1), below = fg(x, y);
+            if (above == below || seenH[static_cast<size_t>(y) * W + x]) continue;
+
+            // foreground below: the edge runs east, above: west
+            const int sx = below ? x : x + 1, sy = y, sd = below ? 0 : 2;
+            int vx = sx, vy = sy, d = sd;
+            pts.clear();
+            while (true) {
+                switch (d) {
+                    case 0: seenH[static_cast<size_t>(vy) * W + vx] = true; break;
+                    case 1: seenV[static_cast<size_t>(vy) * (W + 1) + vx] = true; break;
+                    case 2: seenH[static_cast<size_t>(vy) * W + vx - 1] = true; break;
+                    default: seenV[static_cast<size_t>(vy - 1) * (W + 1) + vx] = true; break;
+                }
+                vx += dx[d];
+                vy += dy[d];
+                int next;
+                if (!fg(vx + frx[d], vy + fry[d])) next = (d + 1) & 3;
+                else if (!fg(vx + flx[d], vy + fly[d])) next = d;
+                else next = (d + 3) & 3;
+                if (next != d) {
+                    pts.push_back(vx);
+                    pts.push_back(vy);
+                }
+                d = next;
+                if (vx == sx && vy == sy && d == sd) break;
+            }
+
+            body += std::to_string(pts.size() / 2);
+            for (int v : pts) {
+                body += ' ';
+                body += std::to_string(v);
+            }
+            body += '\n';
+            ++count;
+        }
+    }
+    out.clear();
+    putText(out, std::to_string(W) + " " + std::to_string(H) + " " + std::to_string(count) + "\n");
+    putText(out, body);
+}
+
+template <typename Mask>
+void encodeAny(const Mask& fg, int W, int H, MaskFormat format, std::vector<uint8_t>& out) {
+    switch (format) {
+        case MaskFormat::Bits: encodeBits(fg, W, H, out); break;
+        case MaskFormat::RLE: encodeRLE(fg, W, H, out); break;
+        case MaskFormat::Polygons: encodePolygons(fg, W, H, out); break;
+        case MaskFormat::Bytes:
+        default: encodeBytes(fg, W, H, out); break;
+    }
+}
+
+} // namespace
+
+void MaskEncoder::encode(const std::vector<bool>& fg, int W, int H, MaskFormat format, std::vector<uint8_t>& out) {
+    if (fg.size() < static_cast<size_t>(W) * H) throw std::runtime_error("MaskEncoder: cut smaller than W*H");
+    encodeAny([&](size_t i) { return static_cast<bool>(fg[i]); }, W, H, format, out);
+}
+
+void MaskEncoder::encode(const uint8_t* fg, int W, int H, MaskFormat format, std::vector<uint8_t>& out) {
+    encodeAny([fg](size_t i) { return fg[i] != 0; }, W, H, format, out);
+}
+
+void MaskEncoder::writeBuffer(const std::vector<uint8_t>& data, const std::string& path) {
+    std::ofstream out(path, std::ios::binary);
+    if (!out) throw std::runtime_error("MaskEncoder: failed to open " + path);
+    out.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
+    if (!out) throw std::runtime_error("MaskEncoder: failed to write " + path);
+}
+
+void MaskEncoder::writeFile(const std::vector<bool>& fg, int W, int H, MaskFormat format, const std::string& path) {
+    Profiler::Scope scope("writeMask");
+    std::vector<uint8_t> buf;
+    encode(fg, W, H, format, buf);
+    writeBuffer(buf, path);
+}
+
+void MaskEncoder::writeFile(const uint8_t* fg, int W, int H, MaskFormat format, const std::string& path) {
+    Profiler::Scope scope("writeMask");
+    std::vector<uint8_t> buf;
+    encode(fg, W, H, format, buf);
+    writeBuffer(buf, path);
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <cstdint>
+
+/*
+Output formats of the segmentation mask (--mask-format=...). The mask is W x H, row-major;
+W and H are not stored, like every other .bin file of this project.
+
+  bytes     one uint8 0/1 per pixel (the default, what the GUI reads with np.fromfile)
+  bits      one bit per pixel, every row starts on a byte boundary, least significant bit
+            first: np.unpackbits(data.reshape(H, -1), axis=1, bitorder="little")[:, :W]
+  rle       per row, the lengths of alternating runs starting with background (a row that
+            starts with foreground begins with a 0 run), each length an unsigned LEB128
+            varint; the runs of a row add up to W
+  polygons  text: "W H count" on the first line, then one closed boundary per line:
+            "n x0 y0 x1 y1 ..." with n corner points on the pixel grid (0..W, 0..H).
+            Outer boundaries run clockwise on screen (y down), holes counter-clockwise,
+            diagonal neighbours are separate regions. Filling the polygons with the
+            even-odd rule at the pixel centres gives the mask back exactly.
+
+The encoders read the cut straight from MaxFlow::minCut (or a byte mask where that is
+what we have, sequence and tiled mode), there is no byte mask in between.
+*/
+enum class MaskFormat {
+    Bytes,
+    Bits,
+    RLE,
+    Polygons
+};
+
+// "bytes" / "bits" / "rle" / "polygons" -> MaskFormat, throws std::runtime_error on anything else
+MaskFormat parseMaskFormat(const std::string& name);
+
+struct MaskEncoder {
+    // encode the first W*H entries (true / nonzero = foreground) into `out`, which is
+    // overwritten (its capacity is kept, so a reused buffer does not reallocate)
+    static void encode(const std::vector<bool>& fg, int W, int H, MaskFormat format, std::vector<uint8_t>& out);
+    static void encode(const uint8_t* fg, int W, int H, MaskFormat format, std::vector<uint8_t>& out);
+
+    // encode and write to `path` in one go, throws std::runtime_error if that fails
+    static void writeFile(const std::vector<bool>& fg, int W, int H, MaskFormat format, const std::string& path);
+    static void writeFile(const uint8_t* fg, int W, int H, MaskFormat format, const std::string& path);
+
+    // write an already encoded buffer
+    static void writeBuffer(const std::vector<uint8_t>& data, const std::string& path);
+};
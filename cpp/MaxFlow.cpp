@@ -0,0 +1,96 @@
+#include "MaxFlow.h"
+#include "Dinic.h"
+#include "BoykovKolmogorov.h"
+#include "GridMaxFlow.h"
+#include "PushRelabel.h"
+#include "Profiler.h"
+#include <stdexcept>
+#include <algorithm>
+
+SolverType parseSolverType(const std::string& name) {
+    if (name == "dinic") return SolverType::Dinic;
+    if (name == "bk") return SolverType::BK;
+    if (name == "grid") return SolverType::Grid;
+    if (name == "pr") return SolverType::PushRelabel;
+    throw std::runtime_error("Unknown solver: " + name + " (expected dinic|bk|grid|pr)");
+}
+
+SolverStats& SolverStats::operator+=(const SolverStats& o) {
+    nodes = std::max(nodes, o.nodes);
+    arcs = std::max(arcs, o.arcs);
+    bytes = std::max(bytes, o.bytes);
+    phases += o.phases;
+    augmentations += o.augmentations;
+    pathArcs += o.pathArcs;
+    arcAdvances += o.arcAdvances;
+    orphans += o.orphans;
+    pushes += o.pushes;
+    relabels += o.relabels;
+    globalRelabels += o.globalRelabels;
+    return *this;
+}
+
+template <typename Cap>
+void MaxFlow<Cap>::reportStats(const char* engine, size_t nodes, size_t arcs, size_t bytes) {
+    counters.nodes = nodes;
+    counters.arcs = arcs;
+    counters.bytes = bytes;
+    Profiler& prof = Profiler::global();
+    if (prof.enabled()) prof.solver(engine, counters);
+}
+
+template <typename Cap>
+void MaxFlow<Cap>::add_grid_edges(int W, int H, const Cap* capS, const Cap* capT,
+                                  const Cap* right, const Cap* down, ThreadPool& pool) {
+    (void)pool;
+    const int source = W * H, sink = W * H + 1;
+    reserve_edges(static_cast<size_t>(W) * H * 2 + static_cast<size_t>(W - 1) * H + static_cast<size_t>(W) * (H - 1));
+    for (int p = 0; p < W * H; ++p) {
+        add_edge(source, p, capS[p]);
+        add_edge(p, sink, capT[p]);
+    }
+    for (int y = 0; y < H; ++y) {
+        const Cap* w = right + static_cast<size_t>(y) * (W - 1);
+        for (int x = 0; x + 1 < W; ++x) add_edge(y * W + x, y * W + x + 1, w[x], w[x]);
+    }
+    for (int y = 0; y + 1 < H; ++y) {
+        const Cap* w = down + static_cast<size_t>(y) * W;
+        for (int x = 0; x < W; ++x) add_edge(y * W + x, (y + 1) * W + x, w[x], w[x]);
+    }
+}
+
+template class MaxFlow<double>;
+template class MaxFlow<float>;
+template class MaxFlow<int32_t>;
+
+bool solverSupportsIncremental(SolverType type) {
+    return type == SolverType::BK || type == SolverType::Grid;
+}
+
+template <typename Cap>
+std::unique_ptr<MaxFlow<Cap>> makeMaxFlow(SolverType type, int n, int threads) {
+    switch (type) {
+        case SolverType::PushRelabel:
+            return std::unique_ptr<MaxFlow<Cap>>(new PushRelabel<Cap>(n, threads));
+        case SolverType::BK:
+        case SolverType::Grid:
+            return std::unique_ptr<MaxFlow<Cap>>(new BoykovKolmogorov<Cap>(n));
+        case SolverType::Dinic:
+        default:
+            return std::unique_ptr<MaxFlow<Cap>>(new Dinic<Cap>(n));
+    }
+}
+
+template <typename Cap>
+std::unique_ptr<MaxFlow<Cap>> makeGridMaxFlow(SolverType type, int W, int H, int threads) {
+    if (type == SolverType::Grid)
+        return std::unique_ptr<MaxFlow<Cap>>(new GridMaxFlow<Cap>(W, H));
+    return makeMaxFlow<Cap>(type, W * H + 2, threads);
+}
+
+template std::unique_ptr<MaxFlow<double>> makeMaxFlow<double>(SolverType, int, int);
+template std::unique_ptr<MaxFlow<float>> makeMaxFlow<float>(SolverType, int, int);
+template std::unique_ptr<MaxFlow<int32_t>> makeMaxFlow<int32_t>(SolverType, int, int);
+template std::unique_ptr<MaxFlow<double>> makeGridMaxFlow<double>(SolverType, int, int, int);
+template std::unique_ptr<MaxFlow<float>> makeGridMaxFlow<float>(SolverType, int, int, int);
+template std::unique_ptr<MaxFlow<int32_t>> makeGridMaxFlow<int32_t>(SolverType, int, int, int);
@@ -0,0 +1,138 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <memory>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include "Capacity.h"
+
+class ThreadPool;
+
+/* Work counters of one max_flow call (--stats, see Profiler.h). Counting is a few register
+   increments per path / node visit, so the engines always keep them. */
+struct SolverStats {
+    size_t nodes = 0;
+    size_t arcs = 0;                // residual arcs, both directions of an edge
+    size_t bytes = 0;               // graph, trees and queues held by the engine
+    uint64_t phases = 0;            // Dinic: BFS level graphs, BK / Grid: growth steps, PR: rounds
+    uint64_t augmentations = 0;     // augmenting paths (Dinic, BK, Grid)
+    uint64_t pathArcs = 0;          // summed length of those paths
+    uint64_t arcAdvances = 0;       // Dinic: start[] pointer advances
+    uint64_t orphans = 0;           // BK / Grid: orphans processed by adoption
+    uint64_t pushes = 0;            // PR
+    uint64_t relabels = 0;          // PR
+    uint64_t globalRelabels = 0;    // PR
+
+    SolverStats& operator+=(const SolverStats& o);
+};
+
+/* Common interface for every max-flow engine we ship.
+   GraphBuilder only talks to this interface when it adds t-links and n-links,
+   and Segmenter only needs max_flow + minCut, so the engine can be swapped
+   from the command line without touching the rest of the pipeline.
+   Cap is the capacity type of the edges (see Capacity.h). The returned flow value is
+   always reported in cost units as a double. */
+template <typename Cap>
+class MaxFlow {
+public:
+    virtual ~MaxFlow() = default;
+
+    // add edge u->v with capacity cap and v->u with capacity rev_cap
+    // (rev_cap = 0 gives a plain directed edge, rev_cap = cap an undirected n-link)
+    virtual void add_edge(int u, int v, Cap cap, Cap rev_cap = Cap(0)) = 0;
+
+    // optional hint: number of add_edge calls that will follow
+    virtual void reserve_edges(size_t m) { (void)m; }
+
+    /* Bulk form of the W x H pixel graph (see makeGridMaxFlow): source->p with capS[p],
+       p->sink with capT[p], then the undirected n-links right[y*(W-1)+x] and down[y*W+x]
+       (the planes of GraphBuilder::nlinkWeights). Same edges in the same order as the plain
+       add_edge loop, which is what the default does. Engines that can fill their storage
+       row by row override it and split the rows across the pool. */
+    virtual void add_grid_edges(int W, int H, const Cap* capS, const Cap* capT,
+                                const Cap* right, const Cap* down, ThreadPool& pool);
+
+    // push maximum flow from s to t and return its value
+    virtual double max_flow(int s, int t) = 0;
+
+    // after max_flow: true for every node on the source side of the minimum cut
+    std::vector<bool> minCut(int s) const {
+        std::vector<bool> side;
+        minCut(s, side);
+        return side;
+    }
+    // same into a caller buffer (resized to the node count, a reused buffer keeps its storage)
+    virtual void minCut(int s, std::vector<bool>& side) const = 0;
+
+    /* Reuse (see SegmentationContext): drop every edge, the flow and the trees and start
+       over as an empty graph with n nodes. The arrays keep their capacity, so building a
+       graph of the same or a smaller size again allocates nothing.
+       resetGrid is the same for a W x H pixel graph (nodes as in makeGridMaxFlow), only the
+       grid engine needs W and H, it does not take a plain node count. */
+    virtual void reset(int n) {
+        (void)n;
+        throw std::runtime_error("MaxFlow: this engine can not be reset");
+    }
+    virtual void resetGrid(int W, int H) { reset(W * H + 2); }
+
+    // back the per-node / per-arc arrays allocated from now on with transparent huge
+    // pages (see HugePages.h)
+    void setHugePages(bool on) { hugePages = on; }
+
+    /* Dynamic graph cuts (Kohli & Torr, "Dynamic Graph Cuts for Efficient Inference in
+       Markov Random Fields", PAMI 2007).
+       add_tweights adds capSource to the source->v edge and capSink to the v->sink edge.
+       Both may be negative, e.g. to undo an earlier t-link. After a max_flow call the engine
+       keeps its residual graph, so the next max_flow only has to repair the flow around the
+       changed nodes instead of starting over. Engines that cannot do this report false
+       from supportsIncremental() and throw from add_tweights. */
+    virtual bool supportsIncremental() const { return false; }
+    virtual void add_tweights(int v, Cap capSource, Cap capSink) {
+        (void)v; (void)capSource; (void)capSink;
+        throw std::runtime_error("MaxFlow: this engine does not support incremental updates");
+    }
+
+    /* Dynamic n-link update (Kohli & Torr, same paper): add delta (may be negative) to both
+       directions of the undirected edge u - v. If the edge carries more flow than its new
+       capacity, the surplus is taken back and moved onto the t-links of u and v
+       (reparametrisation), so the residual graph stays a valid flow of the new graph and
+       the next max_flow only repairs around u and v. Same engines as add_tweights. */
+    virtual void add_nweights(int u, int v, Cap delta) {
+        (void)u; (void)v; (void)delta;
+        throw std::runtime_error("MaxFlow: this engine does not support incremental updates");
+    }
+
+    // counters of the last max_flow call
+    const SolverStats& stats() const { return counters; }
+
+protected:
+    SolverStats counters;
+    bool hugePages = false;
+
+    // end of max_flow: fill in the sizes and hand the counters to the profiler (if enabled)
+    void reportStats(const char* engine, size_t nodes, size_t arcs, size_t bytes);
+};
+
+enum class SolverType {
+    Dinic,
+    BK,     // Boykov-Kolmogorov
+    Grid,   // Boykov-Kolmogorov on an implicit 4-connected pixel grid
+    PushRelabel // multi-threaded synchronous push-relabel
+};
+
+// "dinic" / "bk" / "grid" / "pr" -> SolverType, throws std::runtime_error on anything else
+SolverType parseSolverType(const std::string& name);
+
+// true for the engines that implement add_tweights + incremental max_flow (BK and Grid)
+bool solverSupportsIncremental(SolverType type);
+
+// create an empty graph with n nodes backed by the requested engine
+// (Grid needs the pixel layout, for arbitrary graphs it falls back to BK)
+// threads is only used by the parallel engines, 0 = one per hardware thread
+template <typename Cap>
+std::unique_ptr<MaxFlow<Cap>> makeMaxFlow(SolverType type, int n, int threads = 0);
+
+// create an empty W x H pixel graph: nodes 0 .. W*H-1, source = W*H, sink = W*H+1
+template <typename Cap>
+std::unique_ptr<MaxFlow<Cap>> makeGridMaxFlow(SolverType type, int W, int H, int threads = 0);
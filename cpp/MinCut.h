@@ -1,7 +1,7 @@
 #pragma once
-#include "Dinic.h"
-#include <fstream>
+#include <vector>
 #include <string>
+#include "MaskEncoder.h"
 
 
 /*
@@ -9,21 +9,13 @@ Helper functions related to mincut
 */
 struct MinCut {
     // write mask (segmentation result)
-    // to file in row-major order (need reachable.size() == W*H)
-
-    static void writeMaskToFile(const std::vector<bool>& reachable, int W, int H, const std::string& outPath) {
-        std::ofstream out(outPath, std::ios::binary);
-        if (!out) throw std::runtime_error("MinCut: failed to open output mask file");
-        
-        // write as uint8 values 0/1 per pixel
-        for (int y = 0; y < H; ++y) {
-            for (int x = 0; x < W; ++x) {
-                bool fg = reachable[y * W + x];
-                uint8_t v = fg ? 1 : 0;
-                out.write(reinterpret_cast<const char*>(&v), 1);
-            }
-        }
-        out.close();
+    // to file in row-major order (need reachable.size() >= W*H)
+    // bytes: one uint8 0/1 per pixel, the other formats are described in MaskEncoder.h;
+    // the whole file is built in memory first and goes out with a single write,
+    // one write() per pixel was millions of stream calls on big images
+    static void writeMaskToFile(const std::vector<bool>& reachable, int W, int H, const std::string& outPath,
+                                MaskFormat format = MaskFormat::Bytes) {
+        MaskEncoder::writeFile(reachable, W, H, format, outPath);
     }
 };
 
@@ -0,0 +1,178 @@
+#include "Profiler.h"
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <stdexcept>
+#include <algorithm>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+Profiler& Profiler::global() {
+    static Profiler instance;
+    return instance;
+}
+
+void Profiler::enable(bool value) {
+    on = value;
+    origin = Clock::now();
+}
+
+size_t Profiler::peakRssKb() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS pmc;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc))) return 0;
+    return static_cast<size_t>(pmc.PeakWorkingSetSize / 1024);
+#else
+    struct rusage ru;
+    if (getrusage(RUSAGE_SELF, &ru) != 0) return 0;
+#ifdef __APPLE__
+    return static_cast<size_t>(ru.ru_maxrss / 1024);   // bytes on macOS
+#else
+    return static_cast<size_t>(ru.ru_maxrss);          // KiB on Linux
+#endif
+#endif
+}
+
+// small stable thread ids for the trace (0 = first thread that recorded something)
+int Profiler::threadIndex() {
+    static std::mutex idsMutex;
+    static std::vector<std::thread::id> ids;
+    const std::thread::id self = std::this_thread::get_id();
+    std::lock_guard<std::mutex> lock(idsMutex);
+    for (size_t i = 0; i < ids.size(); ++i)
+        if (ids[i] == self) return static_cast<int>(i);
+    ids.push_back(self);
+    return static_cast<int>(ids.size() - 1);
+}
+
+void Profiler::record(const char* name, Clock::time_point start, Clock::time_point end) {
+    const size_t rss = peakRssKb();
+    const int tid = threadIndex();
+    Event e{name, tid,
+            std::chrono::duration<double, std::micro>(start - origin).count(),
+            std::chrono::duration<double, std::micro>(end - start).count(), rss};
+    std::lock_guard<std::mutex> lock(m);
+    events.push_back(e);
+}
+
+void Profiler::solver(const char* engine, const SolverStats& stats) {
+    std::lock_guard<std::mutex> lock(m);
+    solvers[engine] += stats;
+    ++solverCalls[engine];
+}
+
+void Profiler::memory(const std::string& what, size_t value) {
+    if (!on) return;
+    std::lock_guard<std::mutex> lock(m);
+    size_t& slot = bytes[what];
+    slot = std::max(slot, value);
+}
+
+void Profiler::note(const std::string& key, const std::string& value) {
+    if (!on) return;
+    std::lock_guard<std::mutex> lock(m);
+    notes.emplace_back(key, value);
+}
+
+namespace {
+
+std::string escape(const std::string& s) {
+    std::string out;
+    for (char c : s) {
+        if (c == '"' || c == '\\') out += '\\';
+        if (static_cast<unsigned char>(c) < 0x20) { out += ' '; continue; }
+        out += c;
+    }
+    return out;
+}
+
+void writeFile(const std::string& path, const std::string& text) {
+    std::ofstream out(path);
+    if (!out) throw std::runtime_error("Profiler: failed to open " + path);
+    out << text;
+    if (!out) throw std::runtime_error("Profiler: failed to write " + path);
+}
+
+} // namespace
+
+void Profiler::writeStats(const std::string& path) const {
+    std::lock_guard<std::mutex> lock(m);
+
+    // stages in order of their first completion
+    struct Stage { std::string name; uint64_t calls = 0; double ms = 0.0, maxMs = 0.0; size_t peakRssKb = 0; };
+    std::vector<Stage> stages;
+    for (const Event& e : events) {
+        auto it = std::find_if(stages.begin(), stages.end(), [&](const Stage& s) { return s.name == e.name; });
+        if (it == stages.end()) { stages.push_back(Stage()); it = stages.end() - 1; it->name = e.name; }
+        ++it->calls;
+        it->ms += e.durUs / 1000.0;
+        it->maxMs = std::max(it->maxMs, e.durUs / 1000.0);
+        it->peakRssKb = std::max(it->peakRssKb, e.peakRssKb);
+    }
+
+    std::ostringstream js;
+    js.precision(3);
+    js << std::fixed;
+    js << "{\n  \"notes\": {";
+    for (size_t i = 0; i < notes.size(); ++i)
+        js << (i ? ", " : "") << "\"" << escape(notes[i].first) << "\": \"" << escape(notes[i].second) << "\"";
+    js << "},\n  \"wall_ms\": " << std::chrono::duration<double, std::milli>(Clock::now() - origin).count()
+       << ",\n  \"peak_rss_kb\": " << peakRssKb() << ",\n  \"stages\": [\n";
+    for (size_t i = 0; i < stages.size(); ++i) {
+        const Stage& s = stages[i];
+        js << "    {\"name\": \"" << s.name << "\", \"calls\": " << s.calls << ", \"total_ms\": " << s.ms
+           << ", \"max_ms\": " << s.maxMs << ", \"peak_rss_kb\": " << s.peakRssKb << "}"
+           << (i + 1 < stages.size() ? "," : "") << "\n";
+    }
+    js << "  ],\n  \"memory_bytes\": {";
+    size_t i = 0;
+    for (const auto& kv : bytes) js << (i++ ? ", " : "") << "\"" << escape(kv.first) << "\": " << kv.second;
+    js << "},\n  \"solvers\": {";
+    i = 0;
+    for (const auto& kv : solvers) {
+        const SolverStats& s = kv.second;
+        js << (i++ ? "," : "") << "\n    \"" << kv.first << "\": {\"calls\": " << solverCalls.at(kv.first)
+           << ", \"nodes\": " << s.nodes << ", \"arcs\": " << s.arcs << ", \"bytes\": " << s.bytes
+           << ", \"phases\": " << s.phases << ", \"augmentations\": " << s.augmentations
+           << ", \"avg_path_length\": " << (s.augmentations ? double(s.pathArcs) / s.augmentations : 0.0)
+           << ", \"arc_advances\": " << s.arcAdvances << ", \"orphans\": " << s.orphans
+           << ", \"pushes\": " << s.pushes << ", \"relabels\": " << s.relabels
+           << ", \"global_relabels\": " << s.globalRelabels << "}";
+    }
+    js << (solvers.empty() ? "" : "\n  ") << "}\n}\n";
+    writeFile(path, js.str());
+}
+
+void Profiler::writeTrace(const std::string& path) const {
+    std::lock_guard<std::mutex> lock(m);
+    std::ostringstream js;
+    js.precision(3);
+    js << std::fixed;
+    js << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+    js << "  {\"name\": \"process_name\", \"ph\": \"M\", \"pid\": 1, \"args\": {\"name\": \"segment\"}}";
+    for (const Event& e : events) {
+        js << ",\n  {\"name\": \"" << e.name << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << e.thread
+           << ", \"ts\": " << e.startUs << ", \"dur\": " << e.durUs
+           << ", \"args\": {\"peak_rss_kb\": " << e.peakRssKb << "}}";
+    }
+    // solver counters as one instant event per engine at the end of the run
+    const double end = std::chrono::duration<double, std::micro>(Clock::now() - origin).count();
+    for (const auto& kv : solvers) {
+        const SolverStats& s = kv.second;
+        js << ",\n  {\"name\": \"" << kv.first << " counters\", \"ph\": \"i\", \"s\": \"g\", \"pid\": 1, \"tid\": 0, \"ts\": " << end
+           << ", \"args\": {\"phases\": " << s.phases << ", \"augmentations\": " << s.augmentations
+           << ", \"path_arcs\": " << s.pathArcs << ", \"arc_advances\": " << s.arcAdvances
+           << ", \"orphans\": " << s.orphans << ", \"pushes\": " << s.pushes
+           << ", \"relabels\": " << s.relabels << ", \"global_relabels\": " << s.globalRelabels << "}}";
+    }
+    js << "\n]}\n";
+    writeFile(path, js.str());
+}
@@ -0,0 +1,84 @@
+#pragma once
+#include "MaxFlow.h"
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+/*
+Instrumentation behind --stats / --trace.
+
+One process wide Profiler, off by default. The pipeline stages open a Profiler::Scope
+(buildHistograms, computeDataCosts, computeBeta, buildGraph, max_flow, minCut, ...); while
+the profiler is disabled a scope is a single flag test, nothing is timed or stored.
+When enabled every scope becomes an event (name, thread, start, duration, peak RSS at its
+end), and the engines hand in their SolverStats after each max_flow.
+
+Output:
+- writeStats: JSON summary, per stage the call count, total wall time and the peak RSS
+  seen at its end, the solver counters summed over all max_flow calls, and the bytes of the
+  big data structures
+- writeTrace: Chrome trace event format (chrome://tracing, Perfetto), one complete event
+  per scope on the thread that ran it
+*/
+class Profiler {
+public:
+    static Profiler& global();
+
+    bool enabled() const { return on; }
+    // call before any work starts (not synchronised with running scopes)
+    void enable(bool value = true);
+
+    class Scope {
+    public:
+        explicit Scope(const char* name_)
+            : name(Profiler::global().enabled() ? name_ : nullptr) {
+            if (name) start = Profiler::Clock::now();
+        }
+        ~Scope() { if (name) Profiler::global().record(name, start, Profiler::Clock::now()); }
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+    private:
+        const char* name;
+        std::chrono::steady_clock::time_point start;
+    };
+
+    // counters of one max_flow call of the named engine ("dinic", "bk", "grid", "pr")
+    void solver(const char* engine, const SolverStats& stats);
+    // bytes held by a data structure, the largest value reported under a name is kept
+    void memory(const std::string& what, size_t bytes);
+    // free form key/value pairs for the summary (mode, solver, image size ...)
+    void note(const std::string& key, const std::string& value);
+
+    void writeStats(const std::string& path) const;
+    void writeTrace(const std::string& path) const;
+
+    // peak resident set size of the process so far, in KiB (0 if unknown)
+    static size_t peakRssKb();
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Event {
+        const char* name;
+        int thread;
+        double startUs, durUs;
+        size_t peakRssKb;
+    };
+
+    bool on = false;
+    Clock::time_point origin = Clock::now();
+
+    mutable std::mutex m;
+    std::vector<Event> events;
+    std::vector<std::pair<std::string, std::string>> notes;
+    std::map<std::string, size_t> bytes;
+    std::map<std::string, SolverStats> solvers;
+    std::map<std::string, uint64_t> solverCalls;
+
+    void record(const char* name, Clock::time_point start, Clock::time_point end);
+    int threadIndex();
+};
@@ -0,0 +1,361 @@
+#include "PushRelabel.h"
+#include "Profiler.h"
+#include "HugePages.h"
+#include <algorithm>
+#include <limits>
+#include <cstdint>
+
+namespace {
+
+// lock-free add on an atomic capacity (CAS loop, fetch_add for floating point is C++20)
+template <typename Cap>
+inline void atomicAdd(std::atomic<Cap>& target, Cap value) {
+    Cap cur = target.load(std::memory_order_relaxed);
+    while (!target.compare_exchange_weak(cur, cur + value, std::memory_order_relaxed)) {}
+}
+
+} // namespace
+
+template <typename Cap>
+PushRelabel<Cap>::PushRelabel(int n_, int threads)
+    : n(n_), g(n_), pool(threads), label(n_, 0), newLabel(n_, 0), excess(n_, 0),
+      incoming(new std::atomic<Cap>[n_]),
+      labelCount(new std::atomic<int>[n_ + 1]),
+      isActive(new std::atomic<char>[n_]),
+      touched(new std::atomic<char>[n_]),
+      nodeCapacity(n_),
+      localTouched(pool.size()), localActive(pool.size()),
+      localWork(pool.size(), 0), localGap(pool.size(), 0), localSinkFlow(pool.size(), 0),
+      localStats(pool.size())
+{
+    for (int v = 0; v < n; ++v) {
+        incoming[v].store(0, std::memory_order_relaxed);
+        isActive[v].store(0, std::memory_order_relaxed);
+        touched[v].store(0, std::memory_order_relaxed);
+    }
+    for (int l = 0; l <= n; ++l) labelCount[l].store(0, std::memory_order_relaxed);
+}
+
+template <typename Cap>
+void PushRelabel<Cap>::reset(int n_) {
+    n = n_;
+    const bool huge = this->hugePages;
+    g.hugePages = huge;
+    g.reset(n_);
+    HugePages::assign(label, n_, 0, huge);
+    HugePages::assign(newLabel, n_, 0, huge);
+    HugePages::assign(excess, n_, Cap(0), huge);
+    if (n_ > nodeCapacity) {
+        incoming.reset(new std::atomic<Cap>[n_]);
+        labelCount.reset(new std::atomic<int>[n_ + 1]);
+        isActive.reset(new std::atomic<char>[n_]);
+        touched.reset(new std::atomic<char>[n_]);
+        nodeCapacity = n_;
+    }
+    for (int v = 0; v < n; ++v) {
+        incoming[v].store(0, std::memory_order_relaxed);
+        isActive[v].store(0, std::memory_order_relaxed);
+        touched[v].store(0, std::memory_order_relaxed);
+    }
+    for (int l = 0; l <= n; ++l) labelCount[l].store(0, std::memory_order_relaxed);
+    active.clear();
+    source = sink = -1;
+    sinkFlow = 0;
+}
+
+template <typename Cap>
+void PushRelabel<Cap>::add_edge(int u, int v, Cap cap, Cap rev_cap) {
+    g.add_edge(u, v, cap, rev_cap);
+}
+
+template <typename Cap>
+void PushRelabel<Cap>::reserve_edges(size_t m) {
+    g.reserve_edges(m);
+}
+
+template <typename Cap>
+void PushRelabel<Cap>::add_grid_edges(int W, int H, const Cap* capS, const Cap* capT,
+                             const Cap* right, const Cap* down, ThreadPool& pool) {
+    g.add_grid_edges(W, H, capS, capT, right, down, pool);
+}
+
+/* Exact labels: BFS distance to the sink in the residual graph, walked backwards level by level.
+   Each level is expanded in parallel, a node is claimed by whoever flips its touched flag first.
+   Nodes that cannot reach the sink get label n and drop out of the computation. */
+template <typename Cap>
+void PushRelabel<Cap>::globalRelabel() {
+    pool.parallelFor(0, n, [&](size_t b, size_t e, int) {
+        for (size_t v = b; v < e; ++v) {
+            label[v] = n;
+            touched[v].store(0, std::memory_order_relaxed);
+            labelCount[v].store(0, std::memory_order_relaxed);
+        }
+    });
+    labelCount[n].store(0, std::memory_order_relaxed);
+
+    frontier.assign(1, sink);
+    label[sink] = 0;
+    touched[sink].store(1, std::memory_order_relaxed);
+    touched[source].store(1, std::memory_order_relaxed);
+    labelCount[0].store(1, std::memory_order_relaxed);
+
+    int level = 0;
+    while (!frontier.empty()) {
+        ++level;
+        for (auto &local : localTouched) local.clear();
+        pool.parallelFor(0, frontier.size(), [&](size_t b, size_t e, int w) {
+            for (size_t i = b; i < e; ++i) {
+                const int u = frontier[i];
+                for (int a = g.begin(u); a < g.end(u); ++a) {
+                    const int x = g.head[a];
+                    if (!Traits::positive(g.cap[g.sister[a]])) continue;    // need residual x -> u
+                    if (touched[x].exchange(1)) continue;
+                    label[x] = level;
+                    localTouched[w].push_back(x);
+                }
+            }
+        });
+        frontier.clear();
+        for (auto &local : localTouched) frontier.insert(frontier.end(), local.begin(), local.end());
+        if (level < n) labelCount[level].store(static_cast<int>(frontier.size()), std::memory_order_relaxed);
+    }
+    label[source] = n;
+
+    pool.parallelFor(0, n, [&](size_t b, size_t e, int) {
+        for (size_t v = b; v < e; ++v) touched[v].store(0, std::memory_order_relaxed);
+    });
+}
+
+/* Push excess of v out through admissible arcs, relabel when stuck.
+   Reads only round-start labels of the neighbours, writes its own result to newLabel/excess. */
+template <typename Cap>
+void PushRelabel<Cap>::discharge(int v, int worker) {
+    Cap e = excess[v];
+    const int lv = label[v];
+    int d = lv;
+    uint64_t pushes = 0, relabels = 0;
+
+    while (Traits::positive(e)) {
+        int minLabel = std::numeric_limits<int>::max();
+        for (int a = g.begin(v); a < g.end(v); ++a) {
+            const int x = g.head[a];
+            const int lx = label[x];
+            // an active neighbour with a higher (label, id) owns the edge this round.
+            // If it might push back to us (lx <= lv + 1) we cannot trust the capacity, so we
+            // assume the arc will be residual, which can only make our new label lower.
+            if (isActive[x].load(std::memory_order_relaxed) && (lx > lv || (lx == lv && x > v))) {
+                if ((lx <= lv + 1 || Traits::positive(g.cap[a])) && lx + 1 < minLabel) minLabel = lx + 1;
+                continue;
+            }
+            const Cap c = g.cap[a];
+            if (!Traits::positive(c)) continue;
+            if (d == lx + 1) {
+                const Cap delta = std::min(c, e);
+                g.cap[a] -= delta;
+                g.cap[g.sister[a]] += delta;
+                e -= delta;
+                ++pushes;
+                if (x == sink) localSinkFlow[worker] += delta;
+                else atomicAdd(incoming[x], delta);
+                if (x != source && x != sink && !touched[x].exchange(1))
+                    localTouched[worker].push_back(x);
+                if (!Traits::positive(e)) break;
+            } else if (lx + 1 < minLabel) {
+                minLabel = lx + 1;
+            }
+        }
+        if (!Traits::positive(e)) break;
+
+        // relabel: every admissible arc is saturated
+        localWork[worker] += (g.end(v) - g.begin(v)) + RELABEL_WORK;
+        const int relabeled = std::min(minLabel, n);
+        if (relabeled <= d) break;      // blocked by a neighbour, retry next round
+        d = relabeled;
+        ++relabels;
+        if (d >= n) break;
+    }
+    localStats[worker].pushes += pushes;
+    localStats[worker].relabels += relabels;
+
+    newLabel[v] = d;
+    excess[v] = e;
+}
+
+// gap heuristic: no node has label gap, so nothing above it can reach the sink anymore
+template <typename Cap>
+void PushRelabel<Cap>::liftAboveGap(int gap) {
+    pool.parallelFor(0, n, [&](size_t b, size_t e, int) {
+        for (size_t v = b; v < e; ++v) {
+            const int l = label[v];
+            if (l > gap && l < n) {
+                labelCount[l].fetch_sub(1, std::memory_order_relaxed);
+                label[v] = n;
+            }
+        }
+    });
+}
+
+// active = every node (except the terminals) with excess and a label below n
+template <typename Cap>
+void PushRelabel<Cap>::collectActive() {
+    for (auto &local : localActive) local.clear();
+    pool.parallelFor(0, n, [&](size_t b, size_t e, int w) {
+        for (size_t i = b; i < e; ++i) {
+            const int v = static_cast<int>(i);
+            const bool act = v != source && v != sink && Traits::positive(excess[v]) && label[v] < n;
+            isActive[v].store(act ? 1 : 0, std::memory_order_relaxed);
+            if (act) localActive[w].push_back(v);
+        }
+    });
+    active.clear();
+    for (auto &local : localActive) active.insert(active.end(), local.begin(), local.end());
+}
+
+template <typename Cap>
+double PushRelabel<Cap>::max_flow(int s, int t) {
+    Profiler::Scope scope("max_flow");
+    this->counters = SolverStats();
+    for (SolverStats& local : localStats) local = SolverStats();
+    source = s;
+    sink = t;
+    g.finalize();
+
+    // saturate every arc out of the source, and if the node has a direct arc to the sink
+    // forward as much as possible right away (pixels have both t-links, most excess
+    // would otherwise spend a whole round just to take this one step)
+    sinkFlow = 0;
+    for (int a = g.begin(s); a < g.end(s); ++a) {
+        const Cap c = g.cap[a];
+        const int v = g.head[a];
+        if (c <= 0 || v == s) continue;
+        g.cap[a] = 0;
+        g.cap[g.sister[a]] += c;
+        if (v == t) { sinkFlow += c; continue; }
+        Cap ex = c;
+        for (int b = g.begin(v); b < g.end(v) && ex > 0; ++b) {
+            if (g.head[b] != t || g.cap[b] <= 0) continue;
+            const Cap delta = std::min(ex, g.cap[b]);
+            g.cap[b] -= delta;
+            g.cap[g.sister[b]] += delta;
+            ex -= delta;
+            sinkFlow += delta;
+        }
+        excess[v] += ex;
+    }
+    excess[s] = 0;
+
+    globalRelabel();
+    collectActive();
+    ++this->counters.globalRelabels;
+
+    // global relabel once the relabel work since the last one exceeds ~2n arc scans
+    const long long relabelThreshold = 2LL * n;
+    long long work = 0;
+
+    while (!active.empty()) {
+        ++this->counters.phases;
+        for (int w = 0; w < pool.size(); ++w) {
+            localTouched[w].clear();
+            localWork[w] = 0;
+            localGap[w] = n;
+            localSinkFlow[w] = 0;
+        }
+
+        pool.parallelFor(0, active.size(), [&](size_t b, size_t e, int w) {
+            for (size_t i = b; i < e; ++i) discharge(active[i], w);
+        });
+
+        // apply new labels of the discharged nodes and merge incoming excess of the touched ones
+        const size_t discharged = active.size();
+        for (auto &local : localTouched) active.insert(active.end(), local.begin(), local.end());
+        pool.parallelFor(0, active.size(), [&](size_t b, size_t e, int w) {
+            for (size_t i = b; i < e; ++i) {
+                const int v = active[i];
+                if (i < discharged) {
+                    const int oldLabel = label[v];
+                    const int nl = newLabel[v];
+                    if (nl != oldLabel) {
+                        if (labelCount[oldLabel].fetch_sub(1, std::memory_order_relaxed) == 1)
+                            localGap[w] = std::min(localGap[w], oldLabel);
+                        if (nl < n) labelCount[nl].fetch_add(1, std::memory_order_relaxed);
+                        label[v] = nl;
+                    }
+                    isActive[v].store(0, std::memory_order_relaxed);
+                } else {
+                    excess[v] += incoming[v].exchange(0, std::memory_order_relaxed);
+                    touched[v].store(0, std::memory_order_relaxed);
+                }
+            }
+        });
+
+        int gap = n;
+        for (int w = 0; w < pool.size(); ++w) {
+            gap = std::min(gap, localGap[w]);
+            work += localWork[w];
+            sinkFlow += localSinkFlow[w];
+        }
+        if (gap < n && labelCount[gap].load(std::memory_order_relaxed) == 0) liftAboveGap(gap);
+
+        if (work > relabelThreshold) {
+            work = 0;
+            globalRelabel();
+            collectActive();
+            ++this->counters.globalRelabels;
+            continue;
+        }
+
+        // next round: discharged or touched nodes that still hold excess (each once)
+        for (auto &local : localActive) local.clear();
+        pool.parallelFor(0, active.size(), [&](size_t b, size_t e, int w) {
+            for (size_t i = b; i < e; ++i) {
+                const int v = active[i];
+                if (Traits::positive(excess[v]) && label[v] < n && !isActive[v].exchange(1))
+                    localActive[w].push_back(v);
+            }
+        });
+        active.clear();
+        for (auto &local : localActive) active.insert(active.end(), local.begin(), local.end());
+    }
+
+    for (const SolverStats& local : localStats) {
+        this->counters.pushes += local.pushes;
+        this->counters.relabels += local.relabels;
+    }
+    this->reportStats("pr", n, g.numArcs(), g.bytes()
+        + static_cast<size_t>(n) * (2 * sizeof(int) + 2 * sizeof(Cap) + sizeof(int) + 2)
+        + active.capacity() * sizeof(int));
+    return Traits::toCost(sinkFlow);
+}
+
+/* After a maximum preflow the nodes that cannot reach the sink in the residual graph
+   form the source side of a minimum cut. */
+template <typename Cap>
+void PushRelabel<Cap>::minCut(int s, std::vector<bool>& side) const {
+    Profiler::Scope scope("minCut");
+    side.assign(n, true);
+    if (!g.finalized() || sink < 0) {
+        std::fill(side.begin(), side.end(), false);
+        side[s] = true;
+        return;
+    }
+    std::vector<int>& stack = cutStack;
+    stack.clear();
+    stack.push_back(sink);
+    side[sink] = false;
+    while (!stack.empty()) {
+        const int u = stack.back();
+        stack.pop_back();
+        for (int a = g.begin(u); a < g.end(u); ++a) {
+            const int x = g.head[a];
+            if (side[x] && Traits::positive(g.cap[g.sister[a]])) {
+                side[x] = false;
+                stack.push_back(x);
+            }
+        }
+    }
+    side[s] = true;
+}
+
+template class PushRelabel<double>;
+template class PushRelabel<float>;
+template class PushRelabel<int32_t>;
@@ -0,0 +1,78 @@
+#pragma once
+#include "MaxFlow.h"
+#include "FlowGraph.h"
+#include "ThreadPool.h"
+#include <vector>
+#include <atomic>
+#include <memory>
+
+/* Synchronous parallel push-relabel (in the spirit of Baumstark, Blelloch & Shun, ESA 2015).
+
+   Work proceeds in rounds. In every round all active nodes (excess > 0, label < n) are
+   discharged in parallel against the labels from the start of the round:
+   - a node pushes along admissible arcs (label[v] == label[w] + 1) and relabels when it runs out
+   - when two active nodes share an edge, only the one with the higher (label, id) may use it,
+     so residual capacities are never written by two threads at once
+   - a node that gave up an edge to a stronger neighbour does not relabel in this round
+   - excess sent to a neighbour goes into an atomic "incoming" counter (lock-free CAS add)
+     and is merged after the round
+   Global relabeling (reverse BFS from the sink) runs periodically, and the gap heuristic
+   lifts every node above an emptied label straight to n.
+
+   This computes a maximum preflow. The min cut is read as "nodes that can no longer reach the
+   sink", which is the largest source side (Dinic/BK report the smallest one, the two only
+   differ on zero-cost ties).
+
+   Flow that reaches the sink is counted per worker in Sum, so the fixed point capacity type
+   never has to hold the whole flow of the image in one int32 counter. */
+template <typename Cap>
+class PushRelabel : public MaxFlow<Cap> {
+public:
+    using Traits = CapacityTraits<Cap>;
+    using Sum = typename Traits::Sum;
+
+    int n;
+
+    PushRelabel(int n = 0, int threads = 0);
+    void add_edge(int u, int v, Cap cap, Cap rev_cap = Cap(0)) override;
+    void reserve_edges(size_t m) override;
+    void add_grid_edges(int W, int H, const Cap* capS, const Cap* capT,
+                        const Cap* right, const Cap* down, ThreadPool& pool) override;
+    double max_flow(int s, int t) override;
+    using MaxFlow<Cap>::minCut;
+    void minCut(int s, std::vector<bool>& side) const override;
+    void reset(int n) override;
+
+private:
+    // work charged per relabel on top of its arc scans, the usual global update heuristic
+    static constexpr long long RELABEL_WORK = 12;
+
+    FlowGraph<Cap> g;
+    ThreadPool pool;
+    int source = -1, sink = -1;
+
+    std::vector<int> label;                     // labels from the start of the round
+    std::vector<int> newLabel;                  // labels written during the round
+    std::vector<Cap> excess;
+    std::unique_ptr<std::atomic<Cap>[]> incoming;
+    std::unique_ptr<std::atomic<int>[]> labelCount;
+    std::unique_ptr<std::atomic<char>[]> isActive;
+    std::unique_ptr<std::atomic<char>[]> touched;
+
+    std::vector<int> active;
+    std::vector<int> frontier;                  // globalRelabel
+    mutable std::vector<int> cutStack;          // minCut
+    int nodeCapacity = 0;                       // size of the atomic arrays (>= n after a reset)
+    std::vector<std::vector<int>> localTouched;   // per worker
+    std::vector<std::vector<int>> localActive;    // per worker
+    std::vector<long long> localWork;             // per worker
+    std::vector<int> localGap;                    // per worker
+    std::vector<Sum> localSinkFlow;               // per worker
+    std::vector<SolverStats> localStats;          // per worker (pushes, relabels)
+    Sum sinkFlow = 0;
+
+    void globalRelabel();
+    void discharge(int v, int worker);
+    void liftAboveGap(int gap);
+    void collectActive();
+};
@@ -0,0 +1,101 @@
+#include "PyramidSegmenter.h"
+#include "BandRefiner.h"
+#include "DataModel.h"
+#include "GraphBuilder.h"
+#include "ThreadPool.h"
+#include <cmath>
+#include <memory>
+#include <algorithm>
+
+// stop halving once the image gets this small, the coarse cut is meaningless below it
+static constexpr int MIN_LEVEL_SIZE = 32;
+
+template <typename Cap>
+PyramidSegmenter<Cap>::PyramidSegmenter(SolverType solver_, int threads_, int levels_, int band_, double lambda_)
+    : solver(solver_), threads(threads_), levels(std::max(1, levels_)), band(std::max(0, band_)), lambda(lambda_) {}
+
+template <typename Cap>
+void PyramidSegmenter<Cap>::setHardSeeds(bool fg_hard, bool bg_hard) {
+    fgHard = fg_hard;
+    bgHard = bg_hard;
+}
+
+template <typename Cap>
+std::vector<bool> PyramidSegmenter<Cap>::segment(const Image& img, const SeedMask& seeds) {
+    if (seeds.width() != img.width() || seeds.height() != img.height())
+        throw std::runtime_error("PyramidSegmenter: seed mask size does not match the image");
+    levelStats.clear();
+
+    // level 0 is the input itself, level k is half the size of level k-1
+    std::vector<Image> images;
+    std::vector<SeedMask> masks;
+    images.reserve(levels);
+    masks.reserve(levels);
+    const Image* curImg = &img;
+    const SeedMask* curSeeds = &seeds;
+    for (int l = 1; l < levels; ++l) {
+        if (std::min(curImg->width(), curImg->height()) < 2 * MIN_LEVEL_SIZE) break;
+        images.push_back(curImg->downsample2x());
+        masks.push_back(curSeeds->downsample2x());
+        curImg = &images.back();
+        curSeeds = &masks.back();
+    }
+    auto levelImage = [&](int l) -> const Image& { return l == 0 ? img : images[l - 1]; };
+    auto levelSeeds = [&](int l) -> const SeedMask& { return l == 0 ? seeds : masks[l - 1]; };
+
+    const int top = static_cast<int>(images.size());
+    std::vector<uint8_t> labels;
+    solveFull(levelImage(top), levelSeeds(top), labels);
+
+    for (int l = top - 1; l >= 0; --l) {
+        const Image& fine = levelImage(l);
+        const int W = fine.width(), H = fine.height();
+        const int Wc = levelImage(l + 1).width();
+
+        // nearest neighbour upsampling of the coarse cut
+        std::vector<uint8_t> up(static_cast<size_t>(W) * H);
+        for (int y = 0; y < H; ++y) {
+            const uint8_t* src = &labels[static_cast<size_t>(y / 2) * Wc];
+            uint8_t* dst = &up[static_cast<size_t>(y) * W];
+            for (int x = 0; x < W; ++x) dst[x] = src[x / 2];
+        }
+        labels.swap(up);
+        refineBand(fine, levelSeeds(l), labels);
+    }
+
+    return std::vector<bool>(labels.begin(), labels.end());
+}
+
+// plain full graph, same as the single level pipeline
+template <typename Cap>
+void PyramidSegmenter<Cap>::solveFull(const Image& img, const SeedMask& seeds, std::vector<uint8_t>& labels) {
+    const int W = img.width(), H = img.height();
+    DataModel<Cap> dm(bins, 1.0, 1e-9);
+    dm.setHardSeeds(fgHard, bgHard);
+    ThreadPool pool(threads);
+    dm.buildHistograms(img, seeds, &pool);
+    dm.computeDataCosts(img, seeds, &pool);
+
+    GraphBuilder<Cap> gb(img, dm, lambda, solver, threads);
+    auto G = gb.buildGraph();
+    const double flow = G->max_flow(W * H, W * H + 1);
+    const std::vector<bool> cut = G->minCut(W * H);
+
+    labels.resize(static_cast<size_t>(W) * H);
+    for (size_t i = 0; i < labels.size(); ++i) labels[i] = cut[i] ? 1 : 0;
+    levelStats.push_back({W, H, labels.size(), flow});
+}
+
+template <typename Cap>
+void PyramidSegmenter<Cap>::refineBand(const Image& img, const SeedMask& seeds, std::vector<uint8_t>& labels) {
+    BandRefiner<Cap> refiner(solver, threads, band, lambda);
+    refiner.setHardSeeds(fgHard, bgHard);
+    refiner.setBins(bins);
+    double flow = 0.0;
+    const size_t n = refiner.refine(img, seeds, labels, &flow);
+    levelStats.push_back({img.width(), img.height(), n, flow});
+}
+
+template class PyramidSegmenter<double>;
+template class PyramidSegmenter<float>;
+template class PyramidSegmenter<int32_t>;
@@ -0,0 +1,58 @@
+#pragma once
+#include "Image.h"
+#include "SeedMask.h"
+#include "MaxFlow.h"
+#include <vector>
+#include <cstdint>
+
+/*
+Coarse-to-fine segmentation (--levels N --band B).
+
+The image and the seeds are halved levels-1 times. The coarsest level is segmented with
+the normal full graph. Every finer level starts from the upsampled mask of the level
+below and only rebuilds the graph for a narrow band of pixels around its boundary
+(see BandRefiner).
+
+On large photos the boundary is a tiny fraction of the pixels, so the full resolution
+graph (data costs, n-links, max-flow) shrinks by one or two orders of magnitude.
+Thin structures narrower than the coarsest pixels can get lost, more levels = faster but
+coarser, a wider band recovers more of the coarse error.
+*/
+template <typename Cap>
+class PyramidSegmenter {
+public:
+    // what happened at one level, coarsest level first
+    struct LevelStats {
+        int width, height;
+        size_t graphPixels;     // pixel nodes in the graph (W*H at the coarsest level)
+        double flow;
+    };
+
+    PyramidSegmenter(SolverType solver = SolverType::Dinic, int threads = 0,
+                     int levels = 3, int band = 4, double lambda = 50.0);
+
+    // same meaning as DataModel::setHardSeeds
+    void setHardSeeds(bool fg_hard, bool bg_hard);
+    // colour histogram bins per channel (8, 16 or 32), see DataModel::setBins
+    void setBins(int binsPerChannel) { bins = binsPerChannel; }
+
+    // source side of the cut at full resolution, W*H entries (true = foreground)
+    std::vector<bool> segment(const Image& img, const SeedMask& seeds);
+
+    const std::vector<LevelStats>& stats() const { return levelStats; }
+
+private:
+    SolverType solver;
+    int threads;
+    int levels;
+    int band;
+    double lambda;
+    bool fgHard = true, bgHard = true;
+    int bins = 8;
+
+    std::vector<LevelStats> levelStats;
+
+    // labels: 0/1 per pixel of this level, in = coarse guess, out = refined cut
+    void solveFull(const Image& img, const SeedMask& seeds, std::vector<uint8_t>& labels);
+    void refineBand(const Image& img, const SeedMask& seeds, std::vector<uint8_t>& labels);
+};
@@ -0,0 +1,49 @@
+#pragma once
+#include <vector>
+#include <cstddef>
+
+/*
+Double ended queue in one power of two ring buffer, for the active / orphan queues of the
+BK engines. std::deque allocates and frees a 512 byte block every 128 entries that pass
+through it, which is a steady stream of heap traffic during a solve; this one only grows
+(doubling) and keeps its buffer across clear(), so an engine that is reused does not
+allocate at all once the queues reached their working size.
+Same order of elements as std::deque for push_front / push_back / pop_front.
+*/
+template <typename T>
+class RingDeque {
+public:
+    bool empty() const { return count == 0; }
+    size_t size() const { return count; }
+    size_t capacity() const { return buf.size(); }
+    void clear() { first = 0; count = 0; }
+
+    T& front() { return buf[first]; }
+
+    void push_back(const T& v) {
+        if (count == buf.size()) grow();
+        buf[(first + count) & (buf.size() - 1)] = v;
+        ++count;
+    }
+    void push_front(const T& v) {
+        if (count == buf.size()) grow();
+        first = (first + buf.size() - 1) & (buf.size() - 1);
+        buf[first] = v;
+        ++count;
+    }
+    void pop_front() {
+        first = (first + 1) & (buf.size() - 1);
+        --count;
+    }
+
+private:
+    std::vector<T> buf;
+    size_t first = 0, count = 0;
+
+    void grow() {
+        std::vector<T> bigger(buf.empty() ? 64 : buf.size() * 2);
+        for (size_t i = 0; i < count; ++i) bigger[i] = buf[(first + i) & (buf.size() - 1)];
+        buf.swap(bigger);
+        first = 0;
+    }
+};
@@ -1,7 +1,8 @@
 #include "SeedMask.h"
-#include <fstream>
+#include "MappedFile.h"
 #include <stdexcept>
 #include <algorithm>
+#include <utility>
 
 /*
 cast per pixel seed information from the binary file (written by python)
@@ -11,17 +12,30 @@ SeedMask::SeedMask(const std::string& seed_bin_path, int width, int height)
     : W(width), H(height)
 {
     size_t expected = static_cast<size_t>(W) * H;
-    data.resize(expected);
-    std::ifstream in(seed_bin_path, std::ios::binary);
-    if (!in) throw std::runtime_error("SeedMask: failed to open " + seed_bin_path);
-    in.read(reinterpret_cast<char*>(data.data()), expected);
-    if (!in) throw std::runtime_error("SeedMask: failed to read expected bytes from " + seed_bin_path);
+    mapping = std::make_shared<const MappedFile>(seed_bin_path);
+    if (mapping->size() < expected)
+        throw std::runtime_error("SeedMask: failed to read expected bytes from " + seed_bin_path);
+    data = reinterpret_cast<const int8_t*>(mapping->data());
+}
+
+SeedMask::SeedMask(std::vector<int8_t> labels, int width, int height)
+    : W(width), H(height), owned(std::move(labels))
+{
+    if (owned.size() != static_cast<size_t>(W) * H)
+        throw std::runtime_error("SeedMask: label count does not match width * height");
+    data = owned.data();
+}
+
+SeedMask::SeedMask(const int8_t* labels, int width, int height)
+    : W(width), H(height), data(labels)
+{
+    if (!labels || W <= 0 || H <= 0) throw std::runtime_error("SeedMask: empty label buffer");
 }
 
 SeedMask::SeedMask(int width, int height, int x0, int y0, int x1, int y1)
     : W(width), H(height)
 {
-    data.assign(static_cast<size_t>(W)*H, -1);
+    owned.assign(static_cast<size_t>(W)*H, -1);
     // clamp
     x0 = std::max(0, std::min(x0, W-1));
     x1 = std::max(0, std::min(x1, W-1));
@@ -33,14 +47,45 @@ SeedMask::SeedMask(int width, int height, int x0, int y0, int x1, int y1)
     // outside rectangle => sure background (0)
     for (int y = 0; y < H; ++y) {
         for (int x = 0; x < W; ++x) {
-            if (x < x0 || x > x1 || y < y0 || y > y1) data[y * W + x] = 0;
-            else data[y * W + x] = -1; // inside rectangle = unknown
+            if (x < x0 || x > x1 || y < y0 || y > y1) owned[static_cast<size_t>(y) * W + x] = 0;
+            else owned[static_cast<size_t>(y) * W + x] = -1; // inside rectangle = unknown
         }
     }
+    data = owned.data();
 }
 //Not using this in this project
 
 int SeedMask::getLabel(int x, int y) const {
     if (x < 0 || x >= W || y < 0 || y >= H) return 0;
-    return static_cast<int>(data[y * W + x]);
+    return static_cast<int>(data[static_cast<size_t>(y) * W + x]);
+}
+
+void SeedMask::setLabel(int x, int y, int label) {
+    if (x < 0 || x >= W || y < 0 || y >= H) return;
+    if (data != owned.data()) {
+        owned.assign(data, data + static_cast<size_t>(W) * H);
+        mapping.reset();
+        data = owned.data();
+    }
+    owned[static_cast<size_t>(y) * W + x] = static_cast<int8_t>(label);
+}
+
+SeedMask SeedMask::downsample2x() const {
+    const int w = (W + 1) / 2, h = (H + 1) / 2;
+    std::vector<int8_t> out(static_cast<size_t>(w) * h);
+    for (int y = 0; y < h; ++y) {
+        for (int x = 0; x < w; ++x) {
+            bool fg = false, bg = false;
+            for (int yy = 2 * y; yy <= std::min(2 * y + 1, H - 1); ++yy) {
+                for (int xx = 2 * x; xx <= std::min(2 * x + 1, W - 1); ++xx) {
+                    const int8_t l = data[static_cast<size_t>(yy) * W + xx];
+                    fg |= (l == 1);
+                    bg |= (l == 0);
+                }
+            }
+            // a thin scribble must survive the downsampling, conflicting blocks stay unknown
+            out[static_cast<size_t>(y) * w + x] = (fg && !bg) ? 1 : (bg && !fg) ? 0 : -1;
+        }
+    }
+    return SeedMask(std::move(out), w, h);
 }
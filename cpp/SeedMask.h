@@ -1,8 +1,11 @@
 #pragma once
 #include <vector>
 #include <string>
+#include <memory>
 #include <cstdint>
 
+class MappedFile;
+
 /*
 Simple abstracted class to maintain seed information
 This supports both rectangular coordinates based input (for rectangular user input)
@@ -10,9 +13,15 @@ and general mask, though in this project we are not using rectangular mode
 */
 class SeedMask {
 public:
-    // Construct from full mask file (int8 raw)
+    // Construct from full mask file (int8 raw), memory mapped instead of copied
     SeedMask(const std::string& seed_bin_path, int width, int height);
 
+    // Construct from labels already in memory (e.g. received by the server), row-major
+    SeedMask(std::vector<int8_t> labels, int width, int height);
+
+    // Labels owned by the caller, not copied (they must outlive the mask, see Image)
+    SeedMask(const int8_t* labels, int width, int height);
+
     // Construct from rectangle: outside rect => 0 (bg), inside => -1 (unknown)
     SeedMask(int width, int height, int x0, int y0, int x1, int y1);
     //Not being used here
@@ -24,10 +33,28 @@ public:
     this will finally return the initial seed status of the pixel
     */
 
+    // Change a single pixel (-1 unknown, 0 background, 1 foreground)
+    // (a mask loaded from a file or borrowed from the caller gets copied on the first change)
+    void setLabel(int x, int y, int label);
+
     int width() const { return W; }
     int height() const { return H; }
 
+    // raw labels, row-major, W*H entries (used to diff two masks)
+    const int8_t* raw() const { return data; }
+
+    // half resolution copy for the pyramid mode, one label per 2x2 block:
+    // foreground/background if the block holds only that kind of seed, unknown otherwise
+    SeedMask downsample2x() const;
+
+    SeedMask(const SeedMask&) = delete;
+    SeedMask& operator=(const SeedMask&) = delete;
+    SeedMask(SeedMask&&) = default;
+
 private:
     int W, H;
-    std::vector<int8_t> data; // row-major
+    // labels live in the file mapping, in `owned` or in the caller's buffer, same idea as Image
+    std::shared_ptr<const MappedFile> mapping;
+    std::vector<int8_t> owned;
+    const int8_t* data = nullptr; // row-major
 };
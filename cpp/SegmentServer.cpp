@@ -0,0 +1,151 @@
+#include "SegmentServer.h"
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+
+namespace {
+
+// the protocol is little-endian, decode byte by byte so the host byte order does not matter
+uint32_t readU32(const uint8_t* p) {
+    return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8)
+         | (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+void writeU32(uint8_t* p, uint32_t v) {
+    p[0] = static_cast<uint8_t>(v);
+    p[1] = static_cast<uint8_t>(v >> 8);
+    p[2] = static_cast<uint8_t>(v >> 16);
+    p[3] = static_cast<uint8_t>(v >> 24);
+}
+
+} // namespace
+
+template <typename Cap>
+SegmentServer<Cap>::SegmentServer(std::FILE* in_, std::FILE* out_, SolverType solver_, int threads_)
+    : in(in_), out(out_), solver(solver_), threads(threads_) {}
+
+template <typename Cap>
+bool SegmentServer<Cap>::readExact(void* dst, size_t bytes) {
+    return bytes == 0 || std::fread(dst, 1, bytes, in) == bytes;
+}
+
+// the length comes from the client, bound it by the request type before allocating
+// (the handlers check the exact size)
+template <typename Cap>
+size_t SegmentServer<Cap>::maxLength(uint32_t type) const {
+    const size_t N = image ? static_cast<size_t>(image->width()) * image->height() : MAX_PIXELS;
+    switch (type) {
+        case IMAGE: return 8 + MAX_PIXELS * 3;
+        case SEEDS: return N;
+        case STROKE: return 5 * N;
+        default: return 0;
+    }
+}
+
+template <typename Cap>
+void SegmentServer<Cap>::reply(Status status, const void* data, size_t bytes) {
+    uint8_t header[8];
+    writeU32(header, status);
+    writeU32(header + 4, static_cast<uint32_t>(bytes));
+    std::fwrite(header, 1, sizeof(header), out);
+    if (bytes) std::fwrite(data, 1, bytes, out);
+    std::fflush(out);
+}
+
+template <typename Cap>
+void SegmentServer<Cap>::handleImage() {
+    if (payload.size() < 8) throw std::runtime_error("IMAGE: missing width/height");
+    const uint32_t W = readU32(payload.data());
+    const uint32_t H = readU32(payload.data() + 4);
+    if (W == 0 || H == 0 || payload.size() != 8 + static_cast<size_t>(W) * H * 3)
+        throw std::runtime_error("IMAGE: payload size does not match W*H*3");
+
+    // the segmenter keeps a reference to the image, drop it first
+    segmenter.reset();
+    seeds.reset();
+    image.reset(new Image(std::vector<uint8_t>(payload.begin() + 8, payload.end()),
+                          static_cast<int>(W), static_cast<int>(H), 3));
+    segmenter.reset(new IncrementalSegmenter<Cap>(*image, solver, threads));
+    segmenter->setBins(bins);
+    // every request gets the colour model of its own seeds, like a run of the CLI
+    segmenter->setRefitModel(true);
+    reply(OK, nullptr, 0);
+}
+
+template <typename Cap>
+void SegmentServer<Cap>::handleSeeds() {
+    if (!image) throw std::runtime_error("SEEDS: no image loaded");
+    const size_t N = static_cast<size_t>(image->width()) * image->height();
+    if (payload.size() != N) throw std::runtime_error("SEEDS: payload size does not match W*H");
+
+    std::vector<int8_t> labels(N);
+    std::memcpy(labels.data(), payload.data(), N);
+    seeds.reset(new SeedMask(std::move(labels), image->width(), image->height()));
+    segmentAndReply();
+}
+
+template <typename Cap>
+void SegmentServer<Cap>::handleStroke() {
+    if (!seeds) throw std::runtime_error("STROKE: send SEEDS once before strokes");
+    if (payload.size() % 5 != 0) throw std::runtime_error("STROKE: payload is not a list of (index, label)");
+    const int W = image->width();
+    const uint32_t N = static_cast<uint32_t>(W) * image->height();
+    // check the whole list first, a bad entry leaves the seeds as they were
+    for (size_t off = 0; off < payload.size(); off += 5) {
+        if (readU32(payload.data() + off) >= N) throw std::runtime_error("STROKE: pixel index out of range");
+        const int8_t label = static_cast<int8_t>(payload[off + 4]);
+        if (label < -1 || label > 1) throw std::runtime_error("STROKE: label must be -1, 0 or 1");
+    }
+    for (size_t off = 0; off < payload.size(); off += 5) {
+        const uint32_t idx = readU32(payload.data() + off);
+        seeds->setLabel(static_cast<int>(idx % W), static_cast<int>(idx / W),
+                        static_cast<int8_t>(payload[off + 4]));
+    }
+    segmentAndReply();
+}
+
+template <typename Cap>
+void SegmentServer<Cap>::segmentAndReply() {
+    segmenter->segment(*seeds);
+    std::vector<bool> side = segmenter->mask();
+    const size_t N = static_cast<size_t>(image->width()) * image->height();
+    mask.resize(N);
+    for (size_t i = 0; i < N; ++i) mask[i] = side[i] ? 1 : 0;
+    reply(OK, mask.data(), mask.size());
+}
+
+template <typename Cap>
+int SegmentServer<Cap>::run() {
+    while (true) {
+        uint8_t header[8];
+        if (!readExact(header, sizeof(header))) return 0;      // client closed the pipe
+        const uint32_t type = readU32(header);
+        const uint32_t length = readU32(header + 4);
+        if (length > maxLength(type)) {
+            // nothing sane can follow a bogus length, answer and end the session
+            const std::string msg = "payload of " + std::to_string(length) + " bytes for request type "
+                                  + std::to_string(type) + ", at most " + std::to_string(maxLength(type)) + " expected";
+            reply(FAILED, msg.data(), msg.size());
+            return 1;
+        }
+        payload.resize(length);
+        if (!readExact(payload.data(), length)) return 1;
+
+        try {
+            switch (type) {
+                case IMAGE: handleImage(); break;
+                case SEEDS: handleSeeds(); break;
+                case STROKE: handleStroke(); break;
+                case QUIT: reply(OK, nullptr, 0); return 0;
+                default: throw std::runtime_error("unknown request type " + std::to_string(type));
+            }
+        } catch (const std::exception &e) {
+            const std::string msg = e.what();
+            reply(FAILED, msg.data(), msg.size());
+        }
+    }
+}
+
+template class SegmentServer<double>;
+template class SegmentServer<float>;
+template class SegmentServer<int32_t>;
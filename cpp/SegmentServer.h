@@ -0,0 +1,73 @@
+#pragma once
+#include "Image.h"
+#include "SeedMask.h"
+#include "IncrementalSegmenter.h"
+#include "MaxFlow.h"
+#include <cstdio>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+/*
+Long-lived segmentation server (segment --serve), so the GUI does not start a process,
+re-read the image and rebuild everything for every click.
+
+The protocol runs over stdin/stdout. Every integer is a little-endian uint32.
+
+Request:  type, length, then `length` payload bytes
+  IMAGE  (1): W, H, then W*H*3 RGB bytes (row-major). Starts a new session.
+  SEEDS  (2): W*H int8 labels (-1 unknown, 0 background, 1 foreground)
+  STROKE (3): n times { pixel index (uint32), label (int8) }, applied to the last seeds
+  QUIT   (4): empty
+Response: status (0 = ok, 1 = error), length, then the payload
+  IMAGE / QUIT:   empty
+  SEEDS / STROKE: W*H uint8 mask (1 = foreground), same layout as the mask files
+  error:          message text
+A request longer than its type allows (IMAGE: 8 + W*H*3 with W*H up to MAX_PIXELS,
+SEEDS: W*H, STROKE: 5*W*H of the loaded image, QUIT: 0) is answered with an error before
+anything is allocated, and the server exits (the stream cannot be trusted any more).
+
+The image stays resident for the whole session. The first SEEDS request builds the graph
+(beta and every n-link are computed once per image), later requests rebuild the colour
+model from their seeds and re-solve incrementally through IncrementalSegmenter
+(setRefitModel): the mask is the one the CLI gives for the same seeds.
+*/
+template <typename Cap>
+class SegmentServer {
+public:
+    enum RequestType : uint32_t { IMAGE = 1, SEEDS = 2, STROKE = 3, QUIT = 4 };
+    enum Status : uint32_t { OK = 0, FAILED = 1 };
+    static constexpr size_t MAX_PIXELS = size_t(1) << 26;     // 8192 x 8192
+
+    SegmentServer(std::FILE* in, std::FILE* out, SolverType solver, int threads);
+
+    // colour histogram bins per channel (8, 16 or 32) for the sessions, see DataModel::setBins
+    void setBins(int binsPerChannel) { bins = binsPerChannel; }
+
+    // serve requests until QUIT or end of input, returns the process exit code
+    int run();
+
+private:
+    std::FILE* in;
+    std::FILE* out;
+    SolverType solver;
+    int threads;
+    int bins = 8;
+
+    std::unique_ptr<Image> image;
+    std::unique_ptr<SeedMask> seeds;
+    std::unique_ptr<IncrementalSegmenter<Cap>> segmenter;
+
+    std::vector<uint8_t> payload;
+    std::vector<uint8_t> mask;
+
+    bool readExact(void* dst, size_t bytes);
+    size_t maxLength(uint32_t type) const;
+    void reply(Status status, const void* data, size_t bytes);
+
+    void handleImage();
+    void handleSeeds();
+    void handleStroke();
+    void segmentAndReply();
+};
@@ -0,0 +1,80 @@
+#include "SegmentationContext.h"
+#include "HugePages.h"
+#include "Profiler.h"
+
+template <typename Cap>
+SegmentationContext<Cap>::SegmentationContext(SolverType solver_, int threads_, double lambda_)
+    : solver(solver_), threads(threads_), lambda(lambda_), pool(threads_) {}
+
+template <typename Cap>
+void SegmentationContext<Cap>::setHardSeeds(bool fg_hard, bool bg_hard) {
+    dm.setHardSeeds(fg_hard, bg_hard);
+}
+
+template <typename Cap>
+void SegmentationContext<Cap>::setReduction(bool enabled, int margin) {
+    reduce = enabled;
+    cropMargin = margin;
+}
+
+template <typename Cap>
+void SegmentationContext<Cap>::setHugePages(bool on) {
+    hugePages = on;
+    dm.setHugePages(on);
+    ws.hugePages = on;
+    if (engine) engine->setHugePages(on);
+}
+
+template <typename Cap>
+double SegmentationContext<Cap>::segment(const Image& img, const SeedMask& seeds) {
+    const int W = img.width(), H = img.height();
+
+    // the image builds its planes in our buffer and hands it back at the end (also on a throw)
+    HugePages::resize(planes, static_cast<size_t>(W) * H * img.channels(), hugePages);
+    struct Lend {
+        const Image& img;
+        std::vector<uint8_t>& planes;
+        ~Lend() { img.returnPlanes(planes); }
+    } lend{img, planes};
+    img.lendPlanes(planes);
+
+    dm.buildHistograms(img, seeds, &pool);
+    dm.computeDataCosts(img, seeds, &pool);
+
+    // an empty engine, the builder resets it to the size of every graph
+    if (!engine) {
+        engine = makeGridMaxFlow<Cap>(solver, 0, 0, threads);
+        engine->setHugePages(hugePages);
+    }
+
+    GraphBuilder<Cap> gb(img, dm, lambda, solver, threads);
+    if (reduce) {
+        gb.buildReducedGraph(engine, seeds, cropMargin, red, ws, pool);
+    } else {
+        gb.buildGraph(engine, ws, pool);
+        red.W = W;  red.H = H;
+        red.x0 = 0;  red.y0 = 0;  red.width = W;  red.height = H;
+        red.folded = false;
+        red.unknown = static_cast<size_t>(W) * H;
+        red.constantFlow = 0.0;
+    }
+
+    const int n = red.width * red.height;
+    const double flow = engine->max_flow(n, n + 1) + red.constantFlow;
+    engine->minCut(n, side);
+    red.expand(side, seeds, fg);
+
+    Profiler::global().memory("context", reservedBytes());
+    return flow;
+}
+
+template <typename Cap>
+size_t SegmentationContext<Cap>::reservedBytes() const {
+    size_t bytes = dm.bytes() + ws.bytes() + planes.capacity() + (side.capacity() + fg.capacity()) / 8;
+    if (engine) bytes += engine->stats().bytes;
+    return bytes;
+}
+
+template class SegmentationContext<double>;
+template class SegmentationContext<float>;
+template class SegmentationContext<int32_t>;
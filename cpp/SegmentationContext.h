@@ -0,0 +1,70 @@
+#pragma once
+#include "Image.h"
+#include "SeedMask.h"
+#include "DataModel.h"
+#include "GraphBuilder.h"
+#include "MaxFlow.h"
+#include "ThreadPool.h"
+#include <memory>
+#include <vector>
+#include <cstdint>
+
+/*
+The histogram + graph cut pipeline with every buffer kept from one run to the next
+(single runs in main, one per --batch worker).
+
+A run needs the planar copy of the image, the two data cost planes, the n-link table and
+planes (plus the folded t-links of the reduced graph), the engine's graph and search
+state, and the cut. The first run allocates them, a later run of an image with the same
+or fewer pixels reuses all of them (the engine is reset, MaxFlow::reset, not rebuilt)
+and does no heap allocation. A bigger image grows them once, nothing is ever shrunk:
+reservedBytes() is what the context holds between runs.
+
+setHugePages: the large arrays are allocated with transparent huge pages (HugePages.h),
+this only affects buffers that grow after the call, so set it before the first run.
+
+The result is the same as GraphBuilder with a fresh engine per run.
+*/
+template <typename Cap>
+class SegmentationContext {
+public:
+    SegmentationContext(SolverType solver = SolverType::Dinic, int threads = 0, double lambda = 50.0);
+
+    // same meaning as DataModel::setHardSeeds
+    void setHardSeeds(bool fg_hard, bool bg_hard);
+    // solve the reduced graph (GraphBuilder::buildReducedGraph, on by default) or the full one
+    void setReduction(bool enabled, int margin = 0);
+    void setHugePages(bool on);
+    // colour histogram bins per channel, see DataModel::setBins
+    void setBins(int binsPerChannel) { dm.setBins(binsPerChannel); }
+
+    // one run, returns the max-flow value (cost units)
+    double segment(const Image& img, const SeedMask& seeds);
+
+    // W*H mask of the last run (true = foreground)
+    const std::vector<bool>& mask() const { return fg; }
+    // what the last run left out of the graph (the whole image if reduction is off)
+    const GraphReduction& reduction() const { return red; }
+    // counters of the last max_flow
+    const SolverStats& solverStats() const { return engine->stats(); }
+
+    // bytes held between runs: image planes, cost planes, n-link buffers, engine, cut
+    size_t reservedBytes() const;
+
+private:
+    SolverType solver;
+    int threads;
+    double lambda;
+    bool reduce = true;
+    int cropMargin = 0;
+    bool hugePages = false;
+
+    ThreadPool pool;
+    DataModel<Cap> dm;
+    GraphWorkspace<Cap> ws;
+    std::unique_ptr<MaxFlow<Cap>> engine;
+    std::vector<uint8_t> planes;        // lent to the image of the current run
+    std::vector<bool> side;             // engine cut (graph nodes)
+    std::vector<bool> fg;               // image mask
+    GraphReduction red;
+};
@@ -1,17 +1,42 @@
 #include "Segmenter.h"
 #include "MinCut.h"
 #include <iostream>
+#include <cstdint>
 
-void Segmenter::run(Dinic& G, int W, int H, int source, int sink, const std::string& outMaskPath) {
+template <typename Cap>
+void Segmenter::run(MaxFlow<Cap>& G, int W, int H, int source, int sink, const std::string& outMaskPath,
+                    MaskFormat format) {
     std::cout << "Running maxflow..." << std::endl;
     double flow = G.max_flow(source, sink);
     std::cout << "Maxflow result: " << flow << std::endl;
 
     // get reachable set (nodes reachable from source in residual graph)
     std::vector<bool> reachable = G.minCut(source);
-    // reachable has size G.n (including source and sink). We only need first W*H
+    // reachable has one entry per node (including source and sink). We only need first W*H
     if ((int)reachable.size() < W*H) throw std::runtime_error("Segmenter: minCut size mismatch");
 
-    MinCut::writeMaskToFile(reachable, W, H, outMaskPath);
+    MinCut::writeMaskToFile(reachable, W, H, outMaskPath, format);
     std::cout << "Wrote mask to " << outMaskPath << std::endl;
 }
+
+template <typename Cap>
+void Segmenter::run(MaxFlow<Cap>& G, const GraphReduction& red, const SeedMask& seeds, const std::string& outMaskPath,
+                    MaskFormat format) {
+    const int n = red.width * red.height;
+    std::cout << "Running maxflow..." << std::endl;
+    double flow = G.max_flow(n, n + 1) + red.constantFlow;
+    std::cout << "Maxflow result: " << flow << std::endl;
+
+    std::vector<bool> reachable = G.minCut(n);
+    if ((int)reachable.size() < n) throw std::runtime_error("Segmenter: minCut size mismatch");
+
+    MinCut::writeMaskToFile(red.expand(reachable, seeds), red.W, red.H, outMaskPath, format);
+    std::cout << "Wrote mask to " << outMaskPath << std::endl;
+}
+
+template void Segmenter::run<double>(MaxFlow<double>&, int, int, int, int, const std::string&, MaskFormat);
+template void Segmenter::run<float>(MaxFlow<float>&, int, int, int, int, const std::string&, MaskFormat);
+template void Segmenter::run<int32_t>(MaxFlow<int32_t>&, int, int, int, int, const std::string&, MaskFormat);
+template void Segmenter::run<double>(MaxFlow<double>&, const GraphReduction&, const SeedMask&, const std::string&, MaskFormat);
+template void Segmenter::run<float>(MaxFlow<float>&, const GraphReduction&, const SeedMask&, const std::string&, MaskFormat);
+template void Segmenter::run<int32_t>(MaxFlow<int32_t>&, const GraphReduction&, const SeedMask&, const std::string&, MaskFormat);
@@ -1,11 +1,23 @@
 #pragma once
-#include "Dinic.h"
+#include "MaxFlow.h"
 #include "DataModel.h"
 #include "Image.h"
+#include "MaskEncoder.h"
+#include "GraphBuilder.h"
+#include "SeedMask.h"
 #include <string>
 
 class Segmenter {
 public:
-    // runs maxflow on given graph (Dinic) and writes output mask to outMaskPath (uint8 0/1 per pixel)
-    static void run(Dinic& G, int W, int H, int source, int sink, const std::string& outMaskPath);
+    // runs maxflow on given graph (any engine) and writes output mask to outMaskPath (uint8 0/1 per pixel
+    // unless another format is asked for, see MaskEncoder.h)
+    template <typename Cap>
+    static void run(MaxFlow<Cap>& G, int W, int H, int source, int sink, const std::string& outMaskPath,
+                    MaskFormat format = MaskFormat::Bytes);
+
+    // same for a graph from GraphBuilder::buildReducedGraph: the reported flow includes
+    // red.constantFlow, the mask is the full W x H image (red.expand)
+    template <typename Cap>
+    static void run(MaxFlow<Cap>& G, const GraphReduction& red, const SeedMask& seeds, const std::string& outMaskPath,
+                    MaskFormat format = MaskFormat::Bytes);
 };
@@ -0,0 +1,200 @@
+#include "SequenceSegmenter.h"
+#include "GraphBuilder.h"
+#include "Profiler.h"
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <cstdlib>
+#include <stdexcept>
+#include <algorithm>
+
+namespace {
+
+// largest squared colour distance of two RGB pixels
+constexpr int32_t MAX_DIST_SQ = 3 * 255 * 255;
+
+inline int32_t distSq(const uint8_t* a, const uint8_t* b) {
+    const int32_t dr = a[0] - b[0], dg = a[1] - b[1], db = a[2] - b[2];
+    return dr * dr + dg * dg + db * db;
+}
+
+} // namespace
+
+template <typename Cap>
+std::vector<typename SequenceSegmenter<Cap>::Frame> SequenceSegmenter<Cap>::parseFrameList(const std::string& path) {
+    std::ifstream in(path);
+    if (!in) throw std::runtime_error("Sequence: failed to open frame list " + path);
+
+    std::vector<Frame> frames;
+    std::string text;
+    for (size_t line = 1; std::getline(in, text); ++line) {
+        std::istringstream ss(text);
+        std::vector<std::string> f;
+        for (std::string tok; ss >> tok;) f.push_back(tok);
+        if (f.empty() || f[0][0] == '#') continue;
+        if (f.size() != 2 && f.size() != 3)
+            throw std::runtime_error("Sequence: frame list line " + std::to_string(line)
+                                     + ": expected frame.bin out_mask.bin [seed.bin]");
+        Frame fr;
+        fr.line = line;
+        fr.image = f[0];
+        fr.output = f[1];
+        if (f.size() == 3) fr.seeds = f[2];
+        frames.push_back(std::move(fr));
+    }
+    return frames;
+}
+
+template <typename Cap>
+SequenceSegmenter<Cap>::SequenceSegmenter(int W_, int H_, SolverType solver_, int threads_,
+                                          double lambda_, double temporal_, int tolerance_)
+    : W(W_), H(H_), N(static_cast<size_t>(W_) * H_), solver(solver_), threads(threads_),
+      lambda(lambda_), temporal(temporal_), tolerance(std::max(0, tolerance_)), pool(threads_),
+      dm(8, 1.0, 1e-9) {}
+
+template <typename Cap>
+void SequenceSegmenter<Cap>::setHardSeeds(bool fg_hard, bool bg_hard) {
+    dm.setHardSeeds(fg_hard, bg_hard);
+}
+
+template <typename Cap>
+void SequenceSegmenter<Cap>::setBins(int binsPerChannel) {
+    // the colour model of the first frame is kept for the whole sequence
+    if (graph) throw std::runtime_error("Sequence: setBins after the first frame");
+    dm.setBins(binsPerChannel);
+}
+
+// source -> pixel = cost of background, pixel -> sink = cost of foreground (see GraphBuilder),
+// the prior makes the label the pixel had in the previous frame cheaper
+template <typename Cap>
+void SequenceSegmenter<Cap>::tlinks(size_t i, uint8_t prior) {
+    const Cap p = CapacityTraits<Cap>::quantize(temporal);
+    capS[i] = dm.costsBG()[i] + (prior == 1 ? p : Cap(0));
+    capT[i] = dm.costsFG()[i] + (prior == 0 ? p : Cap(0));
+    priorOf[i] = prior;
+}
+
+template <typename Cap>
+void SequenceSegmenter<Cap>::rebuild() {
+    graph = makeGridMaxFlow<Cap>(solver, W, H, threads);
+    graph->add_grid_edges(W, H, capS.data(), capT.data(), right.data(), down.data(), pool);
+}
+
+template <typename Cap>
+void SequenceSegmenter<Cap>::firstFrame(const Image& frame, const SeedMask& seeds) {
+    dm.buildHistograms(frame, seeds, &pool);
+    dm.computeDataCosts(frame, seeds, &pool);
+
+    // one table for every distance a later frame can bring
+    beta = GraphBuilder<Cap>::computeBeta(frame, nullptr, &pool);
+    lut = GraphBuilder<Cap>::nlinkTable(lambda, beta, MAX_DIST_SQ, &pool);
+
+    const uint8_t* rgb = frame.raw();
+    refRGB.assign(rgb, rgb + N * 3);
+    refSeeds.assign(seeds.raw(), seeds.raw() + N);
+    priorOf.assign(N, NO_PRIOR);
+    labels.assign(N, 0);
+    isTouched.assign(N, 0);
+
+    capS.resize(N);
+    capT.resize(N);
+    right.resize(static_cast<size_t>(W - 1) * H);
+    down.resize(static_cast<size_t>(W) * (H - 1));
+    pool.parallelFor(0, static_cast<size_t>(H), [&](size_t y0, size_t y1, int) {
+        for (size_t y = y0; y < y1; ++y) {
+            for (int x = 0; x < W; ++x) {
+                const size_t i = y * W + x;
+                tlinks(i, NO_PRIOR);
+                if (x + 1 < W) right[y * (W - 1) + x] = lut[distSq(rgb + i * 3, rgb + (i + 1) * 3)];
+                if (static_cast<int>(y) + 1 < H) down[i] = lut[distSq(rgb + i * 3, rgb + (i + W) * 3)];
+            }
+        }
+    });
+    rebuild();
+}
+
+template <typename Cap>
+const typename SequenceSegmenter<Cap>::FrameStats& SequenceSegmenter<Cap>::segment(const Image& frame, const SeedMask* seeds) {
+    if (frame.width() != W || frame.height() != H)
+        throw std::runtime_error("Sequence: frame size does not match the sequence");
+    if (seeds && (seeds->width() != W || seeds->height() != H))
+        throw std::runtime_error("Sequence: seed mask size does not match the sequence");
+    Profiler::Scope scope("frame");
+    const auto t0 = std::chrono::steady_clock::now();
+
+    last = FrameStats();
+    if (!graph) {
+        if (!seeds) throw std::runtime_error("Sequence: the first frame needs seeds");
+        firstFrame(frame, *seeds);
+        last.changedPixels = last.tlinks = N;
+        last.nlinks = right.size() + down.size();
+    } else {
+        // frames without seeds of their own only have the prior
+        if (!seeds && !noSeeds) noSeeds.reset(new SeedMask(std::vector<int8_t>(N, -1), W, H));
+        const SeedMask& s = seeds ? *seeds : *noSeeds;
+        const uint8_t* rgb = frame.raw();
+        const int8_t* label = s.raw();
+
+        // what changed since the graph was built: colour (against the colours the graph was
+        // built from, so slow drift below the tolerance still adds up), seeds, previous label
+        touched.clear();
+        for (size_t i = 0; i < N; ++i) {
+            const uint8_t* a = rgb + i * 3;
+            uint8_t* b = refRGB.data() + i * 3;
+            const bool colour = std::abs(a[0] - b[0]) > tolerance || std::abs(a[1] - b[1]) > tolerance
+                             || std::abs(a[2] - b[2]) > tolerance;
+            if (colour) ++last.changedPixels;
+            if (colour || label[i] != refSeeds[i] || priorOf[i] != labels[i]) {
+                // the pixel takes the colour of this frame, its data cost and n-links follow
+                b[0] = a[0]; b[1] = a[1]; b[2] = a[2];
+                refSeeds[i] = label[i];
+                isTouched[i] = 1;
+                touched.push_back(static_cast<int>(i));
+            }
+        }
+        last.tlinks = touched.size();
+
+        const bool incremental = graph->supportsIncremental();
+        dm.updateDataCosts(frame, s, touched);
+        for (const int p : touched) {
+            const Cap oldS = capS[p], oldT = capT[p];
+            tlinks(p, labels[p]);
+            if (incremental) graph->add_tweights(p, capS[p] - oldS, capT[p] - oldT);
+        }
+
+        // every n-link with a touched end, each once (from its first touched end)
+        auto nlink = [&](int a, int b, Cap& w) {
+            const Cap now = lut[distSq(refRGB.data() + static_cast<size_t>(a) * 3, refRGB.data() + static_cast<size_t>(b) * 3)];
+            if (now == w) return;
+            if (incremental) graph->add_nweights(a, b, now - w);
+            w = now;
+            ++last.nlinks;
+        };
+        for (const int p : touched) {
+            const int x = p % W, y = p / W;
+            if (x + 1 < W) nlink(p, p + 1, right[static_cast<size_t>(y) * (W - 1) + x]);
+            if (x > 0 && !isTouched[p - 1]) nlink(p - 1, p, right[static_cast<size_t>(y) * (W - 1) + x - 1]);
+            if (y + 1 < H) nlink(p, p + W, down[p]);
+            if (y > 0 && !isTouched[p - W]) nlink(p - W, p, down[p - W]);
+        }
+        for (const int p : touched) isTouched[p] = 0;
+
+        last.reused = incremental;
+        if (!incremental) rebuild();
+    }
+
+    last.flow = graph->max_flow(W * H, W * H + 1);
+    const std::vector<bool> cut = graph->minCut(W * H);
+    size_t fg = 0;
+    for (size_t i = 0; i < N; ++i) {
+        labels[i] = cut[i] ? 1 : 0;
+        fg += labels[i];
+    }
+    last.foreground = fg;
+    last.ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+    return last;
+}
+
+template class SequenceSegmenter<double>;
+template class SequenceSegmenter<float>;
+template class SequenceSegmenter<int32_t>;
@@ -0,0 +1,97 @@
+#pragma once
+#include "Image.h"
+#include "SeedMask.h"
+#include "DataModel.h"
+#include "MaxFlow.h"
+#include "ThreadPool.h"
+#include <vector>
+#include <memory>
+#include <string>
+#include <cstddef>
+#include <cstdint>
+
+/*
+Frame by frame segmentation of a video / image sequence of one size, e.g. turntable shots.
+
+The first frame is segmented from its seeds like a single image. For every later frame:
+- the colour histograms and beta of the first frame are kept, so the graph of the next
+  frame only differs where the pixels differ
+- the previous mask becomes a soft seed: a pixel pays `temporal` for switching labels
+- pixels whose colour changed by more than `tolerance` (any channel), whose seed changed or
+  whose previous label flipped get new t-links (add_tweights), the n-links around the
+  changed colours get the new weights (add_nweights)
+- max_flow continues from the residual graph and search trees of the previous frame
+So after the read of the frame the work per frame follows the number of changed pixels.
+With tolerance 0 the graph is the one a rebuild from the frame would give (beta and the
+histograms of the first frame, the previous mask as prior), the warm started max_flow ends
+at the same flow and (up to ties between equally cheap cuts) the same mask as a solve of
+that graph from scratch, tests/SequenceTest checks this against Dinic.
+Engines without incremental support rebuild the graph from the kept weights every frame.
+*/
+template <typename Cap>
+class SequenceSegmenter {
+public:
+    struct Frame {
+        size_t line = 0;            // frame list line, for messages
+        std::string image, output, seeds;   // seeds: optional
+    };
+
+    struct FrameStats {
+        size_t changedPixels;       // colour changes beyond the tolerance
+        size_t tlinks;              // t-links rewritten (colour, seed or previous label changed)
+        size_t nlinks;              // n-links rewritten
+        bool reused;                // warm started from the previous frame
+        double flow;
+        size_t foreground;
+        double ms;
+    };
+
+    // frame list: "frame.bin out_mask.bin [seed.bin]" per line, '#' comments
+    static std::vector<Frame> parseFrameList(const std::string& path);
+
+    SequenceSegmenter(int W, int H, SolverType solver = SolverType::Grid, int threads = 0,
+                      double lambda = 50.0, double temporal = 2.0, int tolerance = 0);
+
+    // same meaning as DataModel::setHardSeeds
+    void setHardSeeds(bool fg_hard, bool bg_hard);
+    // colour histogram bins per channel, see DataModel::setBins (before the first frame)
+    void setBins(int binsPerChannel);
+
+    // the first call needs seeds (they pick the colour model), later ones may pass nullptr
+    const FrameStats& segment(const Image& frame, const SeedMask* seeds);
+
+    // mask of the last frame, W*H bytes 0/1
+    const std::vector<uint8_t>& mask() const { return labels; }
+
+private:
+    int W, H;
+    size_t N;
+    SolverType solver;
+    int threads;
+    double lambda;
+    double temporal;
+    int tolerance;
+    ThreadPool pool;
+
+    DataModel<Cap> dm;
+    std::unique_ptr<MaxFlow<Cap>> graph;
+    double beta = 0.0;
+    std::vector<Cap> lut;           // n-link weight by squared distance (beta of the first frame)
+    std::vector<Cap> capS, capT;    // current t-links (data cost + temporal prior)
+    std::vector<Cap> right, down;   // current n-links
+    std::vector<uint8_t> refRGB;    // colours the current graph was built from
+    std::vector<int8_t> refSeeds;   // seeds the current t-links were built from
+    std::vector<uint8_t> priorOf;   // label the prior in the current t-links favours (NO_PRIOR: none)
+    std::vector<uint8_t> labels;    // last mask (the prior of the next frame)
+    std::vector<int> touched;       // pixels with new t-links
+    std::vector<char> isTouched;
+    std::unique_ptr<SeedMask> noSeeds;
+    FrameStats last{};
+
+    static constexpr uint8_t NO_PRIOR = 2;
+
+    void firstFrame(const Image& frame, const SeedMask& seeds);
+    // data cost of pixel i plus the prior of its last label into capS/capT
+    void tlinks(size_t i, uint8_t prior);
+    void rebuild();
+};
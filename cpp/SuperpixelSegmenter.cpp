@@ -0,0 +1,171 @@
+#include "SuperpixelSegmenter.h"
+#include "Superpixels.h"
+#include "BandRefiner.h"
+#include "DataModel.h"
+#include "GraphBuilder.h"
+#include "ThreadPool.h"
+#include "Profiler.h"
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <utility>
+#include <cstdint>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+double msSince(Clock::time_point t0) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+}
+
+} // namespace
+
+template <typename Cap>
+SuperpixelSegmenter<Cap>::SuperpixelSegmenter(SolverType solver_, int threads_, int step_, int band_,
+                                              double lambda_, double compactness_, int iterations_)
+    : solver(solver_), threads(threads_), step(std::max(1, step_)), band(std::max(0, band_)), lambda(lambda_),
+      compactness(compactness_), iterations(std::max(1, iterations_)) {}
+
+template <typename Cap>
+void SuperpixelSegmenter<Cap>::setHardSeeds(bool fg_hard, bool bg_hard) {
+    fgHard = fg_hard;
+    bgHard = bg_hard;
+}
+
+template <typename Cap>
+std::vector<bool> SuperpixelSegmenter<Cap>::segment(const Image& img, const SeedMask& seeds) {
+    if (seeds.width() != img.width() || seeds.height() != img.height())
+        throw std::runtime_error("SuperpixelSegmenter: seed mask size does not match the image");
+    using Sum = typename CapacityTraits<Cap>::Sum;
+    const int W = img.width(), H = img.height();
+    const size_t N = static_cast<size_t>(W) * H;
+    st = Stats();
+    ThreadPool pool(threads);
+
+    auto t0 = Clock::now();
+    const Superpixels sp(img, step, compactness, iterations, &pool);
+    const int K = sp.count();
+    const int gw = sp.gridWidth(), gh = sp.gridHeight();
+    const int32_t* region = sp.labels().data();
+    st.superpixels = K;
+    st.slicMs = msSince(t0);
+
+    t0 = Clock::now();
+    DataModel<Cap> dm(bins, 1.0, 1e-9);
+    dm.setHardSeeds(fgHard, bgHard);
+    dm.buildHistograms(img, seeds, &pool);
+    int32_t maxDist = 0;
+    const double beta = GraphBuilder<Cap>::computeBeta(img, &maxDist, &pool);
+    const std::vector<Cap> lut = GraphBuilder<Cap>::nlinkTable(lambda, beta, maxDist, &pool);
+
+    /*
+    Region k = j * gw + i only holds pixels of cell row j and the rows around it, and a pixel
+    next to it belongs to a region at most 3 cells away: every pair of touching regions is
+    kept in one of 24 slots of the smaller id (the neighbour is to the right in the same row
+    or in one of the 3 rows below). Cell rows are done in three phases (j % 3), the tasks of
+    one phase touch disjoint regions, so there is nothing to merge and every sum is built in
+    the same order for any thread count.
+    */
+    static constexpr int SLOTS = 24;
+    std::vector<Sum> sumFG(K, Sum(0)), sumBG(K, Sum(0)), link(static_cast<size_t>(K) * SLOTS, Sum(0));
+    std::vector<uint32_t> hardFG(K, 0), hardBG(K, 0);     // hard seeded pixels per region
+    {
+        Profiler::Scope scope("superpixelGraph");
+        const uint8_t* P[3] = {img.plane(0), img.plane(1), img.plane(2)};
+        const int8_t* seed = seeds.raw();
+        auto weight = [&](size_t a, size_t b) {
+            int32_t d = 0;
+            for (int c = 0; c < 3; ++c) {
+                const int32_t diff = static_cast<int32_t>(P[c][a]) - static_cast<int32_t>(P[c][b]);
+                d += diff * diff;
+            }
+            return lut[d];
+        };
+        auto addLink = [&](int32_t a, int32_t b, size_t p, size_t q) {
+            if (a > b) std::swap(a, b);
+            const int dj = b / gw - a / gw, di = b % gw - a % gw;
+            const int slot = dj == 0 ? di - 1 : 3 + (dj - 1) * 7 + (di + 3);
+            link[static_cast<size_t>(a) * SLOTS + slot] += weight(p, q);
+        };
+        for (int phase = 0; phase < 3; ++phase) {
+            const size_t tasks = static_cast<size_t>((gh - phase + 2) / 3);
+            pool.parallelFor(0, tasks, [&](size_t t0_, size_t t1_, int) {
+                for (size_t t = t0_; t < t1_; ++t) {
+                    const int j = phase + 3 * static_cast<int>(t);
+                    for (int y = sp.rowBegin(j); y < sp.rowBegin(j + 1); ++y) {
+                        const size_t row = static_cast<size_t>(y) * W;
+                        for (int x = 0; x < W; ++x) {
+                            const size_t i = row + x;
+                            const int32_t k = region[i];
+                            const int8_t l = seed[i];
+                            if (l == 1 && fgHard) ++hardFG[k];
+                            else if (l == 0 && bgHard) ++hardBG[k];
+                            else {
+                                sumFG[k] += dm.colorCostFG(P[0][i], P[1][i], P[2][i]);
+                                sumBG[k] += dm.colorCostBG(P[0][i], P[1][i], P[2][i]);
+                            }
+                            if (x + 1 < W && region[i + 1] != k) addLink(k, region[i + 1], i, i + 1);
+                            if (y + 1 < H && region[i + W] != k) addLink(k, region[i + W], i, i + W);
+                        }
+                    }
+                }
+            });
+        }
+    }
+
+    // t-links: source -> region = background cost, region -> sink = foreground cost, minus
+    // the part both share (cut whichever side the region ends up on)
+    const int source = K, sink = K + 1;
+    std::unique_ptr<MaxFlow<Cap>> G = makeMaxFlow<Cap>(solver, K + 2, threads);
+    size_t edges = 0;
+    for (const Sum& w : link) edges += w > Sum(0);
+    G->reserve_edges(static_cast<size_t>(K) * 2 + edges);
+    const double hard = DataModel<Cap>::hardCost();
+    double shared = 0.0;
+    for (int k = 0; k < K; ++k) {
+        const double toSource = hardFG[k] * hard + CapacityTraits<Cap>::toCost(sumBG[k]);
+        const double toSink = hardBG[k] * hard + CapacityTraits<Cap>::toCost(sumFG[k]);
+        const double both = std::min(toSource, toSink);
+        shared += both;
+        G->add_edge(source, k, CapacityTraits<Cap>::quantize(toSource - both));
+        G->add_edge(k, sink, CapacityTraits<Cap>::quantize(toSink - both));
+    }
+    for (int a = 0; a < K; ++a) {
+        const int ai = a % gw, aj = a / gw;
+        for (int slot = 0; slot < SLOTS; ++slot) {
+            const Sum sum = link[static_cast<size_t>(a) * SLOTS + slot];
+            if (!(sum > Sum(0))) continue;
+            const int dj = slot < 3 ? 0 : (slot - 3) / 7 + 1;
+            const int di = slot < 3 ? slot + 1 : (slot - 3) % 7 - 3;
+            const int b = (aj + dj) * gw + ai + di;
+            const Cap w = CapacityTraits<Cap>::quantize(CapacityTraits<Cap>::toCost(sum));
+            G->add_edge(a, b, w, w);
+        }
+    }
+    st.adjacencies = edges;
+    st.graphMs = msSince(t0);
+
+    t0 = Clock::now();
+    st.flow = G->max_flow(source, sink) + shared;
+    const std::vector<bool> cut = G->minCut(source);
+    st.solveMs = msSince(t0);
+
+    std::vector<uint8_t> labels(N);
+    pool.parallelFor(0, N, [&](size_t i0, size_t i1, int) {
+        for (size_t i = i0; i < i1; ++i) labels[i] = cut[region[i]] ? 1 : 0;
+    });
+
+    if (band > 0) {
+        t0 = Clock::now();
+        BandRefiner<Cap> refiner(solver, threads, band, lambda);
+        refiner.setHardSeeds(fgHard, bgHard);
+        refiner.setBins(bins);
+        st.refinedPixels = refiner.refine(img, seeds, labels, &st.refinedFlow);
+        st.refineMs = msSince(t0);
+    }
+    return std::vector<bool>(labels.begin(), labels.end());
+}
+
+template class SuperpixelSegmenter<double>;
+template class SuperpixelSegmenter<float>;
+template class SuperpixelSegmenter<int32_t>;
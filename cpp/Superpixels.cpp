@@ -0,0 +1,203 @@
+#include "Superpixels.h"
+#include "ThreadPool.h"
+#include "Profiler.h"
+#include <immintrin.h>
+#include <algorithm>
+#include <limits>
+
+namespace {
+
+// first pixel of cell i when n pixels are split into g cells
+inline int cellBegin(int i, int n, int g) {
+    return static_cast<int>(static_cast<int64_t>(i) * n / g);
+}
+
+struct Centers {
+    std::vector<float> r, g, b, x, y;
+    explicit Centers(size_t K) : r(K), g(K), b(K), x(K), y(K) {}
+};
+
+/*
+Labels of pixels x0 .. x1-1 of row y: nearest of the candidate clusters, ties go to the
+first candidate. 8 pixels at a time, every candidate is tested against the whole chunk.
+out[x] gets the cluster, which[x - x0] its position in cand.
+*/
+void assignRun(const uint8_t* const P[3], size_t row, int y, int x0, int x1, const int* cand, int nc,
+               const Centers& c, float ws, int32_t* out, int32_t* which) {
+    int x = x0;
+#ifdef __AVX2__
+    const __m256 iota = _mm256_setr_ps(0.f, 1.f, 2.f, 3.f, 4.f, 5.f, 6.f, 7.f);
+    const __m256 vws = _mm256_set1_ps(ws);
+    for (; x + 8 <= x1; x += 8) {
+        __m256 px[3];
+        for (int ch = 0; ch < 3; ++ch)
+            px[ch] = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(P[ch] + row + x))));
+        const __m256 vx = _mm256_add_ps(_mm256_set1_ps(static_cast<float>(x)), iota);
+        const __m256 vy = _mm256_set1_ps(static_cast<float>(y));
+        __m256 best = _mm256_set1_ps(std::numeric_limits<float>::max());
+        __m256i bestK = _mm256_setzero_si256(), bestN = _mm256_setzero_si256();
+        for (int n = 0; n < nc; ++n) {
+            const int k = cand[n];
+            const __m256 dr = _mm256_sub_ps(px[0], _mm256_set1_ps(c.r[k]));
+            const __m256 dg = _mm256_sub_ps(px[1], _mm256_set1_ps(c.g[k]));
+            const __m256 db = _mm256_sub_ps(px[2], _mm256_set1_ps(c.b[k]));
+            const __m256 dx = _mm256_sub_ps(vx, _mm256_set1_ps(c.x[k]));
+            const __m256 dy = _mm256_sub_ps(vy, _mm256_set1_ps(c.y[k]));
+            const __m256 dc = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dr, dr), _mm256_mul_ps(dg, dg)), _mm256_mul_ps(db, db));
+            const __m256 ds = _mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy));
+            const __m256 d = _mm256_add_ps(dc, _mm256_mul_ps(vws, ds));
+            const __m256 closer = _mm256_cmp_ps(d, best, _CMP_LT_OQ);
+            best = _mm256_blendv_ps(best, d, closer);
+            bestK = _mm256_blendv_epi8(bestK, _mm256_set1_epi32(k), _mm256_castps_si256(closer));
+            bestN = _mm256_blendv_epi8(bestN, _mm256_set1_epi32(n), _mm256_castps_si256(closer));
+        }
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + x), bestK);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(which + (x - x0)), bestN);
+    }
+#endif
+    for (; x < x1; ++x) {
+        const size_t i = row + x;
+        float best = std::numeric_limits<float>::max();
+        int32_t bestN = 0;
+        for (int n = 0; n < nc; ++n) {
+            const int k = cand[n];
+            const float dr = P[0][i] - c.r[k], dg = P[1][i] - c.g[k], db = P[2][i] - c.b[k];
+            const float dx = x - c.x[k], dy = y - c.y[k];
+            const float d = (dr * dr + dg * dg + db * db) + ws * (dx * dx + dy * dy);
+            if (d < best) { best = d; bestN = n; }
+        }
+        out[x] = cand[bestN];
+        which[x - x0] = bestN;
+    }
+}
+
+} // namespace
+
+int Superpixels::rowBegin(int j) const {
+    if (j <= 0) return 0;
+    if (j >= gh) return H;
+    return cellBegin(j, H, gh);
+}
+
+Superpixels::Superpixels(const Image& img, int step, double compactness, int iterations, ThreadPool* pool)
+    : W(img.width()), H(img.height()) {
+    Profiler::Scope scope("slic");
+    step = std::max(1, step);
+    gw = std::max(1, (W + step / 2) / step);
+    gh = std::max(1, (H + step / 2) / step);
+    const size_t K = static_cast<size_t>(gw) * gh;
+    const size_t N = static_cast<size_t>(W) * H;
+    label.assign(N, 0);
+    Profiler::global().memory("superpixel_labels", N * sizeof(int32_t));
+    ThreadPool serial(1);
+    ThreadPool& workers = pool ? *pool : serial;
+
+    const uint8_t* P[3] = {img.plane(0), img.plane(1), img.plane(2)};
+    auto colorDist = [&](size_t a, size_t b) {
+        int d = 0;
+        for (int ch = 0; ch < 3; ++ch) {
+            const int diff = static_cast<int>(P[ch][a]) - static_cast<int>(P[ch][b]);
+            d += diff * diff;
+        }
+        return d;
+    };
+
+    // seeds: cell centres, nudged to the smallest gradient so no cluster starts on an edge
+    Centers c(K);
+    for (int j = 0; j < gh; ++j) {
+        for (int i = 0; i < gw; ++i) {
+            const int cx = (cellBegin(i, W, gw) + cellBegin(i + 1, W, gw) - 1) / 2;
+            const int cy = (cellBegin(j, H, gh) + cellBegin(j + 1, H, gh) - 1) / 2;
+            int bx = cx, by = cy, bestGrad = std::numeric_limits<int>::max();
+            for (int y = std::max(0, cy - 1); y <= std::min(H - 1, cy + 1); ++y) {
+                for (int x = std::max(0, cx - 1); x <= std::min(W - 1, cx + 1); ++x) {
+                    const size_t l = static_cast<size_t>(y) * W + std::max(0, x - 1);
+                    const size_t r = static_cast<size_t>(y) * W + std::min(W - 1, x + 1);
+                    const size_t u = static_cast<size_t>(std::max(0, y - 1)) * W + x;
+                    const size_t d = static_cast<size_t>(std::min(H - 1, y + 1)) * W + x;
+                    const int grad = colorDist(l, r) + colorDist(u, d);
+                    if (grad < bestGrad) { bestGrad = grad; bx = x; by = y; }
+                }
+            }
+            const size_t k = static_cast<size_t>(j) * gw + i;
+            const size_t p = static_cast<size_t>(by) * W + bx;
+            c.r[k] = P[0][p]; c.g[k] = P[1][p]; c.b[k] = P[2][p];
+            c.x[k] = static_cast<float>(bx); c.y[k] = static_cast<float>(by);
+        }
+    }
+
+    const float ws = static_cast<float>((compactness / step) * (compactness / step));
+    // r, g, b, x, y, count per cluster and worker
+    std::vector<int64_t> sums(static_cast<size_t>(workers.size()) * K * 6);
+    int maxCellW = 0;
+    for (int i = 0; i < gw; ++i) maxCellW = std::max(maxCellW, cellBegin(i + 1, W, gw) - cellBegin(i, W, gw));
+    iterations = std::max(1, iterations);
+    for (int it = 0; it < iterations; ++it) {
+        const bool update = it + 1 < iterations;
+        std::fill(sums.begin(), sums.end(), 0);
+        /*
+        One task per cell row, cell by cell: the 9 candidates are the same for the whole cell,
+        so the update sums go into a 9 entry accumulator that is added to the worker's sums
+        once per cell. No second pass over the labels.
+        */
+        workers.parallelFor(0, static_cast<size_t>(gh), [&](size_t j0, size_t j1, int w) {
+            int64_t* s = sums.data() + static_cast<size_t>(w) * K * 6;
+            std::vector<int32_t> which(maxCellW);
+            int cand[9];
+            for (size_t jj0 = j0; jj0 < j1; ++jj0) {
+                const int j = static_cast<int>(jj0);
+                const int y0 = cellBegin(j, H, gh), y1 = cellBegin(j + 1, H, gh);
+                for (int i = 0; i < gw; ++i) {
+                    const int x0 = cellBegin(i, W, gw), x1 = cellBegin(i + 1, W, gw);
+                    int nc = 0;
+                    for (int cj = std::max(0, j - 1); cj <= std::min(gh - 1, j + 1); ++cj)
+                        for (int ci = std::max(0, i - 1); ci <= std::min(gw - 1, i + 1); ++ci)
+                            cand[nc++] = cj * gw + ci;
+                    int64_t acc[9][6] = {};
+                    for (int y = y0; y < y1; ++y) {
+                        const size_t row = static_cast<size_t>(y) * W;
+                        assignRun(P, row, y, x0, x1, cand, nc, c, ws, label.data() + row, which.data());
+                        if (!update) continue;
+                        for (int x = x0; x < x1; ++x) {
+                            int64_t* a = acc[which[x - x0]];
+                            a[0] += P[0][row + x];
+                            a[1] += P[1][row + x];
+                            a[2] += P[2][row + x];
+                            a[3] += x - x0;
+                            a[4] += y - y0;
+                            a[5] += 1;
+                        }
+                    }
+                    if (!update) continue;
+                    for (int n = 0; n < nc; ++n) {
+                        const int64_t* a = acc[n];
+                        if (a[5] == 0) continue;
+                        int64_t* t = s + static_cast<size_t>(cand[n]) * 6;
+                        t[0] += a[0];
+                        t[1] += a[1];
+                        t[2] += a[2];
+                        t[3] += a[3] + a[5] * x0;
+                        t[4] += a[4] + a[5] * y0;
+                        t[5] += a[5];
+                    }
+                }
+            }
+        });
+        if (!update) break;
+
+        workers.parallelFor(0, K, [&](size_t k0, size_t k1, int) {
+            for (size_t k = k0; k < k1; ++k) {
+                int64_t t[6] = {0, 0, 0, 0, 0, 0};
+                for (int w = 0; w < workers.size(); ++w)
+                    for (int f = 0; f < 6; ++f) t[f] += sums[(static_cast<size_t>(w) * K + k) * 6 + f];
+                if (t[5] == 0) continue;    // empty cluster keeps its centre
+                const double inv = 1.0 / static_cast<double>(t[5]);
+                c.r[k] = static_cast<float>(t[0] * inv);
+                c.g[k] = static_cast<float>(t[1] * inv);
+                c.b[k] = static_cast<float>(t[2] * inv);
+                c.x[k] = static_cast<float>(t[3] * inv);
+                c.y[k] = static_cast<float>(t[4] * inv);
+            }
+        });
+    }
+}
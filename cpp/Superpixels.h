@@ -0,0 +1,45 @@
+#pragma once
+#include "Image.h"
+#include <vector>
+#include <cstdint>
+
+class ThreadPool;
+
+/*
+SLIC superpixels (Achanta et al.) on a regular grid, the nodes of the superpixel mode.
+
+The image is split into gridWidth x gridHeight cells of about step x step pixels, every
+cell starts one cluster at its centre (moved to the lowest colour gradient of the 3x3
+around it). Then `iterations` rounds of
+- assignment: every pixel goes to the nearest of the 9 clusters of its own and the
+  surrounding cells, distance |rgb - c_rgb|^2 + (compactness / step)^2 * |xy - c_xy|^2.
+  8 pixels per AVX2 register, cell rows split across the pool
+- update: every cluster moves to the mean colour and position of its pixels. The sums are
+  gathered in the same pass as the assignment, integers per worker added up afterwards,
+  so the labels never depend on the number of threads
+Cluster k = j * gridWidth + i only ever holds pixels of cell (i, j) and the 8 cells around
+it, so its pixels lie in rows rowBegin(j - 1) .. rowBegin(j + 2).
+Regions are not forced to be connected (no SLIC post-processing), the superpixel graph
+sums the n-links of the actual pixel pairs so a split region is still a valid node.
+Colours are RGB, not CIELAB: the planar bytes go straight into the SIMD distance.
+*/
+class Superpixels {
+public:
+    Superpixels(const Image& img, int step, double compactness = 20.0, int iterations = 5,
+                ThreadPool* pool = nullptr);
+
+    int count() const { return gw * gh; }
+    int gridWidth() const { return gw; }
+    int gridHeight() const { return gh; }
+
+    // region of every pixel, W*H entries, row major
+    const std::vector<int32_t>& labels() const { return label; }
+
+    // first pixel row of cell row j, clamped: rowBegin(j <= 0) = 0, rowBegin(j >= gridHeight) = H
+    int rowBegin(int j) const;
+
+private:
+    int W, H;
+    int gw, gh;
+    std::vector<int32_t> label;
+};
@@ -0,0 +1,129 @@
+#pragma once
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+#include <cstddef>
+#include <exception>
+
+/*
+Small fork-join thread pool.
+parallelFor splits a range into one contiguous chunk per worker and blocks until every
+chunk is done. The calling thread works on chunk 0, so a pool of size 1 spawns no threads.
+Chunk boundaries only depend on the range and the pool size, never on timing.
+The job is handed to the workers as a plain function pointer + the address of the body
+on the caller's stack (it outlives the call, parallelFor waits for every chunk), so a
+parallelFor does no heap allocation.
+An exception thrown by a chunk (on any thread) is rethrown by parallelFor once every chunk
+has finished (the one of chunk 0, else the first from a worker). So the body is never used
+after the caller's frame is gone and a worker never takes the process down.
+*/
+class ThreadPool {
+public:
+    explicit ThreadPool(int threads = 0) {
+        if (threads <= 0) threads = defaultThreads();
+        count = threads;
+        for (int i = 1; i < count; ++i) {
+            workers.emplace_back([this, i] { workerLoop(i); });
+        }
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(m);
+            stop = true;
+        }
+        wake.notify_all();
+        for (std::thread &t : workers) t.join();
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    int size() const { return count; }
+
+    static int defaultThreads() {
+        const unsigned hw = std::thread::hardware_concurrency();
+        return hw == 0 ? 1 : static_cast<int>(hw);
+    }
+
+    // fn(chunkBegin, chunkEnd, workerIndex) for every non-empty chunk of [begin, end)
+    template <typename Fn>
+    void parallelFor(size_t begin, size_t end, Fn&& fn) {
+        if (end <= begin) return;
+        const size_t total = end - begin;
+        const size_t chunk = (total + count - 1) / count;
+        auto body = [&](int w) {
+            const size_t b = begin + std::min(total, chunk * w);
+            const size_t e = begin + std::min(total, chunk * (w + 1));
+            if (b < e) fn(b, e, w);
+        };
+        if (count == 1 || total == 1) { body(0); return; }
+
+        {
+            std::lock_guard<std::mutex> lock(m);
+            job = &body;
+            run = [](const void* b, int w) { (*static_cast<const decltype(body)*>(b))(w); };
+            pending = count - 1;
+            ++generation;
+        }
+        wake.notify_all();
+        std::exception_ptr own;
+        try {
+            body(0);
+        } catch (...) {
+            own = std::current_exception();
+        }
+
+        std::exception_ptr failed;
+        {
+            std::unique_lock<std::mutex> lock(m);
+            done.wait(lock, [this] { return pending == 0; });
+            job = nullptr;
+            run = nullptr;
+            failed = own ? own : error;
+            error = nullptr;
+        }
+        if (failed) std::rethrow_exception(failed);
+    }
+
+private:
+    int count = 1;
+    std::vector<std::thread> workers;
+    std::mutex m;
+    std::condition_variable wake, done;
+    const void* job = nullptr;                  // the body of the running parallelFor
+    void (*run)(const void*, int) = nullptr;    // calls it for one worker
+    size_t generation = 0;
+    int pending = 0;
+    bool stop = false;
+    std::exception_ptr error;                   // first exception of a worker chunk
+
+    void workerLoop(int id) {
+        size_t seen = 0;
+        while (true) {
+            const void* task;
+            void (*call)(const void*, int);
+            {
+                std::unique_lock<std::mutex> lock(m);
+                wake.wait(lock, [&] { return stop || generation != seen; });
+                if (stop) return;
+                seen = generation;
+                task = job;
+                call = run;
+            }
+            std::exception_ptr failed;
+            try {
+                call(task, id);
+            } catch (...) {
+                failed = std::current_exception();
+            }
+            {
+                std::lock_guard<std::mutex> lock(m);
+                if (failed && !error) error = failed;
+                if (--pending == 0) done.notify_one();
+            }
+        }
+    }
+};
@@ -0,0 +1,280 @@
+#include "TiledSegmenter.h"
+#include "DataModel.h"
+#include "GraphBuilder.h"
+#include "MappedFile.h"
+#include "Profiler.h"
+#include <chrono>
+#include <cmath>
+#include <algorithm>
+#include <stdexcept>
+
+// smallest core tile we go down to, whatever the budget says
+static constexpr int MIN_TILE = 64;
+// largest one, keeps (tile + 2 * overlap)^2 + 2 nodes far from the int limit of the engines
+static constexpr int MAX_TILE = 16384;
+// histogram strips: row copy (3) + its planar copy (3) + seed copy (1) bytes per pixel
+static constexpr size_t STRIP_BYTES_PER_PIXEL = 7;
+
+/*
+Rough working set per tile pixel, only used to turn the memory budget into a tile size.
+Common: tile copy + planes + seeds (7 bytes), data costs and n-link planes (4 Cap).
+Grid keeps 5 Cap per pixel (4 residual planes + terminal) and ~14 bytes of search state.
+The CSR engines buffer 4 edges (2 ints + 2 Cap each), then hold 8 arcs (head, sister, Cap)
+and ~24 bytes of per-node state.
+*/
+static double workingSetPerPixel(SolverType solver, size_t capBytes) {
+    const double c = static_cast<double>(capBytes);
+    const double common = 7.0 + 4.0 * c;
+    if (solver == SolverType::Grid) return common + 5.0 * c + 14.0;
+    return common + 4.0 * (8.0 + 2.0 * c) + 8.0 * (8.0 + c) + 24.0;
+}
+
+// squared colour distance of two interleaved RGB pixels
+static inline int32_t distSq(const uint8_t* a, const uint8_t* b) {
+    const int32_t dr = a[0] - b[0], dg = a[1] - b[1], db = a[2] - b[2];
+    return dr * dr + dg * dg + db * db;
+}
+
+// copy of a region of the image (rows are contiguous in the mapping, so this is h memcpys)
+static Image cropImage(const Image& img, int x0, int y0, int w, int h) {
+    std::vector<uint8_t> px(static_cast<size_t>(w) * h * 3);
+    const uint8_t* src = img.raw();
+    for (int y = 0; y < h; ++y) {
+        const uint8_t* row = src + ((static_cast<size_t>(y0) + y) * img.width() + x0) * 3;
+        std::copy(row, row + static_cast<size_t>(w) * 3, px.begin() + static_cast<size_t>(y) * w * 3);
+    }
+    return Image(std::move(px), w, h, 3);
+}
+
+template <typename Cap>
+TiledSegmenter<Cap>::TiledSegmenter(SolverType solver_, int threads_, size_t memoryBudget, int overlap_,
+                                    int maxSweeps_, double lambda_)
+    : solver(solver_), threads(threads_), budget(memoryBudget), overlap(std::max(0, overlap_)),
+      maxSweeps(std::max(1, maxSweeps_)), lambda(lambda_), pool(threads_) {}
+
+template <typename Cap>
+void TiledSegmenter<Cap>::setHardSeeds(bool fg_hard, bool bg_hard) {
+    fgHard = fg_hard;
+    bgHard = bg_hard;
+}
+
+template <typename Cap>
+void TiledSegmenter<Cap>::segment(const Image& img, const SeedMask& seeds, const std::string& outMaskPath) {
+    if (seeds.width() != img.width() || seeds.height() != img.height())
+        throw std::runtime_error("TiledSegmenter: seed mask size does not match the image");
+    const int W = img.width();
+    run(img, [&](int x0, int y0, int w, int h) {
+        std::vector<int8_t> labels(static_cast<size_t>(w) * h);
+        for (int y = 0; y < h; ++y) {
+            const int8_t* row = seeds.raw() + (static_cast<size_t>(y0) + y) * W + x0;
+            std::copy(row, row + w, labels.begin() + static_cast<size_t>(y) * w);
+        }
+        return SeedMask(std::move(labels), w, h);
+    }, outMaskPath);
+}
+
+template <typename Cap>
+void TiledSegmenter<Cap>::segment(const Image& img, int x0, int y0, int x1, int y1, const std::string& outMaskPath) {
+    // same clamping as the rect constructor of SeedMask
+    const int W = img.width(), H = img.height();
+    x0 = std::max(0, std::min(x0, W - 1));
+    x1 = std::max(0, std::min(x1, W - 1));
+    y0 = std::max(0, std::min(y0, H - 1));
+    y1 = std::max(0, std::min(y1, H - 1));
+    if (x1 < x0) std::swap(x0, x1);
+    if (y1 < y0) std::swap(y0, y1);
+
+    run(img, [=](int rx, int ry, int w, int h) {
+        std::vector<int8_t> labels(static_cast<size_t>(w) * h);
+        for (int y = 0; y < h; ++y) {
+            const int gy = ry + y;
+            for (int x = 0; x < w; ++x) {
+                const int gx = rx + x;
+                const bool inside = gx >= x0 && gx <= x1 && gy >= y0 && gy <= y1;
+                labels[static_cast<size_t>(y) * w + x] = inside ? -1 : 0;
+            }
+        }
+        return SeedMask(std::move(labels), w, h);
+    }, outMaskPath);
+}
+
+template <typename Cap>
+double TiledSegmenter<Cap>::globalBeta(const Image& img) {
+    const int W = img.width(), H = img.height();
+    const uint8_t* px = img.raw();
+    std::vector<uint64_t> partial(pool.size(), 0);
+    pool.parallelFor(0, static_cast<size_t>(H), [&](size_t y0, size_t y1, int w) {
+        uint64_t sum = 0;
+        for (size_t y = y0; y < y1; ++y) {
+            const uint8_t* row = px + y * W * 3;
+            for (int x = 0; x + 1 < W; ++x) sum += distSq(row + 3 * x, row + 3 * x + 3);
+            if (y + 1 < static_cast<size_t>(H))
+                for (int x = 0; x < W; ++x) sum += distSq(row + 3 * x, row + 3 * (static_cast<size_t>(W) + x));
+        }
+        partial[w] = sum;
+    });
+    uint64_t sum = 0;
+    for (uint64_t s : partial) sum += s;
+    const uint64_t cnt = static_cast<uint64_t>(W - 1) * H + static_cast<uint64_t>(W) * (H - 1);
+    const double mean = (cnt > 0) ? (static_cast<double>(sum) / cnt) : 1.0;
+    return 1.0 / (2.0 * mean + 1e-9);
+}
+
+template <typename Cap>
+void TiledSegmenter<Cap>::run(const Image& img, const SeedSource& seedsOf, const std::string& outMaskPath) {
+    if (img.channels() != 3) throw std::runtime_error("TiledSegmenter: expected an RGB image");
+    const int W = img.width(), H = img.height();
+    const size_t N = static_cast<size_t>(W) * H;
+    sweepStats.clear();
+
+    // tile size: (tile + 2 * overlap)^2 pixels of working set should fit the budget
+    const double side = std::sqrt(static_cast<double>(budget) / workingSetPerPixel(solver, sizeof(Cap)));
+    tile = static_cast<int>(side) - 2 * overlap;
+    tile = std::min(std::max(tile, MIN_TILE), MAX_TILE);
+    tile = std::min(tile, std::max(W, H));
+    tilesX = (W + tile - 1) / tile;
+    tilesY = (H + tile - 1) / tile;
+    const int tiles = tilesX * tilesY;
+
+    // 1) global colour model, streamed over row strips
+    DataModel<Cap> dm(bins, 1.0, 1e-9);
+    dm.setHardSeeds(fgHard, bgHard);
+    dm.clearHistograms();
+    const size_t stripBudget = budget / (STRIP_BYTES_PER_PIXEL * static_cast<size_t>(W));
+    const int stripRows = static_cast<int>(std::min<size_t>(std::max<size_t>(stripBudget, 1), static_cast<size_t>(H)));
+    for (int y0 = 0; y0 < H; y0 += stripRows) {
+        const int rows = std::min(stripRows, H - y0);
+        const Image strip = cropImage(img, 0, y0, W, rows);
+        const SeedMask stripSeeds = seedsOf(0, y0, W, rows);
+        dm.accumulateHistograms(strip, stripSeeds, &pool);
+    }
+    dm.finishHistograms();
+
+    // 2) global beta
+    const double beta = globalBeta(img);
+
+    // 3) tiles, the mask lives in the output file
+    MappedFile out(outMaskPath, N);
+    uint8_t* mask = out.writableData();
+    const uint8_t* px = img.raw();
+    auto tileOf = [&](int x, int y) { return (y / tile) * tilesX + x / tile; };
+    std::vector<uint8_t> solved(tiles, 0), dirty(tiles, 1), next(tiles, 0);
+
+    // the 1 pixel ring just outside a tile's core, k counts every position (also the ones
+    // outside the image, fn skips nothing so the index stays stable)
+    auto forRing = [&](int t, auto&& fn) {
+        const int cx0 = (t % tilesX) * tile, cy0 = (t / tilesX) * tile;
+        const int cx1 = std::min(cx0 + tile, W), cy1 = std::min(cy0 + tile, H);
+        size_t k = 0;
+        for (int x = cx0 - 1; x <= cx1; ++x) { fn(x, cy0 - 1, k++); fn(x, cy1, k++); }
+        for (int y = cy0; y < cy1; ++y) { fn(cx0 - 1, y, k++); fn(cx1, y, k++); }
+    };
+    // what each tile's own cut said about its ring (it lies in the overlap), 2 = no guess.
+    // 4 bytes per core pixel of perimeter, small next to the tiles themselves
+    constexpr uint8_t NO_GUESS = 2;
+    std::vector<std::vector<uint8_t>> ring(tiles);
+
+    // a seam is settled when both tiles' guesses about the other side match the other
+    // side's actual labels; only then may a neighbour skip being solved again
+    auto agrees = [&](int a, int b) {
+        bool ok = true;
+        forRing(a, [&](int gx, int gy, size_t k) {
+            if (!ok || gx < 0 || gx >= W || gy < 0 || gy >= H || tileOf(gx, gy) != b) return;
+            ok = ring[a][k] != NO_GUESS && ring[a][k] == mask[static_cast<size_t>(gy) * W + gx];
+        });
+        return ok;
+    };
+
+    auto solveTile = [&](int t) -> uint64_t {
+        Profiler::Scope scope("tile");
+        const int cx0 = (t % tilesX) * tile, cy0 = (t / tilesX) * tile;
+        const int cx1 = std::min(cx0 + tile, W), cy1 = std::min(cy0 + tile, H);
+        const int ex0 = std::max(0, cx0 - overlap), ey0 = std::max(0, cy0 - overlap);
+        const int ex1 = std::min(W, cx1 + overlap), ey1 = std::min(H, cy1 + overlap);
+        const int ew = ex1 - ex0, eh = ey1 - ey0;
+
+        const Image tileImg = cropImage(img, ex0, ey0, ew, eh);
+        const SeedMask tileSeeds = seedsOf(ex0, ey0, ew, eh);
+        dm.computeDataCosts(tileImg, tileSeeds, &pool);
+        GraphBuilder<Cap> gb(tileImg, dm, lambda, solver, threads);
+        gb.setBeta(beta);
+        std::unique_ptr<MaxFlow<Cap>> G = gb.buildGraph();
+        const int source = ew * eh, sink = ew * eh + 1;
+
+        // n-links leaving the tile: the outside pixel is fixed to its current label, so the
+        // edge is cut exactly when the inside pixel takes the other one -> a t-link
+        auto fold = [&](int lx, int ly, int gx, int gy) {
+            if (gx < 0 || gx >= W || gy < 0 || gy >= H || !solved[tileOf(gx, gy)]) return;
+            const size_t p = static_cast<size_t>(ey0 + ly) * W + ex0 + lx;
+            const size_t q = static_cast<size_t>(gy) * W + gx;
+            const Cap w = CapacityTraits<Cap>::quantize(lambda * std::exp(-beta * distSq(px + 3 * p, px + 3 * q)));
+            if (mask[q]) G->add_edge(source, ly * ew + lx, w);
+            else G->add_edge(ly * ew + lx, sink, w);
+        };
+        for (int lx = 0; lx < ew; ++lx) {
+            fold(lx, 0, ex0 + lx, ey0 - 1);
+            fold(lx, eh - 1, ex0 + lx, ey1);
+        }
+        for (int ly = 0; ly < eh; ++ly) {
+            fold(0, ly, ex0 - 1, ey0 + ly);
+            fold(ew - 1, ly, ex1, ey0 + ly);
+        }
+
+        G->max_flow(source, sink);
+        const std::vector<bool> cut = G->minCut(source);
+
+        // keep the core only
+        uint64_t changed = 0;
+        for (int y = cy0; y < cy1; ++y) {
+            uint8_t* dst = mask + static_cast<size_t>(y) * W;
+            const size_t local = static_cast<size_t>(y - ey0) * ew;
+            for (int x = cx0; x < cx1; ++x) {
+                const uint8_t l = cut[local + (x - ex0)] ? 1 : 0;
+                changed += !solved[t] || dst[x] != l;
+                dst[x] = l;
+            }
+        }
+        ring[t].clear();
+        forRing(t, [&](int gx, int gy, size_t) {
+            const bool inside = gx >= ex0 && gx < ex1 && gy >= ey0 && gy < ey1;
+            ring[t].push_back(inside ? (cut[static_cast<size_t>(gy - ey0) * ew + (gx - ex0)] ? 1 : 0) : NO_GUESS);
+        });
+        solved[t] = 1;
+        return changed;
+    };
+
+    for (int sweep = 0; sweep < maxSweeps; ++sweep) {
+        if (std::find(dirty.begin(), dirty.end(), 1) == dirty.end()) break;
+        const auto t0 = std::chrono::steady_clock::now();
+        SweepStats st{0, 0, 0.0};
+
+        for (int t = 0; t < tiles; ++t) {
+            if (!dirty[t]) continue;
+            dirty[t] = 0;
+            const uint64_t changed = solveTile(t);
+            ++st.tilesSolved;
+            st.changed += changed;
+            if (changed == 0) continue;
+            // neighbours that already ran saw the old labels (or none at all) and have to run
+            // again unless the seam agrees anyway; the ones still dirty come later in this
+            // sweep and read the new labels
+            const int tx = t % tilesX, ty = t / tilesX;
+            for (int ny = std::max(0, ty - 1); ny <= std::min(tilesY - 1, ty + 1); ++ny) {
+                for (int nx = std::max(0, tx - 1); nx <= std::min(tilesX - 1, tx + 1); ++nx) {
+                    const int n = ny * tilesX + nx;
+                    if (n == t || dirty[n] || !solved[n]) continue;
+                    if (!agrees(t, n) || !agrees(n, t)) next[n] = 1;
+                }
+            }
+        }
+
+        st.ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+        sweepStats.push_back(st);
+        dirty.swap(next);
+        std::fill(next.begin(), next.end(), 0);
+    }
+}
+
+template class TiledSegmenter<double>;
+template class TiledSegmenter<float>;
+template class TiledSegmenter<int32_t>;
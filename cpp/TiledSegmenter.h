@@ -0,0 +1,80 @@
+#pragma once
+#include "Image.h"
+#include "SeedMask.h"
+#include "MaxFlow.h"
+#include "ThreadPool.h"
+#include <vector>
+#include <string>
+#include <functional>
+#include <cstddef>
+#include <cstdint>
+
+/*
+Out-of-core mode for slide scans, satellite images and anything else where the graph (or
+even the data costs) of the whole image does not fit in memory.
+
+- the colour histograms and beta are global, they are collected in one streaming pass over
+  row strips, so every tile sees the same data costs and n-link weights as a full solve
+- the image is cut into square core tiles, each tile is solved on its core plus `overlap`
+  pixels on every side. Only the core labels are kept, the overlap gives the cut context
+- boundary conditions: an n-link from the tile's outer ring to a pixel of an already solved
+  tile is folded into a t-link, pulling the ring towards the neighbour's current label
+- sweeps: a tile is solved again when a neighbour changed after the tile last looked at it,
+  until no tile changes anymore (the seams have converged) or maxSweeps is reached
+- the mask goes into a writable mapping of the output file, written tile by tile
+
+The tile size is picked from the memory budget (estimated bytes per pixel of the tile
+pipeline and engine). Mapped input/output pages are page cache the kernel can drop, they
+are not counted. Pixel indices into the full image are 64 bit everywhere; a single tile
+stays far below the int node limit of the engines.
+*/
+template <typename Cap>
+class TiledSegmenter {
+public:
+    struct SweepStats {
+        int tilesSolved;
+        uint64_t changed;       // core pixels whose label changed (a tile's first solve counts all)
+        double ms;
+    };
+
+    // memoryBudget: bytes one tile (pixels, costs, graph) may use
+    TiledSegmenter(SolverType solver = SolverType::Grid, int threads = 0,
+                   size_t memoryBudget = size_t(1) << 30, int overlap = 32,
+                   int maxSweeps = 4, double lambda = 50.0);
+
+    // same meaning as DataModel::setHardSeeds
+    void setHardSeeds(bool fg_hard, bool bg_hard);
+    // colour histogram bins per channel (8, 16 or 32), see DataModel::setBins
+    void setBins(int binsPerChannel) { bins = binsPerChannel; }
+
+    // seeds from a (normally memory mapped) seed mask, the W*H uint8 mask goes to outMaskPath
+    void segment(const Image& img, const SeedMask& seeds, const std::string& outMaskPath);
+
+    // rect mode without a W*H seed mask: outside the rectangle is background, inside unknown
+    void segment(const Image& img, int x0, int y0, int x1, int y1, const std::string& outMaskPath);
+
+    int tileSize() const { return tile; }   // core side length picked for the last run
+    int tileCount() const { return tilesX * tilesY; }
+    const std::vector<SweepStats>& stats() const { return sweepStats; }
+
+private:
+    // seeds of the region (x0, y0) .. (x0 + w - 1, y0 + h - 1)
+    using SeedSource = std::function<SeedMask(int x0, int y0, int w, int h)>;
+
+    SolverType solver;
+    int threads;
+    size_t budget;
+    int overlap;
+    int maxSweeps;
+    double lambda;
+    bool fgHard = true, bgHard = true;
+    int bins = 8;
+
+    ThreadPool pool;
+    int tile = 0, tilesX = 0, tilesY = 0;
+    std::vector<SweepStats> sweepStats;
+
+    void run(const Image& img, const SeedSource& seedsOf, const std::string& outMaskPath);
+    // beta of the whole image, same value GraphBuilder::computeBeta gives for it
+    double globalBeta(const Image& img);
+};
@@ -0,0 +1,329 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cmath>
+
+#include "Image.h"
+#include "SeedMask.h"
+#include "DataModel.h"
+#include "GraphBuilder.h"
+#include "MaxFlow.h"
+#include "MinCut.h"
+#include "MaskEncoder.h"
+#include "ThreadPool.h"
+
+// segment_bench: stage timings of the single-image pipeline on synthetic inputs, as JSON
+//
+//    ./segment_bench [--sizes vga,hd,fhd,4k,8k] [--patterns noisy,textured,thin]
+//                    [--solver=grid] [--precision=double|float|int32] [--threads N]
+//                    [--repeat N] [--json out.json] [--tmp dir] [--mask-format=bytes|bits|rle|polygons]
+//                    [--reduce] [--bins 8|16|32]
+//
+// Every input is generated from a fixed seed, so two runs (or two releases) time exactly
+// the same pixels. Each stage is timed on its own, the best of --repeat runs is reported:
+//    io_load           map the image + seed files (Image / SeedMask constructors)
+//    buildHistograms   incl. the planar copy of the image (--bins per channel, default 8)
+//    computeDataCosts
+//    computeBeta       on its own, buildGraph computes it again
+//    buildGraph        beta, n-link weights and edge insertion into the engine
+//                      (--reduce: GraphBuilder::buildReducedGraph instead of the full graph)
+//    max_flow
+//    minCut            with --reduce including GraphReduction::expand
+//    mask_write        MinCut::writeMaskToFile in the --mask-format encoding (its size: mask_bytes)
+// Progress goes to stderr, the JSON to stdout (or --json).
+
+namespace {
+
+struct SizeSpec { const char* name; int W, H; };
+const SizeSpec SIZES[] = {
+    {"vga", 640, 480}, {"hd", 1280, 720}, {"fhd", 1920, 1080}, {"4k", 3840, 2160}, {"8k", 7680, 4320}
+};
+const char* PATTERNS[] = {"noisy", "textured", "thin"};
+
+const char* STAGES[] = {
+    "io_load", "buildHistograms", "computeDataCosts", "computeBeta",
+    "buildGraph", "max_flow", "minCut", "mask_write"
+};
+constexpr int NUM_STAGES = sizeof(STAGES) / sizeof(STAGES[0]);
+
+inline uint8_t clamp8(int v) { return static_cast<uint8_t>(std::min(255, std::max(0, v))); }
+
+/*
+Synthetic scenes, generated from std::mt19937 (specified bit for bit by the standard,
+the distributions are not, so only raw draws are used):
+- noisy:    an ellipse on a background of a similar hue, heavy per-pixel noise
+- textured: stripes inside the object, a checkerboard outside, overlapping colours
+- thin:     1-3 pixel wide curves on a noisy background (long, expensive boundaries)
+Seeds: a background frame plus a few strokes, foreground strokes inside the object.
+*/
+void generate(const std::string& pattern, int W, int H, std::vector<uint8_t>& rgb, std::vector<int8_t>& seeds) {
+    std::mt19937 rng(0x5eed0000u ^ static_cast<uint32_t>(W * 31 + H) ^ static_cast<uint32_t>(pattern.size() * 977));
+    auto noise = [&](int amp) { return static_cast<int>(rng() % (2 * amp + 1)) - amp; };
+    const size_t N = static_cast<size_t>(W) * H;
+    rgb.assign(N * 3, 0);
+    seeds.assign(N, -1);
+
+    const double cx = W * 0.5, cy = H * 0.5, rx = W * 0.3, ry = H * 0.3;
+    auto inEllipse = [&](int x, int y, double scale) {
+        const double dx = (x - cx) / (rx * scale), dy = (y - cy) / (ry * scale);
+        return dx * dx + dy * dy < 1.0;
+    };
+    // thin: a family of sine curves, thickness 1..3
+    auto onCurve = [&](int x, int y) {
+        for (int k = 0; k < 6; ++k) {
+            const double base = H * (k + 1) / 7.0;
+            const double curve = base + H * 0.05 * std::sin(x * (0.004 + 0.002 * k) + k);
+            if (std::abs(y - curve) <= 0.5 + (k % 3)) return true;
+        }
+        return false;
+    };
+
+    for (int y = 0; y < H; ++y) {
+        for (int x = 0; x < W; ++x) {
+            const size_t p = static_cast<size_t>(y) * W + x;
+            uint8_t* px = &rgb[p * 3];
+            int r, g, b;
+            bool fg;
+            if (pattern == "noisy") {
+                fg = inEllipse(x, y, 1.0);
+                r = fg ? 150 : 110; g = fg ? 110 : 120; b = fg ? 90 : 130;
+                const int n = noise(45);
+                r += n + noise(10); g += n + noise(10); b += n + noise(10);
+            } else if (pattern == "textured") {
+                fg = inEllipse(x, y, 1.0);
+                if (fg) {
+                    const bool stripe = ((x + y) / 6) % 2 == 0;
+                    r = stripe ? 200 : 90; g = stripe ? 80 : 150; b = stripe ? 60 : 70;
+                } else {
+                    const bool check = ((x / 9) + (y / 9)) % 2 == 0;
+                    r = check ? 180 : 70; g = check ? 170 : 90; b = check ? 60 : 160;
+                }
+                r += noise(20); g += noise(20); b += noise(20);
+            } else {
+                fg = onCurve(x, y);
+                r = fg ? 230 : 60; g = fg ? 220 : 70; b = fg ? 90 : 80;
+                r += noise(35); g += noise(35); b += noise(35);
+            }
+            px[0] = clamp8(r); px[1] = clamp8(g); px[2] = clamp8(b);
+
+            // seeds
+            const int border = std::max(2, std::min(W, H) / 40);
+            if (x < border || y < border || x >= W - border || y >= H - border) seeds[p] = 0;
+            else if (pattern == "thin") {
+                if (fg && x % 97 < 20) seeds[p] = 1;
+                else if (!fg && x % 211 == 0) seeds[p] = 0;
+            } else {
+                if (inEllipse(x, y, 0.25) && std::abs(y - cy) < 3) seeds[p] = 1;
+                else if (inEllipse(x, y, 0.6) && std::abs(x - cx) < 2) seeds[p] = 1;
+                else if (!inEllipse(x, y, 1.3) && std::abs(y - cy) < 2) seeds[p] = 0;
+            }
+        }
+    }
+}
+
+void writeFile(const std::string& path, const void* data, size_t bytes) {
+    std::ofstream out(path, std::ios::binary);
+    out.write(static_cast<const char*>(data), static_cast<std::streamsize>(bytes));
+    if (!out) throw std::runtime_error("segment_bench: failed to write " + path);
+}
+
+std::vector<std::string> splitList(const std::string& s) {
+    std::vector<std::string> out;
+    std::stringstream ss(s);
+    for (std::string item; std::getline(ss, item, ',');) if (!item.empty()) out.push_back(item);
+    return out;
+}
+
+struct Result {
+    std::string size, pattern;
+    int W, H;
+    double ms[NUM_STAGES];
+    double flow;
+    size_t foreground;
+    size_t maskBytes;
+};
+
+using Clock = std::chrono::steady_clock;
+double msSince(Clock::time_point t0) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+}
+
+template <typename Cap>
+Result runCase(const SizeSpec& size, const std::string& pattern, SolverType solver, int threads,
+               int repeat, const std::string& tmp, MaskFormat maskFormat, bool reduce, int bins) {
+    std::vector<uint8_t> rgb;
+    std::vector<int8_t> labels;
+    generate(pattern, size.W, size.H, rgb, labels);
+    const std::string imgPath = tmp + "/segment_bench.img";
+    const std::string seedPath = tmp + "/segment_bench.seed";
+    const std::string maskPath = tmp + "/segment_bench.mask";
+    writeFile(imgPath, rgb.data(), rgb.size());
+    writeFile(seedPath, labels.data(), labels.size());
+
+    Result res{size.name, pattern, size.W, size.H, {}, 0.0, 0, 0};
+    std::fill(res.ms, res.ms + NUM_STAGES, 1e300);
+    const int W = size.W, H = size.H;
+    ThreadPool pool(threads);
+
+    for (int rep = 0; rep < repeat; ++rep) {
+        double ms[NUM_STAGES];
+        auto t = Clock::now();
+        Image img(imgPath, W, H, 3);
+        SeedMask seeds(seedPath, W, H);
+        ms[0] = msSince(t);
+
+        DataModel<Cap> dm(bins, 1.0, 1e-9);
+        t = Clock::now();
+        dm.buildHistograms(img, seeds, &pool);
+        ms[1] = msSince(t);
+
+        t = Clock::now();
+        dm.computeDataCosts(img, seeds, &pool);
+        ms[2] = msSince(t);
+
+        t = Clock::now();
+        volatile double beta = GraphBuilder<Cap>::computeBeta(img, nullptr, &pool);
+        (void)beta;
+        ms[3] = msSince(t);
+
+        t = Clock::now();
+        GraphBuilder<Cap> gb(img, dm, 50.0, solver, threads);
+        GraphReduction red;
+        std::unique_ptr<MaxFlow<Cap>> G = reduce ? gb.buildReducedGraph(seeds, 0, red) : gb.buildGraph();
+        ms[4] = msSince(t);
+
+        const int n = reduce ? red.width * red.height : W * H;
+        t = Clock::now();
+        res.flow = G->max_flow(n, n + 1) + red.constantFlow;
+        ms[5] = msSince(t);
+
+        t = Clock::now();
+        const std::vector<bool> cut = reduce ? red.expand(G->minCut(n), seeds) : G->minCut(n);
+        ms[6] = msSince(t);
+
+        t = Clock::now();
+        MinCut::writeMaskToFile(cut, W, H, maskPath, maskFormat);
+        ms[7] = msSince(t);
+
+        res.foreground = static_cast<size_t>(std::count(cut.begin(), cut.begin() + static_cast<size_t>(W) * H, true));
+        for (int s = 0; s < NUM_STAGES; ++s) res.ms[s] = std::min(res.ms[s], ms[s]);
+    }
+
+    std::remove(imgPath.c_str());
+    std::remove(seedPath.c_str());
+    if (std::FILE* f = std::fopen(maskPath.c_str(), "rb")) {
+        std::fseek(f, 0, SEEK_END);
+        res.maskBytes = static_cast<size_t>(std::ftell(f));
+        std::fclose(f);
+    }
+    std::remove(maskPath.c_str());
+    return res;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    std::vector<std::string> sizes = {"vga", "hd", "fhd", "4k", "8k"};
+    std::vector<std::string> patterns = {"noisy", "textured", "thin"};
+    SolverType solver = SolverType::Grid;
+    std::string solverName = "grid", precision = "double", jsonPath, tmp = ".", maskFormatName = "bytes";
+    MaskFormat maskFormat = MaskFormat::Bytes;
+    bool reduce = false;
+    int threads = 0, repeat = 3, bins = 8;
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        auto value = [&]() -> std::string {
+            if (i + 1 >= argc) throw std::runtime_error(arg + " requires a value");
+            return argv[++i];
+        };
+        try {
+            if (arg.rfind("--solver=", 0) == 0) { solverName = arg.substr(9); solver = parseSolverType(solverName); }
+            else if (arg.rfind("--precision=", 0) == 0) precision = arg.substr(12);
+            else if (arg.rfind("--mask-format=", 0) == 0) { maskFormatName = arg.substr(14); maskFormat = parseMaskFormat(maskFormatName); }
+            else if (arg == "--sizes") sizes = splitList(value());
+            else if (arg == "--patterns") patterns = splitList(value());
+            else if (arg == "--threads") threads = std::atoi(value().c_str());
+            else if (arg == "--repeat") repeat = std::max(1, std::atoi(value().c_str()));
+            else if (arg == "--json") jsonPath = value();
+            else if (arg == "--tmp") tmp = value();
+            else if (arg == "--reduce") reduce = true;
+            else if (arg == "--bins") bins = std::atoi(value().c_str());
+            else throw std::runtime_error("unknown option " + arg);
+        } catch (const std::exception& e) {
+            std::cerr << "segment_bench: " << e.what() << "\n";
+            return 1;
+        }
+    }
+    if (precision != "double" && precision != "float" && precision != "int32") {
+        std::cerr << "segment_bench: unknown precision " << precision << " (expected double|float|int32)\n";
+        return 1;
+    }
+    if (bins != 8 && bins != 16 && bins != 32) {
+        std::cerr << "segment_bench: --bins must be 8, 16 or 32\n";
+        return 1;
+    }
+
+    std::vector<Result> results;
+    try {
+        for (const std::string& sz : sizes) {
+            const SizeSpec* spec = nullptr;
+            for (const SizeSpec& s : SIZES) if (sz == s.name) spec = &s;
+            if (!spec) throw std::runtime_error("unknown size " + sz + " (expected vga|hd|fhd|4k|8k)");
+            for (const std::string& pat : patterns) {
+                if (std::find(std::begin(PATTERNS), std::end(PATTERNS), pat) == std::end(PATTERNS))
+                    throw std::runtime_error("unknown pattern " + pat + " (expected noisy|textured|thin)");
+                std::cerr << "segment_bench: " << sz << " " << pat << "..." << std::endl;
+                if (precision == "float") results.push_back(runCase<float>(*spec, pat, solver, threads, repeat, tmp, maskFormat, reduce, bins));
+                else if (precision == "int32") results.push_back(runCase<int32_t>(*spec, pat, solver, threads, repeat, tmp, maskFormat, reduce, bins));
+                else results.push_back(runCase<double>(*spec, pat, solver, threads, repeat, tmp, maskFormat, reduce, bins));
+            }
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "segment_bench: " << e.what() << "\n";
+        return 1;
+    }
+
+    std::ostringstream js;
+    js.precision(6);
+    js << std::fixed;
+    js << "{\n  \"benchmark\": \"segment_bench\",\n  \"version\": 1,\n"
+       << "  \"solver\": \"" << solverName << "\",\n  \"precision\": \"" << precision << "\",\n"
+       << "  \"mask_format\": \"" << maskFormatName << "\",\n"
+       << "  \"reduce\": " << (reduce ? "true" : "false") << ",\n"
+       << "  \"bins\": " << bins << ",\n"
+       << "  \"threads\": " << ThreadPool(threads).size() << ",\n  \"repeat\": " << repeat << ",\n"
+       << "  \"results\": [\n";
+    for (size_t k = 0; k < results.size(); ++k) {
+        const Result& r = results[k];
+        double total = 0.0;
+        js << "    {\"size\": \"" << r.size << "\", \"width\": " << r.W << ", \"height\": " << r.H
+           << ", \"pattern\": \"" << r.pattern << "\",\n     \"stages_ms\": {";
+        for (int s = 0; s < NUM_STAGES; ++s) {
+            // computeBeta is timed on its own but also part of buildGraph, count it once
+            if (s != 3) total += r.ms[s];
+            js << (s ? ", " : "") << "\"" << STAGES[s] << "\": " << r.ms[s];
+        }
+        js << "},\n     \"total_ms\": " << total << ", \"maxflow\": " << r.flow
+           << ", \"foreground_pixels\": " << r.foreground << ", \"mask_bytes\": " << r.maskBytes << "}" << (k + 1 < results.size() ? "," : "") << "\n";
+    }
+    js << "  ]\n}\n";
+
+    if (jsonPath.empty()) std::cout << js.str();
+    else {
+        std::ofstream out(jsonPath);
+        out << js.str();
+        if (!out) {
+            std::cerr << "segment_bench: failed to write " << jsonPath << "\n";
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -3,13 +3,38 @@
 #include <memory>
 #include <cstdlib>
 #include <fstream>
+#include <vector>
+#include <cstdint>
+#include <chrono>
+#include <utility>
+#include <cstdio>
+#include <stdexcept>
 
 #include "Image.h"
 #include "SeedMask.h"
 #include "DataModel.h"
 #include "GraphBuilder.h"
 #include "Segmenter.h"
-#include "Dinic.h"
+#include "SegmentationContext.h"
+#include "MaxFlow.h"
+#include "IncrementalSegmenter.h"
+#include "PyramidSegmenter.h"
+#include "SuperpixelSegmenter.h"
+#include "GrabCutSegmenter.h"
+#include "TiledSegmenter.h"
+#include "BatchRunner.h"
+#include "SequenceSegmenter.h"
+#include "MinCut.h"
+#include "MaskEncoder.h"
+#include "MappedFile.h"
+#include "SegmentServer.h"
+#include "ThreadPool.h"
+#include "Profiler.h"
+
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#endif
 
 // Usage:
 // 1) rectangle mode:
@@ -22,11 +47,453 @@
 //
 // Example (mask):
 //    ./segment data/cat.image.bin 640 480 mask data/cat.seed.bin data/output_mask.bin
+//
+// 3) edits mode (one seed mask per user edit, each re-solve reuses the previous residual graph):
+//    ./segment image.bin width height edits seed1.bin out1.bin [seed2.bin out2.bin ...]
+//
+// 4) server mode (binary protocol on stdin/stdout, see SegmentServer.h):
+//    ./segment --serve [--solver=grid] [--precision=...]
+//
+// 5) batch mode (one job per manifest line, see BatchRunner.h), --threads = parallel jobs:
+//    ./segment --batch manifest.txt [--solver=...] [--precision=...] [--threads N]
+//
+// 6) sequence mode (video frames of one size, each frame warm started from the previous one,
+//    see SequenceSegmenter.h). frames.txt: "frame.bin out_mask.bin [seed.bin]" per line,
+//    seed.bin of the command line seeds the first frame:
+//    ./segment frames.txt width height sequence seed.bin [--temporal W] [--tolerance N] [--solver=grid]
+//
+// Options (anywhere on the command line):
+//    --solver=dinic|bk|grid|pr   max-flow engine (default: dinic)
+//    --threads N                 worker threads for parallel stages (default: all cores)
+//    --precision=double|float|int32   capacity type of the graph (default: double)
+//    --levels N                  coarse-to-fine pyramid with N levels, rect/mask modes (default: 1 = off)
+//    --band N                    pyramid / superpixels: refine N pixels around the coarse boundary (default: 4,
+//                                superpixels: 0 = keep the superpixel mask)
+//    --superpixels S             solve a graph of SLIC superpixels of about SxS pixels, rect/mask modes (default: 0 = off)
+//    --grabcut N                 iterative GrabCut with GMM colour models, up to N iterations (default: 0 = off)
+//    --tiled                     out-of-core mode for huge images, rect/mask modes (overlapping tiles, see TiledSegmenter)
+//    --memory MB                 tiled: memory budget of one tile (default: 1024)
+//    --overlap N                 tiled: pixels of context around every tile (default: 32)
+//    --sweeps N                  tiled: at most N passes over the tiles to settle the seams (default: 4)
+//    --temporal W                sequence: cost of switching a pixel's label from the last frame (default: 2)
+//    --tolerance N               sequence: colour change per channel still treated as unchanged (default: 0 = exact)
+//    --no-reduce                 solve the full pixel graph instead of folding hard seeds / cropping (see GraphBuilder)
+//    --crop-margin N             extra pixels kept around the unknown pixels of the reduced graph (default: 0)
+//    --huge-pages                back the large per-run buffers with transparent huge pages (rect/mask modes, batch)
+//    --bins 8|16|32              colour histogram bins per channel (every mode but --grabcut, default: 8)
+//    --stats out.json            JSON summary: stage times, peak RSS, graph size, solver counters (see Profiler.h)
+//    --trace out.json            Chrome trace of the same stages (chrome://tracing, Perfetto)
+//    --mask-format=bytes|bits|rle|polygons   encoding of the output masks (default: bytes, see MaskEncoder.h)
+
+// data costs -> graph -> max-flow -> mask, with the capacity type picked at compile time
+template <typename Cap>
+static void segmentImage(const Image& img, const SeedMask& seeds, bool fg_confirm, bool bg_confirm,
+                         SolverType solver, int threads, const std::string& outMaskPath, MaskFormat format,
+                         bool reduce, int cropMargin, bool hugePages, int bins) {
+    const int W = img.width(), H = img.height();
+    SegmentationContext<Cap> ctx(solver, threads, 50.0);
+
+    // Configure whether confirmed scribbles are hard constraints
+    ctx.setHardSeeds(fg_confirm, bg_confirm);               //here we are always passing true to these constraints
+    ctx.setReduction(reduce, cropMargin);
+    ctx.setHugePages(hugePages);
+    ctx.setBins(bins);
+
+    std::cout << "Running histograms, graph and maxflow..." << std::endl;
+    const double flow = ctx.segment(img, seeds);
+    if (reduce) {
+        // hard seeds folded into the terminals, graph cropped to the unknown pixels
+        const GraphReduction& red = ctx.reduction();
+        std::cout << "Reduced graph: " << red.width << "x" << red.height << " crop at (" << red.x0 << ", " << red.y0
+                  << "), " << red.unknown << " of " << static_cast<size_t>(W) * H << " pixels unknown" << std::endl;
+    }
+    std::cout << "Maxflow result: " << flow << std::endl;
+    std::cout << "Reserved " << ctx.reservedBytes() / (1 << 20) << " MB" << (hugePages ? " (huge pages)" : "")
+              << std::endl;
+
+    MinCut::writeMaskToFile(ctx.mask(), W, H, outMaskPath, format);
+    std::cout << "Wrote mask to " << outMaskPath << std::endl;
+}
+
+// coarse-to-fine variant of segmentImage, see PyramidSegmenter
+template <typename Cap>
+static void segmentPyramid(const Image& img, const SeedMask& seeds, bool fg_confirm, bool bg_confirm,
+                           SolverType solver, int threads, int levels, int band, const std::string& outMaskPath,
+                           MaskFormat format, int bins) {
+    PyramidSegmenter<Cap> seg(solver, threads, levels, band);
+    seg.setHardSeeds(fg_confirm, bg_confirm);
+    seg.setBins(bins);
+
+    std::cout << "Running pyramid (" << levels << " levels, band " << band << ")..." << std::endl;
+    const std::vector<bool> mask = seg.segment(img, seeds);
+    for (const auto& s : seg.stats()) {
+        const size_t total = static_cast<size_t>(s.width) * s.height;
+        std::cout << "Level " << s.width << "x" << s.height << ": " << s.graphPixels << " of " << total
+                  << " pixels in the graph, maxflow " << s.flow << std::endl;
+    }
+
+    MinCut::writeMaskToFile(mask, img.width(), img.height(), outMaskPath, format);
+    std::cout << "Wrote mask to " << outMaskPath << std::endl;
+}
+
+// superpixel graph plus optional pixel refinement along its cut, see SuperpixelSegmenter
+template <typename Cap>
+static void segmentSuperpixels(const Image& img, const SeedMask& seeds, bool fg_confirm, bool bg_confirm,
+                               SolverType solver, int threads, int step, int band, const std::string& outMaskPath,
+                               MaskFormat format, int bins) {
+    SuperpixelSegmenter<Cap> seg(solver, threads, step, band);
+    seg.setHardSeeds(fg_confirm, bg_confirm);
+    seg.setBins(bins);
+
+    std::cout << "Running superpixel graph (step " << step << ", band " << band << ")..." << std::endl;
+    const std::vector<bool> mask = seg.segment(img, seeds);
+    const auto& s = seg.stats();
+    std::cout << s.superpixels << " superpixels (" << static_cast<double>(img.width()) * img.height() / s.superpixels
+              << " pixels each), " << s.adjacencies << " adjacencies, SLIC " << s.slicMs << " ms, graph "
+              << s.graphMs << " ms, maxflow " << s.flow << " in " << s.solveMs << " ms" << std::endl;
+    if (band > 0)
+        std::cout << "Refined " << s.refinedPixels << " boundary pixels, maxflow " << s.refinedFlow << " in "
+                  << s.refineMs << " ms" << std::endl;
+
+    MinCut::writeMaskToFile(mask, img.width(), img.height(), outMaskPath, format);
+    std::cout << "Wrote mask to " << outMaskPath << std::endl;
+}
+
+// GrabCut variant of segmentImage, see GrabCutSegmenter
+template <typename Cap>
+static void segmentGrabCut(const Image& img, const SeedMask& seeds, bool fg_confirm, bool bg_confirm,
+                           SolverType solver, int threads, int iterations, const std::string& outMaskPath,
+                           MaskFormat format) {
+    GrabCutSegmenter<Cap> seg(solver, threads, iterations);
+    seg.setHardSeeds(fg_confirm, bg_confirm);
+
+    std::cout << "Running GrabCut (up to " << iterations << " iterations)..." << std::endl;
+    const std::vector<bool> mask = seg.segment(img, seeds);
+    const auto& stats = seg.stats();
+    for (size_t k = 0; k < stats.size(); ++k) {
+        std::cout << "Iteration " << k << ": " << stats[k].changed << " pixels changed, "
+                  << (stats[k].reusedGraph ? "reused residual graph" : "built graph")
+                  << ", maxflow " << stats[k].flow << ", " << stats[k].ms << " ms" << std::endl;
+    }
+
+    MinCut::writeMaskToFile(mask, img.width(), img.height(), outMaskPath, format);
+    std::cout << "Wrote mask to " << outMaskPath << std::endl;
+}
+
+// out-of-core variant, see TiledSegmenter. rect mode passes the rectangle (x0 >= 0) instead
+// of a seed mask so no W*H buffer is ever allocated
+template <typename Cap>
+static void segmentTiled(const Image& img, const SeedMask* seeds, const int rect[4], bool fg_confirm, bool bg_confirm,
+                         SolverType solver, int threads, size_t memoryMB, int overlap, int sweeps,
+                         const std::string& outMaskPath, MaskFormat format, int bins) {
+    TiledSegmenter<Cap> seg(solver, threads, memoryMB << 20, overlap, sweeps);
+    seg.setHardSeeds(fg_confirm, bg_confirm);
+    seg.setBins(bins);
+
+    // the tiles write a byte mask into a mapped file, other formats are encoded from it at the end
+    const std::string bytesPath = format == MaskFormat::Bytes ? outMaskPath : outMaskPath + ".bytes";
+    std::cout << "Running tiled segmentation (" << memoryMB << " MB per tile, overlap " << overlap << ")..." << std::endl;
+    if (seeds) seg.segment(img, *seeds, bytesPath);
+    else seg.segment(img, rect[0], rect[1], rect[2], rect[3], bytesPath);
+    if (format != MaskFormat::Bytes) {
+        {
+            MappedFile bytes(bytesPath);
+            MaskEncoder::writeFile(bytes.data(), img.width(), img.height(), format, outMaskPath);
+        }
+        std::remove(bytesPath.c_str());
+    }
+
+    std::cout << seg.tileCount() << " tiles of " << seg.tileSize() << "x" << seg.tileSize() << std::endl;
+    const auto& stats = seg.stats();
+    for (size_t k = 0; k < stats.size(); ++k) {
+        std::cout << "Sweep " << k << ": " << stats[k].tilesSolved << " tiles solved, "
+                  << stats[k].changed << " pixels changed, " << stats[k].ms << " ms" << std::endl;
+    }
+    std::cout << "Wrote mask to " << outMaskPath << std::endl;
+}
+
+// --serve: stdout carries the protocol, so every log line goes to stderr instead
+template <typename Cap>
+static int serve(SolverType solver, int threads, int bins) {
+#ifdef _WIN32
+    _setmode(_fileno(stdin), _O_BINARY);
+    _setmode(_fileno(stdout), _O_BINARY);
+#endif
+    std::streambuf* coutBuf = std::cout.rdbuf(std::cerr.rdbuf());
+    SegmentServer<Cap> server(stdin, stdout, solver, threads);
+    server.setBins(bins);
+    const int code = server.run();
+    std::cout.rdbuf(coutBuf);
+    return code;
+}
+
+// --batch: every manifest job on the work-stealing workers, one summary line per job at the end
+template <typename Cap>
+static int runBatch(const std::string& manifest, SolverType solver, int threads, MaskFormat format,
+                    bool reduce, int cropMargin, bool hugePages, int bins) {
+    const auto jobs = BatchRunner<Cap>::parseManifest(manifest);
+    BatchRunner<Cap> runner(solver, threads);
+    runner.setMaskFormat(format);
+    runner.setReduction(reduce, cropMargin);
+    runner.setHugePages(hugePages);
+    runner.setBins(bins);
+    std::cout << "Running " << jobs.size() << " jobs on " << runner.workerCount() << " workers..." << std::endl;
+
+    const auto t0 = std::chrono::steady_clock::now();
+    const auto& results = runner.run(jobs);
+    const double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+    size_t failed = 0;
+    for (size_t k = 0; k < jobs.size(); ++k) {
+        const auto& job = jobs[k];
+        const auto& r = results[k];
+        std::cout << "Job " << k << " (line " << job.line << ") " << job.image << " " << job.W << "x" << job.H << " -> " << job.output << ": ";
+        if (r.ok) {
+            std::cout << "ok, maxflow " << r.flow << ", " << r.foreground << " foreground pixels, load "
+                      << r.loadMs << " ms, compute " << r.computeMs << " ms, worker " << r.worker << " ("
+                      << r.reservedBytes / (1 << 20) << " MB reserved)" << std::endl;
+        } else {
+            ++failed;
+            std::cout << "FAILED: " << r.error << std::endl;
+        }
+    }
+    std::cout << jobs.size() - failed << " of " << jobs.size() << " jobs ok in " << secs << " s ("
+              << (secs > 0 ? jobs.size() / secs : 0.0) << " jobs/s)" << std::endl;
+    return failed == 0 ? 0 : 1;
+}
+
+// frames of a video, each warm started from the previous one (see SequenceSegmenter)
+template <typename Cap>
+static void segmentSequence(const std::string& frameList, int W, int H, const std::string& firstSeeds,
+                            bool fg_confirm, bool bg_confirm, SolverType solver, int threads,
+                            double temporal, int tolerance, MaskFormat format, int bins) {
+    const auto frames = SequenceSegmenter<Cap>::parseFrameList(frameList);
+    SequenceSegmenter<Cap> seg(W, H, solver, threads, 50.0, temporal, tolerance);
+    seg.setHardSeeds(fg_confirm, bg_confirm);
+    seg.setBins(bins);
+    std::cout << "Running " << frames.size() << " frames..." << std::endl;
+
+    const auto t0 = std::chrono::steady_clock::now();
+    for (size_t k = 0; k < frames.size(); ++k) {
+        const auto& f = frames[k];
+        Image frame(f.image, W, H, 3);
+        std::unique_ptr<SeedMask> seeds;
+        if (!f.seeds.empty()) seeds.reset(new SeedMask(f.seeds, W, H));
+        else if (k == 0) seeds.reset(new SeedMask(firstSeeds, W, H));
+        const auto& s = seg.segment(frame, seeds.get());
+
+        MaskEncoder::writeFile(seg.mask().data(), W, H, format, f.output);
+
+        std::cout << "Frame " << k << " " << f.image << ": " << s.changedPixels << " pixels changed, "
+                  << s.tlinks << " t-links / " << s.nlinks << " n-links updated, "
+                  << (s.reused ? "warm start" : "full solve") << ", maxflow " << s.flow << ", "
+                  << s.foreground << " foreground pixels, " << s.ms << " ms" << std::endl;
+    }
+    const double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    std::cout << frames.size() << " frames in " << secs << " s" << std::endl;
+}
+
+// a sequence of seed masks from the same image, solved incrementally (see IncrementalSegmenter)
+template <typename Cap>
+static void segmentEdits(const Image& img, const std::vector<std::pair<std::string, std::string>>& edits,
+                         bool fg_confirm, bool bg_confirm, SolverType solver, int threads, MaskFormat format,
+                         int bins) {
+    const int W = img.width(), H = img.height();
+    IncrementalSegmenter<Cap> seg(img, solver, threads);
+    seg.setHardSeeds(fg_confirm, bg_confirm);
+    seg.setBins(bins);
+
+    for (size_t k = 0; k < edits.size(); ++k) {
+        SeedMask seeds(edits[k].first, W, H);
+        const auto t0 = std::chrono::steady_clock::now();
+        const double flow = seg.segment(seeds);
+        const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+        std::cout << "Edit " << k << ": " << seg.changedPixels() << " seed pixels changed, "
+                  << (seg.reusedGraph() ? "reused residual graph" : "full solve")
+                  << ", " << ms << " ms" << std::endl;
+        std::cout << "Maxflow result: " << flow << std::endl;
+        seg.writeMask(edits[k].second, format);
+        std::cout << "Wrote mask to " << edits[k].second << std::endl;
+    }
+}
+
+// --stats / --trace output at the end of a run (also after a failure, it shows how far we got)
+static void writeProfile(const std::string& statsPath, const std::string& tracePath) {
+    try {
+        if (!statsPath.empty()) Profiler::global().writeStats(statsPath);
+        if (!tracePath.empty()) Profiler::global().writeTrace(tracePath);
+    } catch (const std::exception &e) {
+        std::cerr << e.what() << std::endl;
+    }
+}
 
 int main(int argc, char** argv) {
-    if (argc < 7) {
-        std::cerr << "Usage:\n  Rect mode: " << argv[0] << " image.bin W H rect x0 y0 x1 y1 out_mask.bin\n"
-                  << "  Mask mode: " << argv[0] << " image.bin W H mask seed.bin out_mask.bin\n";
+    // pull out --options first so the positional layout below stays the same
+    SolverType solver = SolverType::Dinic;
+    Precision precision = Precision::Double;
+    MaskFormat maskFormat = MaskFormat::Bytes;
+    int threads = 0;
+    int levels = 1;
+    int band = 4;
+    int grabcut = 0;
+    int superpixels = 0;
+    bool tiled = false;
+    int memoryMB = 1024;
+    int overlap = 32;
+    int sweeps = 4;
+    double temporal = 2.0;
+    int tolerance = 0;
+    bool serveMode = false;
+    bool reduce = true;
+    int cropMargin = 0;
+    bool hugePages = false;
+    int bins = 8;
+    std::string batchManifest;
+    std::string solverName = "dinic", precisionName = "double";
+    std::string statsPath, tracePath;
+    std::vector<char*> positional;
+    for (int i = 0; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (i > 0 && arg.rfind("--solver=", 0) == 0) {
+            try {
+                solver = parseSolverType(arg.substr(9));
+                solverName = arg.substr(9);
+            } catch (const std::exception &e) {
+                std::cerr << e.what() << "\n";
+                return 1;
+            }
+        }
+        else if (i > 0 && arg.rfind("--precision=", 0) == 0) {
+            try {
+                precision = parsePrecision(arg.substr(12));
+                precisionName = arg.substr(12);
+            } catch (const std::exception &e) {
+                std::cerr << e.what() << "\n";
+                return 1;
+            }
+        }
+        else if (i > 0 && arg.rfind("--mask-format=", 0) == 0) {
+            try {
+                maskFormat = parseMaskFormat(arg.substr(14));
+            } catch (const std::exception &e) {
+                std::cerr << e.what() << "\n";
+                return 1;
+            }
+        }
+        else if (i > 0 && arg == "--serve") {
+            serveMode = true;
+        }
+        else if (i > 0 && arg == "--tiled") {
+            tiled = true;
+        }
+        else if (i > 0 && arg == "--no-reduce") {
+            reduce = false;
+        }
+        else if (i > 0 && arg == "--huge-pages") {
+            hugePages = true;
+        }
+        else if (i > 0 && arg == "--batch") {
+            if (i + 1 >= argc) {
+                std::cerr << "--batch requires a manifest file\n";
+                return 1;
+            }
+            batchManifest = argv[++i];
+        }
+        else if (i > 0 && arg == "--temporal") {
+            if (i + 1 >= argc) {
+                std::cerr << "--temporal requires a number\n";
+                return 1;
+            }
+            temporal = std::atof(argv[++i]);
+        }
+        else if (i > 0 && (arg == "--stats" || arg == "--trace")) {
+            if (i + 1 >= argc) {
+                std::cerr << arg << " requires an output file\n";
+                return 1;
+            }
+            (arg == "--stats" ? statsPath : tracePath) = argv[++i];
+        }
+        else if (i > 0 && arg == "--threads") {
+            if (i + 1 >= argc) {
+                std::cerr << "--threads requires a number\n";
+                return 1;
+            }
+            threads = std::atoi(argv[++i]);
+        }
+        else if (i > 0 && (arg == "--levels" || arg == "--band" || arg == "--grabcut"
+                           || arg == "--memory" || arg == "--overlap" || arg == "--sweeps"
+                           || arg == "--tolerance" || arg == "--crop-margin" || arg == "--superpixels"
+                           || arg == "--bins")) {
+            if (i + 1 >= argc) {
+                std::cerr << arg << " requires a number\n";
+                return 1;
+            }
+            const int value = std::atoi(argv[++i]);
+            if (arg == "--levels") levels = value;
+            else if (arg == "--band") band = value;
+            else if (arg == "--grabcut") grabcut = value;
+            else if (arg == "--superpixels") superpixels = value;
+            else if (arg == "--memory") memoryMB = std::max(1, value);
+            else if (arg == "--overlap") overlap = value;
+            else if (arg == "--tolerance") tolerance = value;
+            else if (arg == "--crop-margin") cropMargin = std::max(0, value);
+            else if (arg == "--bins") bins = value;
+            else sweeps = value;
+        }
+        else positional.push_back(argv[i]);
+    }
+    if (bins != 8 && bins != 16 && bins != 32) {
+        std::cerr << "--bins must be 8, 16 or 32\n";
+        return 1;
+    }
+    argc = static_cast<int>(positional.size());
+    argv = positional.data();
+
+    Profiler& prof = Profiler::global();
+    if (!statsPath.empty() || !tracePath.empty()) {
+        prof.enable();
+        prof.note("solver", solverName);
+        prof.note("precision", precisionName);
+        prof.note("threads", std::to_string(threads > 0 ? threads : ThreadPool::defaultThreads()));
+    }
+
+    if (serveMode) {
+        prof.note("mode", "serve");
+        int rc;
+        switch (precision) {
+            case Precision::Float: rc = serve<float>(solver, threads, bins); break;
+            case Precision::Int32: rc = serve<int32_t>(solver, threads, bins); break;
+            case Precision::Double:
+            default: rc = serve<double>(solver, threads, bins); break;
+        }
+        writeProfile(statsPath, tracePath);
+        return rc;
+    }
+
+    if (!batchManifest.empty()) {
+        prof.note("mode", "batch");
+        int rc = 1;
+        try {
+            switch (precision) {
+                case Precision::Float: rc = runBatch<float>(batchManifest, solver, threads, maskFormat, reduce, cropMargin, hugePages, bins); break;
+                case Precision::Int32: rc = runBatch<int32_t>(batchManifest, solver, threads, maskFormat, reduce, cropMargin, hugePages, bins); break;
+                case Precision::Double:
+                default: rc = runBatch<double>(batchManifest, solver, threads, maskFormat, reduce, cropMargin, hugePages, bins); break;
+            }
+        } catch (const std::exception &e) {
+            std::cerr << "Fatal: " << e.what() << std::endl;
+        }
+        writeProfile(statsPath, tracePath);
+        return rc;
+    }
+
+    if (argc < 6) {
+        std::cerr << "Usage:\n  Rect mode: " << argv[0] << " image.bin W H rect x0 y0 x1 y1 out_mask.bin [--solver=dinic|bk|grid|pr] [--threads N] [--precision=double|float|int32] [--levels N --band N] [--superpixels S [--band N]] [--grabcut N] [--tiled --memory MB --overlap N --sweeps N] [--mask-format=bytes|bits|rle|polygons] [--no-reduce] [--crop-margin N] [--huge-pages] [--bins 8|16|32, not with --grabcut] [--stats out.json] [--trace out.json]\n"
+                  << "  Mask mode: " << argv[0] << " image.bin W H mask seed.bin out_mask.bin [--solver=dinic|bk|grid|pr] [--threads N] [--precision=double|float|int32] [--levels N --band N] [--superpixels S [--band N]] [--grabcut N] [--tiled --memory MB --overlap N --sweeps N] [--mask-format=bytes|bits|rle|polygons] [--no-reduce] [--crop-margin N] [--huge-pages] [--bins 8|16|32, not with --grabcut] [--stats out.json] [--trace out.json]\n"
+                  << "  Edits mode: " << argv[0] << " image.bin W H edits seed1.bin out1.bin [seed2.bin out2.bin ...] [options]\n"
+                  << "  Server mode: " << argv[0] << " --serve [options]\n"
+                  << "  Batch mode: " << argv[0] << " --batch manifest.txt [options]\n"
+                  << "  Sequence mode: " << argv[0] << " frames.txt W H sequence seed.bin [--temporal W] [--tolerance N] [options]\n";
         return 1;
     }
 
@@ -36,7 +503,10 @@ int main(int argc, char** argv) {
     std::string mode = argv[4];
 
     std::unique_ptr<SeedMask> seeds;
+    int rect[4] = {-1, -1, -1, -1};
     std::string outMaskPath;
+    std::vector<std::pair<std::string, std::string>> edits;    // (seed.bin, out_mask.bin) per edit
+    std::string sequenceSeeds;                                  // sequence mode: seeds of the first frame
     bool fg_confirm = true;
     bool bg_confirm = true;
 
@@ -54,7 +524,11 @@ int main(int argc, char** argv) {
             int x1 = std::atoi(argv[7]);
             int y1 = std::atoi(argv[8]);
             outMaskPath = argv[9];
-            seeds.reset(new SeedMask(W, H, x0, y0, x1, y1));
+            if (tiled) {
+                // the tiles build their seeds from the rectangle, no full size mask
+                rect[0] = x0; rect[1] = y0; rect[2] = x1; rect[3] = y1;
+            }
+            else seeds.reset(new SeedMask(W, H, x0, y0, x1, y1));
         }
 
         else if (mode == "mask") {
@@ -69,6 +543,26 @@ int main(int argc, char** argv) {
 
         }
 
+        else if (mode == "edits") {
+            if ((argc - 5) % 2 != 0) {
+                std::cerr << "Edits mode requires pairs of seed.bin out_mask.bin\n";
+                return 1;
+            }
+            for (int i = 5; i + 1 < argc; i += 2) edits.emplace_back(argv[i], argv[i + 1]);
+            if (!solverSupportsIncremental(solver))
+                std::cerr << "Note: this solver rebuilds the graph on every edit, use --solver=bk or --solver=grid\n";
+        }
+
+        else if (mode == "sequence") {
+            if (argc < 6) {
+                std::cerr << "Sequence mode requires the seed.bin of the first frame\n";
+                return 1;
+            }
+            sequenceSeeds = argv[5];
+            if (!solverSupportsIncremental(solver))
+                std::cerr << "Note: this solver rebuilds the graph on every frame, use --solver=bk or --solver=grid\n";
+        }
+
         else if (mode == "scribbles") {
             //Not using this mode in the final version as well
 
@@ -106,29 +600,64 @@ int main(int argc, char** argv) {
             return 1;
         }
 
-        Image img(imageBin, W, H, 3);
-        DataModel dm(8, 1.0, 1e-9);
-
-        // Configure whether confirmed scribbles are hard constraints
-        dm.setHardSeeds(fg_confirm, bg_confirm);                //here we are always passing true to these constraints
-
-        std::cout << "Building histograms..." << std::endl;
-        dm.buildHistograms(img, *seeds);
-        std::cout << "Computing data costs..." << std::endl;
-        dm.computeDataCosts(img, *seeds);
+        if (!sequenceSeeds.empty()) {
+            // imageBin is the frame list here
+            prof.note("mode", "sequence");
+            prof.note("image", std::to_string(W) + "x" + std::to_string(H));
+            switch (precision) {
+                case Precision::Float:
+                    segmentSequence<float>(imageBin, W, H, sequenceSeeds, fg_confirm, bg_confirm, solver, threads, temporal, tolerance, maskFormat, bins);
+                    break;
+                case Precision::Int32:
+                    segmentSequence<int32_t>(imageBin, W, H, sequenceSeeds, fg_confirm, bg_confirm, solver, threads, temporal, tolerance, maskFormat, bins);
+                    break;
+                case Precision::Double:
+                default:
+                    segmentSequence<double>(imageBin, W, H, sequenceSeeds, fg_confirm, bg_confirm, solver, threads, temporal, tolerance, maskFormat, bins);
+                    break;
+            }
+            writeProfile(statsPath, tracePath);
+            return 0;
+        }
 
-        double lambda = 50.0;
-        GraphBuilder gb(img, dm, lambda);
-        auto Gptr = gb.buildGraph();
-        int nodes = W * H;
-        int source = nodes;
-        int sink = nodes + 1;
+        Image img(imageBin, W, H, 3);
+        prof.note("mode", !edits.empty() ? "edits" : tiled ? "tiled" : superpixels > 0 ? "superpixels" : grabcut > 0 ? "grabcut" : levels > 1 ? "pyramid" : mode);
+        prof.note("image", std::to_string(W) + "x" + std::to_string(H));
 
-        Segmenter::run(*Gptr, W, H, source, sink, outMaskPath);
+        // run the pipeline with the capacity type picked on the command line
+        auto run = [&](auto zero) {
+            using Cap = decltype(zero);
+            if (!edits.empty())
+                segmentEdits<Cap>(img, edits, fg_confirm, bg_confirm, solver, threads, maskFormat, bins);
+            else if (tiled)
+                segmentTiled<Cap>(img, seeds.get(), rect, fg_confirm, bg_confirm, solver, threads,
+                                  static_cast<size_t>(memoryMB), overlap, sweeps, outMaskPath, maskFormat, bins);
+            else if (superpixels > 0)
+                segmentSuperpixels<Cap>(img, *seeds, fg_confirm, bg_confirm, solver, threads, superpixels, band,
+                                        outMaskPath, maskFormat, bins);
+            else if (grabcut > 0) {
+                // the GMMs replace the histograms, there are no bins to pick
+                if (bins != 8) throw std::runtime_error("--bins does not apply to --grabcut (GMM colour models)");
+                segmentGrabCut<Cap>(img, *seeds, fg_confirm, bg_confirm, solver, threads, grabcut, outMaskPath, maskFormat);
+            }
+            else if (levels > 1)
+                segmentPyramid<Cap>(img, *seeds, fg_confirm, bg_confirm, solver, threads, levels, band, outMaskPath, maskFormat, bins);
+            else
+                segmentImage<Cap>(img, *seeds, fg_confirm, bg_confirm, solver, threads, outMaskPath, maskFormat,
+                                  reduce, cropMargin, hugePages, bins);
+        };
+        switch (precision) {
+            case Precision::Float: run(0.0f); break;
+            case Precision::Int32: run(int32_t(0)); break;
+            case Precision::Double:
+            default: run(0.0); break;
+        }
     } catch (const std::exception &e) {
         std::cerr << "Fatal: " << e.what() << std::endl;
+        writeProfile(statsPath, tracePath);
         return 1;
     }
 
+    writeProfile(statsPath, tracePath);
     return 0;
 }
@@ -0,0 +1,107 @@
+/*
+pybind11 module `pyreimage` on top of the C API (reimage.h).
+
+The numpy arrays are handed to libreimage as they are: the image array is referenced by
+the Session for its whole life, seeds are read and the mask is written in place. Arrays
+must already have the right dtype and be C contiguous, nothing is converted behind the
+caller's back (a silent copy of the image would defeat the point).
+
+    import numpy as np, pyreimage
+    s = pyreimage.Session(rgb, solver="grid")       # rgb: HxWx3 uint8
+    mask = s.segment(seeds)                         # seeds: HxW int8 -> HxW uint8
+    s.segment(seeds, out=mask)                      # re-solve into an existing buffer
+*/
+#include "reimage.h"
+#include <pybind11/pybind11.h>
+#include <pybind11/numpy.h>
+#include <string>
+#include <stdexcept>
+
+namespace py = pybind11;
+
+namespace {
+
+int solverFromName(const std::string& name) {
+    if (name == "dinic") return REIMAGE_DINIC;
+    if (name == "bk") return REIMAGE_BK;
+    if (name == "grid") return REIMAGE_GRID;
+    if (name == "pr") return REIMAGE_PR;
+    throw std::invalid_argument("unknown solver '" + name + "' (expected dinic, bk, grid or pr)");
+}
+
+int precisionFromName(const std::string& name) {
+    if (name == "double") return REIMAGE_DOUBLE;
+    if (name == "float") return REIMAGE_FLOAT;
+    if (name == "int32") return REIMAGE_INT32;
+    throw std::invalid_argument("unknown precision '" + name + "' (expected double, float or int32)");
+}
+
+// dtype, shape and layout check without any conversion
+void requireLayout(const py::array& a, const py::dtype& dtype, py::ssize_t H, py::ssize_t W, py::ssize_t C, const char* what) {
+    if (!a.dtype().equal(dtype))
+        throw std::invalid_argument(std::string(what) + ": wrong dtype");
+    const bool shapeOk = C ? (a.ndim() == 3 && a.shape(0) == H && a.shape(1) == W && a.shape(2) == C)
+                           : (a.ndim() == 2 && a.shape(0) == H && a.shape(1) == W);
+    if (!shapeOk) throw std::invalid_argument(std::string(what) + ": wrong shape");
+    if (!(a.flags() & py::array::c_style)) throw std::invalid_argument(std::string(what) + ": not C contiguous");
+}
+
+class Session {
+public:
+    Session(py::array rgb, const std::string& solver, const std::string& precision, int threads) : image(rgb) {
+        if (rgb.ndim() != 3) throw std::invalid_argument("image: expected an HxWx3 uint8 array");
+        H = rgb.shape(0);
+        W = rgb.shape(1);
+        requireLayout(rgb, py::dtype::of<uint8_t>(), H, W, 3, "image");
+        session = reimage_open(static_cast<const uint8_t*>(rgb.data()), static_cast<int>(W), static_cast<int>(H),
+                               solverFromName(solver), precisionFromName(precision), threads);
+        if (!session) throw std::runtime_error(reimage_last_error());
+    }
+    ~Session() { reimage_close(session); }
+    Session(const Session&) = delete;
+    Session& operator=(const Session&) = delete;
+
+    void setHardSeeds(bool fg, bool bg) {
+        if (reimage_set_hard_seeds(session, fg, bg) != 0) throw std::runtime_error(reimage_last_error());
+    }
+
+    py::array segment(py::array seeds, py::object out) {
+        requireLayout(seeds, py::dtype::of<int8_t>(), H, W, 0, "seeds");
+        py::array mask = out.is_none() ? py::array(py::array_t<uint8_t>({H, W})) : out.cast<py::array>();
+        requireLayout(mask, py::dtype::of<uint8_t>(), H, W, 0, "out");
+        if (!mask.writeable()) throw std::invalid_argument("out: read-only array");
+
+        const int8_t* s = static_cast<const int8_t*>(seeds.data());
+        uint8_t* m = static_cast<uint8_t*>(mask.mutable_data());
+        int rc;
+        {
+            py::gil_scoped_release release;   // other Python threads (the GUI) keep running
+            rc = reimage_segment(session, s, m, &lastFlow);
+        }
+        if (rc != 0) throw std::runtime_error(reimage_last_error());
+        return mask;
+    }
+
+    double flow() const { return lastFlow; }
+
+private:
+    py::array image;        // keeps the pixels alive, libreimage reads them in place
+    reimage_session* session = nullptr;
+    py::ssize_t W = 0, H = 0;
+    double lastFlow = 0.0;
+};
+
+} // namespace
+
+PYBIND11_MODULE(pyreimage, m) {
+    m.doc() = "Graph cut segmentation (libreimage) on numpy buffers, no files, no subprocess";
+
+    py::class_<Session>(m, "Session")
+        .def(py::init<py::array, const std::string&, const std::string&, int>(),
+             py::arg("image"), py::arg("solver") = "grid", py::arg("precision") = "double", py::arg("threads") = 0,
+             "image: HxWx3 uint8, C contiguous; kept by reference and must not be modified while the session lives")
+        .def("set_hard_seeds", &Session::setHardSeeds, py::arg("fg"), py::arg("bg"))
+        .def("segment", &Session::segment, py::arg("seeds"), py::arg("out") = py::none(),
+             "seeds: HxW int8 (-1 unknown, 0 bg, 1 fg); returns the HxW uint8 mask (written into `out` if given)")
+        .def_property_readonly("flow", &Session::flow, "max-flow value of the last segment() call");
+}
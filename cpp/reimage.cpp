@@ -0,0 +1,124 @@
+#include "reimage.h"
+#include "Image.h"
+#include "SeedMask.h"
+#include "IncrementalSegmenter.h"
+#include "Capacity.h"
+#include <memory>
+#include <string>
+#include <exception>
+#include <stdexcept>
+
+namespace {
+
+thread_local std::string lastError;
+
+// the capacity type is picked at runtime, the session talks to the segmenter through this
+struct SessionBase {
+    virtual ~SessionBase() = default;
+    virtual void setHardSeeds(bool fg_hard, bool bg_hard) = 0;
+    virtual double segment(const SeedMask& seeds, uint8_t* mask) = 0;
+};
+
+template <typename Cap>
+struct TypedSession : SessionBase {
+    IncrementalSegmenter<Cap> segmenter;
+    TypedSession(const Image& img, SolverType solver, int threads) : segmenter(img, solver, threads) {
+        segmenter.setRefitModel(true);     // same mask as the CLI for the same seeds, see reimage.h
+    }
+
+    void setHardSeeds(bool fg_hard, bool bg_hard) override { segmenter.setHardSeeds(fg_hard, bg_hard); }
+    double segment(const SeedMask& seeds, uint8_t* mask) override {
+        const double flow = segmenter.segment(seeds);
+        segmenter.mask(mask);
+        return flow;
+    }
+};
+
+SolverType toSolver(int solver) {
+    switch (solver) {
+        case REIMAGE_DINIC: return SolverType::Dinic;
+        case REIMAGE_BK: return SolverType::BK;
+        case REIMAGE_GRID: return SolverType::Grid;
+        case REIMAGE_PR: return SolverType::PushRelabel;
+        default: throw std::runtime_error("unknown solver " + std::to_string(solver));
+    }
+}
+
+// run fn, turn exceptions into -1 + reimage_last_error
+template <typename Fn>
+int guarded(Fn&& fn) {
+    try {
+        fn();
+        lastError.clear();
+        return 0;
+    } catch (const std::exception& e) {
+        lastError = e.what();
+    } catch (...) {
+        lastError = "unknown error";
+    }
+    return -1;
+}
+
+} // namespace
+
+struct reimage_session {
+    // the image views the caller's pixels, the segmenter keeps a reference to the image
+    Image image;
+    std::unique_ptr<SessionBase> impl;
+
+    reimage_session(const uint8_t* rgb, int width, int height) : image(rgb, width, height, 3) {}
+};
+
+extern "C" {
+
+reimage_session* reimage_open(const uint8_t* rgb, int width, int height, int solver, int precision, int threads) {
+    reimage_session* session = nullptr;
+    guarded([&] {
+        const SolverType type = toSolver(solver);
+        std::unique_ptr<reimage_session> s(new reimage_session(rgb, width, height));
+        switch (precision) {
+            case REIMAGE_DOUBLE: s->impl.reset(new TypedSession<double>(s->image, type, threads)); break;
+            case REIMAGE_FLOAT: s->impl.reset(new TypedSession<float>(s->image, type, threads)); break;
+            case REIMAGE_INT32: s->impl.reset(new TypedSession<int32_t>(s->image, type, threads)); break;
+            default: throw std::runtime_error("unknown precision " + std::to_string(precision));
+        }
+        session = s.release();
+    });
+    return session;
+}
+
+int reimage_set_hard_seeds(reimage_session* session, int fg_hard, int bg_hard) {
+    return guarded([&] {
+        if (!session) throw std::runtime_error("no session");
+        session->impl->setHardSeeds(fg_hard != 0, bg_hard != 0);
+    });
+}
+
+int reimage_segment(reimage_session* session, const int8_t* seeds, uint8_t* mask, double* flow) {
+    return guarded([&] {
+        if (!session) throw std::runtime_error("no session");
+        if (!mask) throw std::runtime_error("no mask buffer");
+        const SeedMask view(seeds, session->image.width(), session->image.height());
+        const double f = session->impl->segment(view, mask);
+        if (flow) *flow = f;
+    });
+}
+
+void reimage_close(reimage_session* session) {
+    delete session;
+}
+
+int reimage_segment_image(const uint8_t* rgb, int width, int height, const int8_t* seeds,
+                          uint8_t* mask, int solver, int precision, int threads) {
+    reimage_session* session = reimage_open(rgb, width, height, solver, precision, threads);
+    if (!session) return -1;
+    const int rc = reimage_segment(session, seeds, mask, nullptr);
+    reimage_close(session);
+    return rc;
+}
+
+const char* reimage_last_error(void) {
+    return lastError.c_str();
+}
+
+} // extern "C"
@@ -0,0 +1,69 @@
+#ifndef REIMAGE_H
+#define REIMAGE_H
+
+#include <stdint.h>
+
+/*
+C API of libreimage, the segmentation core as a shared library.
+
+For callers that already hold the pixels in memory (the GUI, Python through pyreimage,
+other languages through their FFI): no image/seed/mask files and no `segment` process.
+All buffers belong to the caller and are used in place:
+- rgb:   W*H*3 uint8, interleaved RGB, row-major; must stay alive and unchanged until
+         reimage_close (the session reads it on every call, it is never copied)
+- seeds: W*H int8 (-1 unknown, 0 background, 1 foreground), only read during the call
+- mask:  W*H uint8, filled with 0/1 (1 = foreground), same layout as the mask files
+
+A session is one image with its graph, like the --serve mode: the first reimage_segment
+builds everything, later calls rebuild the colour model from their seeds and re-solve
+incrementally from the previous cut (grid/bk) when some seeds changed. The mask is the one
+of a full run with the same seeds.
+Functions returning int give 0 on success and -1 on failure, reimage_last_error() then
+describes the failure. A session must not be used by two threads at the same time,
+different sessions are independent.
+*/
+
+#if defined(_WIN32)
+#  if defined(REIMAGE_BUILD)
+#    define REIMAGE_API __declspec(dllexport)
+#  else
+#    define REIMAGE_API __declspec(dllimport)
+#  endif
+#else
+#  define REIMAGE_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct reimage_session reimage_session;
+
+/* same engines and capacity types as --solver= / --precision= */
+enum reimage_solver { REIMAGE_DINIC = 0, REIMAGE_BK = 1, REIMAGE_GRID = 2, REIMAGE_PR = 3 };
+enum reimage_precision { REIMAGE_DOUBLE = 0, REIMAGE_FLOAT = 1, REIMAGE_INT32 = 2 };
+
+/* threads: 0 = one per hardware thread. NULL on failure */
+REIMAGE_API reimage_session* reimage_open(const uint8_t* rgb, int width, int height,
+                                          int solver, int precision, int threads);
+
+/* hard constraint for the seeded pixels (default: both hard), applies from the next segment */
+REIMAGE_API int reimage_set_hard_seeds(reimage_session* session, int fg_hard, int bg_hard);
+
+/* segment with the given seeds, writes the mask; *flow (if not NULL) gets the max-flow value */
+REIMAGE_API int reimage_segment(reimage_session* session, const int8_t* seeds, uint8_t* mask, double* flow);
+
+REIMAGE_API void reimage_close(reimage_session* session);
+
+/* one shot: open, segment, close */
+REIMAGE_API int reimage_segment_image(const uint8_t* rgb, int width, int height, const int8_t* seeds,
+                                      uint8_t* mask, int solver, int precision, int threads);
+
+/* message of the last failure on this thread ("" if none) */
+REIMAGE_API const char* reimage_last_error(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
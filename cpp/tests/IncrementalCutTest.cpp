@@ -0,0 +1,123 @@
+// Incremental BK / Grid max-flow (add_tweights, add_nweights) against a Dinic rebuild of the
+// same graph: the flow has to match and so does the cost of the returned cut, a cut that
+// only happens to have the right flow value is not a minimum cut.
+#include "MaxFlow.h"
+#include "ThreadPool.h"
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+namespace {
+
+// W x H pixel graph, integer valued capacities (exact in double)
+struct PixelGraph {
+    int W, H;
+    std::vector<double> capS, capT, right, down;
+};
+
+double cutCost(const PixelGraph& g, const std::vector<bool>& side) {
+    double cost = 0.0;
+    for (int y = 0; y < g.H; ++y) {
+        for (int x = 0; x < g.W; ++x) {
+            const int p = y * g.W + x;
+            cost += side[p] ? g.capT[p] : g.capS[p];
+            if (x + 1 < g.W && side[p] != side[p + 1]) cost += g.right[y * (g.W - 1) + x];
+            if (y + 1 < g.H && side[p] != side[p + g.W]) cost += g.down[p];
+        }
+    }
+    return cost;
+}
+
+std::unique_ptr<MaxFlow<double>> build(SolverType type, const PixelGraph& g) {
+    ThreadPool pool(1);
+    auto G = makeGridMaxFlow<double>(type, g.W, g.H, 1);
+    G->add_grid_edges(g.W, g.H, g.capS.data(), g.capT.data(), g.right.data(), g.down.data(), pool);
+    return G;
+}
+
+int failures = 0;
+
+void check(bool ok, const char* what, SolverType type, int trial, int round, double got, double want) {
+    if (ok) return;
+    ++failures;
+    std::fprintf(stderr, "FAIL %s engine %d trial %d round %d: %.17g, expected %.17g\n", what,
+                 static_cast<int>(type), trial, round, got, want);
+}
+
+// the 3 node case from the review of reuseTrees: node 2 moves from the source tree to the
+// sink tree, its source tree neighbour has to look at it again
+void switchTreesCase(SolverType type) {
+    PixelGraph g{3, 1, {3, 3, 2}, {0, 2, 2}, {2, 3}, {}};
+    auto G = build(type, g);
+    G->max_flow(3, 4);
+    G->add_tweights(2, 1, 2);
+    g.capS[2] += 1;
+    g.capT[2] += 2;
+    const double flow = G->max_flow(3, 4);
+    const double want = build(SolverType::Dinic, g)->max_flow(3, 4);
+    check(flow == want, "flow", type, -1, 0, flow, want);
+    const double cost = cutCost(g, G->minCut(3));
+    check(cost == want, "cut cost", type, -1, 0, cost, want);
+}
+
+void fuzz(SolverType type, int trials) {
+    std::mt19937 rng(12345);
+    auto pick = [&](int lo, int hi) { return std::uniform_int_distribution<int>(lo, hi)(rng); };
+    for (int trial = 0; trial < trials; ++trial) {
+        const int W = pick(1, 7), H = pick(1, 6), N = W * H;
+        PixelGraph g{W, H, std::vector<double>(N), std::vector<double>(N),
+                     std::vector<double>(static_cast<size_t>(W - 1) * H), std::vector<double>(static_cast<size_t>(W) * (H - 1))};
+        // plenty of zeros so free nodes and empty t-links show up
+        auto tcap = [&] { return pick(0, 2) == 0 ? 0.0 : static_cast<double>(pick(0, 9)); };
+        for (int p = 0; p < N; ++p) { g.capS[p] = tcap(); g.capT[p] = tcap(); }
+        for (double& c : g.right) c = pick(0, 6);
+        for (double& c : g.down) c = pick(0, 6);
+
+        auto G = build(type, g);
+        G->max_flow(N, N + 1);
+        for (int round = 0; round < 6; ++round) {
+            const int changes = pick(1, 4);
+            for (int k = 0; k < changes; ++k) {
+                const int p = pick(0, N - 1);
+                const int kind = pick(0, 2);
+                if (kind == 0) {
+                    const double s = tcap(), t = tcap();
+                    G->add_tweights(p, s - g.capS[p], t - g.capT[p]);
+                    g.capS[p] = s;
+                    g.capT[p] = t;
+                } else if (kind == 1 && p % W + 1 < W) {
+                    double& c = g.right[(p / W) * (W - 1) + p % W];
+                    const double to = pick(0, 6);
+                    G->add_nweights(p, p + 1, to - c);
+                    c = to;
+                } else if (kind == 2 && p + W < N) {
+                    double& c = g.down[p];
+                    const double to = pick(0, 6);
+                    G->add_nweights(p, p + W, to - c);
+                    c = to;
+                }
+            }
+            const double flow = G->max_flow(N, N + 1);
+            const double want = build(SolverType::Dinic, g)->max_flow(N, N + 1);
+            check(std::fabs(flow - want) < 1e-9, "flow", type, trial, round, flow, want);
+            const double cost = cutCost(g, G->minCut(N));
+            check(std::fabs(cost - want) < 1e-9, "cut cost", type, trial, round, cost, want);
+        }
+    }
+}
+
+} // namespace
+
+int main() {
+    for (SolverType type : {SolverType::BK, SolverType::Grid}) {
+        switchTreesCase(type);
+        fuzz(type, 3000);
+    }
+    if (failures) {
+        std::fprintf(stderr, "%d failures\n", failures);
+        return 1;
+    }
+    std::printf("incremental cuts ok\n");
+    return 0;
+}
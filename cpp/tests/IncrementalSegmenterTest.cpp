@@ -0,0 +1,115 @@
+// IncrementalSegmenter against a fresh segmenter:
+// - after setHardSeeds the re-solve with the same seeds has to give the flow and mask of a
+//   fresh segmenter with the new flags (same seeds, so the same colour model)
+// - with setRefitModel every edit has to give the result of a fresh run with its seeds
+//   (what the server promises the GUI)
+#include "IncrementalSegmenter.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+namespace {
+
+int failures = 0;
+
+// noisy two colour image: a reddish ellipse on a bluish background, some pixels swapped
+Image makeImage(int W, int H) {
+    std::mt19937 rng(7);
+    std::normal_distribution<double> noise(0.0, 25.0);
+    auto px = [&](double v) { return static_cast<uint8_t>(std::min(255.0, std::max(0.0, v + noise(rng)))); };
+    std::vector<uint8_t> rgb(static_cast<size_t>(W) * H * 3);
+    for (int y = 0; y < H; ++y) {
+        for (int x = 0; x < W; ++x) {
+            const double dx = (x - W / 2.0) / (W / 3.0), dy = (y - H / 2.0) / (H / 3.0);
+            const bool inside = (dx * dx + dy * dy < 1.0) != (rng() % 10 == 0);
+            uint8_t* p = &rgb[(static_cast<size_t>(y) * W + x) * 3];
+            p[0] = px(inside ? 190 : 70);
+            p[1] = px(100);
+            p[2] = px(inside ? 60 : 180);
+        }
+    }
+    return Image(std::move(rgb), W, H);
+}
+
+// fg blob in the middle, bg strip along the top and a column on the left
+std::vector<int8_t> makeSeeds(int W, int H) {
+    std::vector<int8_t> labels(static_cast<size_t>(W) * H, -1);
+    for (int y = 0; y < H; ++y) {
+        for (int x = 0; x < W; ++x) {
+            int8_t& l = labels[static_cast<size_t>(y) * W + x];
+            if (y < 3 || x < 2) l = 0;
+            else if (std::abs(x - W / 2) < 5 && std::abs(y - H / 2) < 4) l = 1;
+        }
+    }
+    return labels;
+}
+
+void check(const char* what, SolverType type, double flow, const IncrementalSegmenter<double>& inc,
+           double want, const IncrementalSegmenter<double>& fresh) {
+    const std::vector<bool> a = inc.mask(), b = fresh.mask();
+    size_t diff = 0;
+    for (size_t i = 0; i < a.size(); ++i) diff += a[i] != b[i];
+    if (std::fabs(flow - want) > 1e-9 * std::max(1.0, want) || diff) {
+        ++failures;
+        std::fprintf(stderr, "FAIL %s engine %d: flow %.17g, expected %.17g, %zu pixels differ\n",
+                     what, static_cast<int>(type), flow, want, diff);
+    }
+}
+
+void hardSeeds(SolverType type, const Image& img, const SeedMask& seeds, bool fgHard, bool bgHard) {
+    IncrementalSegmenter<double> inc(img, type, 1);
+    inc.segment(seeds);
+    inc.setHardSeeds(fgHard, bgHard);
+    const double flow = inc.segment(seeds);
+
+    IncrementalSegmenter<double> fresh(img, type, 1);
+    fresh.setHardSeeds(fgHard, bgHard);
+    const double want = fresh.segment(seeds);
+    check(fgHard ? (bgHard ? "hard 1/1" : "hard 1/0") : (bgHard ? "hard 0/1" : "hard 0/0"),
+          type, flow, inc, want, fresh);
+}
+
+// a few bg and fg strokes, every one re-solved with a refitted model
+void refit(SolverType type, const Image& img, std::vector<int8_t> labels, int W, int H) {
+    IncrementalSegmenter<double> inc(img, type, 1);
+    inc.setRefitModel(true);
+    inc.segment(SeedMask(labels, W, H));
+    for (int stroke = 0; stroke < 4; ++stroke) {
+        for (int y = 0; y < H; ++y) {
+            for (int x = 0; x < W; ++x) {
+                if (stroke == 0 && x >= W - 3) labels[static_cast<size_t>(y) * W + x] = 0;       // right column
+                if (stroke == 1 && y >= H - 2 && x < W / 2) labels[static_cast<size_t>(y) * W + x] = 0;
+                if (stroke == 2 && y == H / 2 + 6 && std::abs(x - W / 2) < 8) labels[static_cast<size_t>(y) * W + x] = 1;
+                if (stroke == 3 && y < 3 && x > W / 2) labels[static_cast<size_t>(y) * W + x] = -1; // erase
+            }
+        }
+        const SeedMask seeds(labels, W, H);
+        const double flow = inc.segment(seeds);
+        IncrementalSegmenter<double> fresh(img, type, 1);
+        const double want = fresh.segment(seeds);
+        check("refit", type, flow, inc, want, fresh);
+    }
+}
+
+} // namespace
+
+int main() {
+    const int W = 64, H = 48;
+    const Image img = makeImage(W, H);
+    const SeedMask seeds(makeSeeds(W, H), W, H);
+    for (SolverType type : {SolverType::BK, SolverType::Grid, SolverType::Dinic}) {
+        hardSeeds(type, img, seeds, false, false);
+        hardSeeds(type, img, seeds, true, false);
+        hardSeeds(type, img, seeds, false, true);
+        refit(type, img, makeSeeds(W, H), W, H);
+    }
+    if (failures) {
+        std::fprintf(stderr, "%d failures\n", failures);
+        return 1;
+    }
+    std::printf("incremental segmenter ok\n");
+    return 0;
+}
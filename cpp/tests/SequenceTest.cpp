@@ -0,0 +1,89 @@
+// Sequence mode with tolerance 0: the warm started BK / Grid frames against the same sequence
+// on Dinic, which rebuilds the graph of every frame from scratch. Flow and mask have to match.
+#include "SequenceSegmenter.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+namespace {
+
+int failures = 0;
+
+// a reddish ellipse moving over a bluish background, the noise is the same in every frame
+// so only the pixels around the ellipse change (the case the warm start is made for)
+Image makeFrame(int W, int H, int t, unsigned seed) {
+    std::mt19937 rng(seed);
+    std::normal_distribution<double> noise(0.0, 45.0);
+    auto px = [&](double v) { return static_cast<uint8_t>(std::min(255.0, std::max(0.0, v + noise(rng)))); };
+    std::vector<uint8_t> rgb(static_cast<size_t>(W) * H * 3);
+    const double cx = W / 3.0 + 1.5 * t, cy = H / 2.0 + std::sin(t * 0.7) * 3.0;
+    for (int y = 0; y < H; ++y) {
+        for (int x = 0; x < W; ++x) {
+            const double dx = (x - cx) / (W / 4.0), dy = (y - cy) / (H / 3.0);
+            const bool inside = dx * dx + dy * dy < 1.0;
+            uint8_t* p = &rgb[(static_cast<size_t>(y) * W + x) * 3];
+            p[0] = px(inside ? 200 : 80);
+            p[1] = px(110);
+            p[2] = px(inside ? 70 : 170);
+        }
+    }
+    return Image(std::move(rgb), W, H);
+}
+
+// fg in the middle of the first ellipse, bg along the border
+SeedMask makeSeeds(int W, int H) {
+    std::vector<int8_t> labels(static_cast<size_t>(W) * H, -1);
+    for (int y = 0; y < H; ++y) {
+        for (int x = 0; x < W; ++x) {
+            int8_t& l = labels[static_cast<size_t>(y) * W + x];
+            if (x < 2 || y < 2 || x >= W - 2 || y >= H - 2) l = 0;
+            else if (std::abs(x - W / 3) < 4 && std::abs(y - H / 2) < 3) l = 1;
+        }
+    }
+    return SeedMask(std::move(labels), W, H);
+}
+
+// soft: soft seeds and a strong temporal prior, so the previous mask decides more pixels
+void run(SolverType type, int W, int H, unsigned seed, int frames, bool soft) {
+    std::mt19937 rng(seed);
+    const SeedMask seeds = makeSeeds(W, H);
+    const double temporal = soft ? 30.0 : 2.0;
+    SequenceSegmenter<double> warm(W, H, type, 1, 50.0, temporal);
+    SequenceSegmenter<double> scratch(W, H, SolverType::Dinic, 1, 50.0, temporal);
+    warm.setHardSeeds(!soft, !soft);
+    scratch.setHardSeeds(!soft, !soft);
+    for (int t = 0; t < frames; ++t) {
+        const Image frame = makeFrame(W, H, t, seed);
+        // every third frame a few random strokes of its own
+        std::vector<int8_t> strokes(static_cast<size_t>(W) * H, -1);
+        for (int k = 0; k < 6; ++k) strokes[rng() % strokes.size()] = static_cast<int8_t>(rng() % 2);
+        const SeedMask later(std::move(strokes), W, H);
+        const SeedMask* s = t == 0 ? &seeds : (t % 3 == 0 ? &later : nullptr);
+        const auto a = warm.segment(frame, s);
+        const auto b = scratch.segment(frame, s);
+        size_t diff = 0;
+        for (size_t i = 0; i < warm.mask().size(); ++i) diff += warm.mask()[i] != scratch.mask()[i];
+        if (std::fabs(a.flow - b.flow) > 1e-7 * std::max(1.0, b.flow) || diff) {
+            ++failures;
+            std::fprintf(stderr, "FAIL engine %d %dx%d seed %u frame %d: flow %.17g, expected %.17g, %zu pixels differ\n",
+                         static_cast<int>(type), W, H, seed, t, a.flow, b.flow, diff);
+        }
+    }
+}
+
+} // namespace
+
+int main() {
+    for (SolverType type : {SolverType::BK, SolverType::Grid}) {
+        for (unsigned seed = 1; seed <= 60; ++seed) run(type, 10 + seed % 17, 8 + seed % 11, seed, 20, seed % 2 == 0);
+    }
+    if (failures) {
+        std::fprintf(stderr, "%d failures\n", failures);
+        return 1;
+    }
+    std::printf("sequence frames ok\n");
+    return 0;
+}
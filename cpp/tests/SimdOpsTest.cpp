@@ -0,0 +1,179 @@
+// simd::exp_pd_avx2 / log_pd_avx2 against std::exp / std::log (the error bounds and special
+// values documented in SimdOps.h), and the n-link planes of GraphBuilder against the scalar
+// lambda * exp(-beta * d).
+#include "SimdOps.h"
+#include "GraphBuilder.h"
+#include "DataModel.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+namespace {
+
+int failures = 0;
+
+void fail(const char* what, double x, double got, double want) {
+    ++failures;
+    std::fprintf(stderr, "FAIL %s(%.17g): %.17g, expected %.17g\n", what, x, got, want);
+}
+
+// -ffast-math may fold std::isnan / std::isinf away, look at the bits instead
+uint64_t bitsOf(double v) {
+    uint64_t b;
+    std::memcpy(&b, &v, sizeof(b));
+    return b;
+}
+bool isNaN(double v) { return (bitsOf(v) & 0x7FFFFFFFFFFFFFFFULL) > 0x7FF0000000000000ULL; }
+bool isPosInf(double v) { return bitsOf(v) == 0x7FF0000000000000ULL; }
+bool isNegInf(double v) { return bitsOf(v) == 0xFFF0000000000000ULL; }
+
+double relErr(double got, double want) {
+    return want == 0.0 ? std::fabs(got) : std::fabs(got - want) / std::fabs(want);
+}
+
+#ifdef __AVX2__
+
+double simdExp(double x) {
+    double out[4];
+    _mm256_storeu_pd(out, simd::exp_pd_avx2(_mm256_set1_pd(x)));
+    return out[0];
+}
+
+double simdLog(double x) {
+    double out[4];
+    _mm256_storeu_pd(out, simd::log_pd_avx2(_mm256_set1_pd(x)));
+    return out[0];
+}
+
+// every lane on its own input, the largest relative error of the batch
+template <typename Kernel, typename Ref>
+double maxErr(const std::vector<double>& xs, Kernel kernel, Ref ref, const char* what, double bound) {
+    double worst = 0.0;
+    for (size_t i = 0; i + 4 <= xs.size(); i += 4) {
+        double out[4];
+        _mm256_storeu_pd(out, kernel(_mm256_loadu_pd(&xs[i])));
+        for (int k = 0; k < 4; ++k) {
+            const double want = ref(xs[i + k]);
+            const double e = relErr(out[k], want);
+            if (!(e <= bound)) fail(what, xs[i + k], out[k], want);
+            worst = std::max(worst, e);
+        }
+    }
+    return worst;
+}
+
+void testExp() {
+    std::mt19937_64 rng(1);
+    std::vector<double> xs;
+    std::uniform_real_distribution<double> wide(-708.0, 709.78), narrow(-1.0, 1.0);
+    for (int i = 0; i < 1 << 20; ++i) xs.push_back(wide(rng));
+    for (int i = 0; i < 1 << 18; ++i) xs.push_back(narrow(rng));
+    // the n-link range: exp(-beta * d) for d up to 3 * 255^2
+    for (int d = 0; d <= 3 * 255 * 255; d += 7) xs.push_back(-1e-4 * d);
+    xs.push_back(709.782712893384);
+    xs.push_back(-708.0);
+    while (xs.size() % 4) xs.push_back(0.0);
+    // documented: 1 ulp measured, allow 2.2e-16 plus rounding of the comparison
+    const double worst = maxErr(xs, simd::exp_pd_avx2, [](double x) { return std::exp(x); }, "exp", 2.3e-16);
+    std::printf("exp: max relative error %.3g over %zu inputs\n", worst, xs.size());
+
+    if (simdExp(0.0) != 1.0) fail("exp", 0.0, simdExp(0.0), 1.0);
+    for (double x : {-708.5, -745.2, -1000.0, -1e300, -HUGE_VAL})
+        if (simdExp(x) != 0.0) fail("exp underflow", x, simdExp(x), 0.0);
+    for (double x : {709.79, 710.0, 1000.0, 1e300, HUGE_VAL})
+        if (!isPosInf(simdExp(x))) fail("exp overflow", x, simdExp(x), HUGE_VAL);
+}
+
+void testLog() {
+    std::mt19937_64 rng(2);
+    std::vector<double> xs;
+    // every binade of the normal range, and a dense sweep around 1 and the probabilities
+    std::uniform_real_distribution<double> mant(1.0, 2.0), unit(0.5, 2.0), prob(0.0, 1.0);
+    for (int i = 0; i < 1 << 20; ++i) xs.push_back(std::ldexp(mant(rng), static_cast<int>(rng() % 2046) - 1022));
+    for (int i = 0; i < 1 << 18; ++i) xs.push_back(unit(rng));
+    for (int i = 0; i < 1 << 18; ++i) xs.push_back(prob(rng) + 1e-9);
+    xs.push_back(DBL_MAX);
+    xs.push_back(DBL_MIN);
+    while (xs.size() % 4) xs.push_back(1.0);
+    // documented: below 5e-16 (2 ulp) for normal x > 0, relative to |log x|
+    const double worst = maxErr(xs, simd::log_pd_avx2, [](double x) { return std::log(x); }, "log", 5e-16);
+    std::printf("log: max relative error %.3g over %zu inputs\n", worst, xs.size());
+
+    if (simdLog(1.0) != 0.0) fail("log", 1.0, simdLog(1.0), 0.0);
+    for (double x : {0.0, -0.0, 1e-310, DBL_MIN / 4})
+        if (!isNegInf(simdLog(x))) fail("log zero / denormal", x, simdLog(x), -HUGE_VAL);
+    for (double x : {-1.0, -DBL_MIN, -1e300, -HUGE_VAL})
+        if (!isNaN(simdLog(x))) fail("log negative", x, simdLog(x), std::nan(""));
+}
+
+#endif
+
+// right / down planes against lambda * exp(-beta * |Ip - Iq|^2) from the interleaved pixels
+void testNlinks() {
+    const int W = 157, H = 61;      // odd sizes: the 8 pixel blocks end in a remainder
+    std::mt19937 rng(3);
+    std::vector<uint8_t> rgb(static_cast<size_t>(W) * H * 3);
+    for (auto& v : rgb) v = static_cast<uint8_t>(rng() % 256);
+    // some flat areas so small distances show up as well
+    for (int y = 10; y < 30; ++y)
+        for (int x = 20; x < 90; ++x)
+            for (int c = 0; c < 3; ++c) rgb[(static_cast<size_t>(y) * W + x) * 3 + c] = static_cast<uint8_t>(100 + (x + y) % 3);
+    const Image img(std::move(rgb), W, H);
+    const uint8_t* px = img.raw();
+
+    const double lambda = 50.0;
+    DataModel<double> dm(8, 1.0, 1e-9);
+    GraphBuilder<double> gb(img, dm, lambda, SolverType::Grid, 1);
+    int32_t maxDist = 0;
+    const double beta = GraphBuilder<double>::computeBeta(img, &maxDist);
+    std::vector<double> right, down;
+    gb.nlinkWeights(beta, maxDist, right, down);
+
+    auto want = [&](size_t p, size_t q) {
+        double d = 0.0;
+        for (int c = 0; c < 3; ++c) {
+            const double diff = static_cast<double>(px[p * 3 + c]) - px[q * 3 + c];
+            d += diff * diff;
+        }
+        return lambda * std::exp(-beta * d);
+    };
+    double worst = 0.0;
+    for (int y = 0; y < H; ++y) {
+        for (int x = 0; x < W; ++x) {
+            const size_t p = static_cast<size_t>(y) * W + x;
+            if (x + 1 < W) {
+                const double got = right[static_cast<size_t>(y) * (W - 1) + x], w = want(p, p + 1);
+                worst = std::max(worst, relErr(got, w));
+                if (relErr(got, w) > 1e-15) fail("right n-link", static_cast<double>(p), got, w);
+            }
+            if (y + 1 < H) {
+                const double got = down[p], w = want(p, p + W);
+                worst = std::max(worst, relErr(got, w));
+                if (relErr(got, w) > 1e-15) fail("down n-link", static_cast<double>(p), got, w);
+            }
+        }
+    }
+    std::printf("n-links: max relative error %.3g\n", worst);
+}
+
+} // namespace
+
+int main() {
+#ifdef __AVX2__
+    testExp();
+    testLog();
+#else
+    std::printf("no AVX2, exp/log kernels skipped\n");
+#endif
+    testNlinks();
+    if (failures) {
+        std::fprintf(stderr, "%d failures\n", failures);
+        return 1;
+    }
+    std::printf("simd ops ok\n");
+    return 0;
+}
@@ -0,0 +1,62 @@
+// ThreadPool::parallelFor with throwing chunks: the exception reaches the caller after every
+// chunk is done (on the calling thread and on the workers) and the pool keeps working.
+#include "ThreadPool.h"
+#include <atomic>
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+int failures = 0;
+
+void fail(const std::string& what) {
+    ++failures;
+    std::fprintf(stderr, "FAIL %s\n", what.c_str());
+}
+
+// chunk `thrower` throws, the others count how many of them ran to the end
+void throwingChunk(ThreadPool& pool, int thrower) {
+    std::atomic<int> finished{0};
+    const int chunks = pool.size();
+    try {
+        pool.parallelFor(0, static_cast<size_t>(chunks), [&](size_t, size_t, int w) {
+            if (w == thrower) throw std::runtime_error("chunk " + std::to_string(w));
+            // keep the other chunks busy so they are still running when the throw happens
+            volatile double x = 0.0;
+            for (int i = 0; i < 2000000; ++i) x = x + 1.0;
+            ++finished;
+        });
+        fail("no exception from chunk " + std::to_string(thrower));
+    } catch (const std::runtime_error& e) {
+        if (e.what() != "chunk " + std::to_string(thrower)) fail(std::string("wrong exception ") + e.what());
+    }
+    if (finished != chunks - 1) fail("parallelFor returned before every chunk was done");
+}
+
+} // namespace
+
+int main() {
+    ThreadPool pool(4);
+    for (int thrower = 0; thrower < pool.size(); ++thrower) throwingChunk(pool, thrower);
+
+    // still usable afterwards, no stale exception left behind
+    std::atomic<long> sum{0};
+    pool.parallelFor(0, 1000, [&](size_t b, size_t e, int) {
+        for (size_t i = b; i < e; ++i) sum += static_cast<long>(i);
+    });
+    if (sum != 999L * 1000 / 2) fail("sum after the exceptions: " + std::to_string(sum.load()));
+
+    ThreadPool serial(1);
+    try {
+        serial.parallelFor(0, 10, [](size_t, size_t, int) { throw std::runtime_error("serial"); });
+        fail("no exception from a pool of size 1");
+    } catch (const std::runtime_error&) {}
+
+    if (failures) {
+        std::fprintf(stderr, "%d failures\n", failures);
+        return 1;
+    }
+    std::printf("thread pool ok\n");
+    return 0;
+}
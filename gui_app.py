@@ -1,10 +1,9 @@
 #!/usr/bin/env python3
 
 import json
-import os
+import struct
 import subprocess
 import sys
-import tempfile
 from pathlib import Path
 
 import cv2
@@ -30,52 +29,115 @@ from PyQt6.QtWidgets import (
     QWidget,
 )
 
+try:
+    # in-process segmentation through libreimage (cpp/pyreimage.cpp), built when pybind11 is installed
+    import pyreimage
+except ImportError:
+    pyreimage = None
+
+
+class SegmentServerClient:
+    """
+    Talks to one long-lived `segment --serve` process (protocol: cpp/SegmentServer.h)
+    The image goes over once per session, after that every run only ships the seeds,
+    so no process startup and no temp files per click
+    """
+
+    IMAGE, SEEDS, STROKE, QUIT = 1, 2, 3, 4
+
+    def __init__(self, exe_path, solver="grid"):
+        # grid/bk re-solve incrementally from the previous cut
+        self.proc = subprocess.Popen(
+            [exe_path, "--serve", f"--solver={solver}"],
+            stdin=subprocess.PIPE,
+            stdout=subprocess.PIPE,
+            stderr=subprocess.DEVNULL,
+        )
+
+    def _read_exact(self, n):
+        data = b""
+        while len(data) < n:
+            chunk = self.proc.stdout.read(n - len(data))
+            if not chunk:
+                raise RuntimeError("segmentation server exited")
+            data += chunk
+        return data
+
+    def _request(self, kind, payload=b""):
+        # every message: uint32 type/status, uint32 length, payload (little-endian)
+        self.proc.stdin.write(struct.pack("<II", kind, len(payload)))
+        self.proc.stdin.write(payload)
+        self.proc.stdin.flush()
+        status, length = struct.unpack("<II", self._read_exact(8))
+        body = self._read_exact(length)
+        if status != 0:
+            raise RuntimeError(body.decode(errors="replace"))
+        return body
+
+    def load_image(self, rgb):
+        """rgb: HxWx3 uint8 array, starts a new session on the server"""
+        H, W = rgb.shape[:2]
+        self._request(self.IMAGE, struct.pack("<II", W, H) + np.ascontiguousarray(rgb).tobytes())
+
+    def segment(self, labels):
+        """labels: HxW int8 (-1 unknown, 0 bg, 1 fg) -> HxW uint8 mask (1 = fg)"""
+        body = self._request(self.SEEDS, labels.astype(np.int8).tobytes())
+        return np.frombuffer(body, dtype=np.uint8).reshape(labels.shape)
+
+    def close(self):
+        try:
+            self._request(self.QUIT)
+            self.proc.wait(timeout=5)
+        except Exception:
+            self.proc.kill()
+
+
+class InProcessClient:
+    """
+    Same interface as SegmentServerClient, but the segmentation runs inside this process:
+    libreimage reads the numpy image and seeds in place and writes the mask into our
+    own buffer, no pipe and no copies
+    """
+
+    def __init__(self, solver="grid"):
+        self.solver = solver
+        self.session = None
+
+    def load_image(self, rgb):
+        """rgb: HxWx3 uint8 array, kept alive by the session"""
+        self.rgb = np.ascontiguousarray(rgb, dtype=np.uint8)
+        self.session = pyreimage.Session(self.rgb, solver=self.solver)
+        self.mask = np.empty(self.rgb.shape[:2], dtype=np.uint8)
+
+    def segment(self, labels):
+        """labels: HxW int8 (-1 unknown, 0 bg, 1 fg) -> HxW uint8 mask (1 = fg)"""
+        self.session.segment(np.ascontiguousarray(labels, dtype=np.int8), out=self.mask)
+        return self.mask.copy()
+
+    def close(self):
+        self.session = None
+
 
 class SegmentationWorker(QThread):
     """
     BG worker thread - so the UI doesn't freeze like my laptop during a Teams call
-    Runs the C++ segmentation binary and returns back
+    Hands the seeds to the segmentation client and keeps the returned mask in memory
     """
 
     finished = pyqtSignal(bool, str)
     progress = pyqtSignal(str)
 
-    def __init__(self, exe_path, image_path, width, height, seed_path, output_path):
+    def __init__(self, client, labels):
         super().__init__()
-        self.exe_path = exe_path
-        self.image_path = image_path
-        self.width = width
-        self.height = height
-        self.seed_path = seed_path
-        self.output_path = output_path
+        self.client = client
+        self.labels = labels
+        self.mask = None
 
     def run(self):
         try:
             self.progress.emit("Running segmentation...")
-            # run segment.exe image.bin W H mask seed.bin out_mask.bin
-            cmd = [
-                self.exe_path,
-                self.image_path,
-                str(self.width),
-                str(self.height),
-                "mask",
-                self.seed_path,
-                self.output_path,
-            ]
-
-            result = subprocess.run(
-                cmd,
-                capture_output=True,
-                text=True,
-                timeout=60,  # Give it a minute max, ain't got all day
-            )
-
-            if result.returncode == 0:
-                self.finished.emit(True, "Segmentation completed successfully!")
-            else:
-                self.finished.emit(False, f"Error: {result.stderr}")
-        except subprocess.TimeoutExpired:
-            self.finished.emit(False, "Segmentation timed out")
+            self.mask = self.client.segment(self.labels)
+            self.finished.emit(True, "Segmentation completed successfully!")
         except Exception as e:
             self.finished.emit(False, f"Error: {str(e)}")
 
@@ -244,7 +306,8 @@ class MainWindow(QMainWindow):
         self.setGeometry(100, 100, 1200, 800)
 
         self.image_path = None
-        self.temp_dir = tempfile.mkdtemp()  # Throwaway dir for binary files
+        self.server = None  # pyreimage session or segment --serve process, started with the first image
+        self.mask = None  # HxW uint8 result of the last segmentation
 
         # Find the C++ executable (depends on if we're bundled or running as dev)
         if getattr(sys, "frozen", False):
@@ -374,11 +437,29 @@ class MainWindow(QMainWindow):
         if file_path:
             if self.canvas.load_image(file_path):
                 self.image_path = file_path
+                try:
+                    self.start_session(file_path)
+                except Exception as e:
+                    QMessageBox.critical(self, "Error", f"Failed to start segmentation server: {str(e)}")
+                    return
                 self.segment_btn.setEnabled(True)
                 self.statusBar().showMessage(f"Loaded: {Path(file_path).name}")
             else:
                 QMessageBox.critical(self, "Error", "Failed to load image")
 
+    def start_session(self, image_path):
+        """Send the image to the server once, it stays resident until the next image"""
+        if self.server is None:
+            # in-process when the bindings are there, the --serve process otherwise
+            self.server = InProcessClient() if pyreimage is not None else SegmentServerClient(self.cpp_exe)
+        rgb = np.array(Image.open(image_path).convert("RGB"), dtype=np.uint8)
+        self.server.load_image(rgb)
+
+    def closeEvent(self, event):
+        if self.server is not None:
+            self.server.close()
+        super().closeEvent(event)
+
     def set_brush_mode(self, mode):
         """Toggle between fg/bg brush"""
         self.canvas.brush_mode = mode
@@ -390,7 +471,7 @@ class MainWindow(QMainWindow):
 
     def run_segmentation(self):
         """
-        The main event - run the segment.exe
+        The main event - ask the segment server for a new cut
         """
         if not self.image_path:
             return
@@ -411,24 +492,15 @@ class MainWindow(QMainWindow):
             img = Image.open(self.image_path)
             W, H = img.size
 
-            # Convert img to raw binary format 
-            image_bin = os.path.join(self.temp_dir, "image.bin")
-            self.export_image_binary(self.image_path, image_bin, W, H)
-
-            # Convert scribbles to seed mask
-            seed_bin = os.path.join(self.temp_dir, "seed.bin")
-            self.export_seed_mask(seed_bin, W, H)
-
-            output_bin = os.path.join(self.temp_dir, "output_mask.bin")
+            # Convert scribbles to seed labels (the image is already on the server)
+            labels = self.build_seed_labels(W, H)
 
             # Fire up the worker thread (keeps UI responsive)
             self.segment_btn.setEnabled(False)
             self.progress_bar.setVisible(True)
             self.progress_bar.setRange(0, 0)  # Indeterminate mode - spinny spinner
 
-            self.worker = SegmentationWorker(
-                self.cpp_exe, image_bin, W, H, seed_bin, output_bin
-            )
+            self.worker = SegmentationWorker(self.server, labels)
             self.worker.finished.connect(self.on_segmentation_finished)
             self.worker.progress.connect(self.statusBar().showMessage)
             self.worker.start()
@@ -438,23 +510,17 @@ class MainWindow(QMainWindow):
             self.segment_btn.setEnabled(True)
             self.progress_bar.setVisible(False)
 
-    def export_image_binary(self, image_path, output_path, W, H):
-        """Dump image as raw RGB bytes - C++ doesn't do PIL"""
-        img = Image.open(image_path).convert("RGB")
-        data = np.array(img, dtype=np.uint8)
-        data.tofile(output_path)
-
-    def export_seed_mask(self, output_path, W, H):
+    def build_seed_labels(self, W, H):
         """
-        Create seed mask from scribbles
-        128 = unknown (most of the image)
-        255 = foreground seed (green scribbles)
+        Create seed labels from scribbles (int8, what SeedMask expects)
+        -1 = unknown (most of the image)
+        1 = foreground seed (green scribbles)
         0 = background seed (red scribbles)
         """
         # Start with everything unknown
-        mask = np.full((H, W), 128, dtype=np.uint8)
+        mask = np.full((H, W), -1, dtype=np.int8)
 
-        # Paint foreground scribbles as 255
+        # Paint foreground scribbles as 1
         for x, y in self.canvas.fg_scribbles:
             if 0 <= x < W and 0 <= y < H:
                 # Draw a filled circle around each point 
@@ -468,7 +534,7 @@ class MainWindow(QMainWindow):
                         ):
                             px, py = x + dx, y + dy
                             if 0 <= px < W and 0 <= py < H:
-                                mask[py, px] = 255
+                                mask[py, px] = 1
 
         # Paint background scribbles as 0
         for x, y in self.canvas.bg_scribbles:
@@ -485,7 +551,7 @@ class MainWindow(QMainWindow):
                             if 0 <= px < W and 0 <= py < H:
                                 mask[py, px] = 0
 
-        mask.tofile(output_path)
+        return mask
 
     def on_segmentation_finished(self, success, message):
         """Worker thread is done - time to see if it worked or not"""
@@ -493,6 +559,7 @@ class MainWindow(QMainWindow):
         self.segment_btn.setEnabled(True)
 
         if success:
+            self.mask = self.worker.mask
             self.statusBar().showMessage(message)
             self.save_btn.setEnabled(True)
 
@@ -512,12 +579,8 @@ class MainWindow(QMainWindow):
 
     def display_result(self):
         """Show the segmentation result with a nice green overlay"""
-        output_mask = os.path.join(self.temp_dir, "output_mask.bin")
         img = Image.open(self.image_path)
-        W, H = img.size
-
-        # Load the mask from binary file
-        mask = np.fromfile(output_mask, dtype=np.uint8).reshape((H, W))
+        mask = self.mask
 
         # Blend original image with green tint where mask = 1
         img_arr = np.array(img)
@@ -557,11 +620,9 @@ class MainWindow(QMainWindow):
             return
     
         try:
-            output_mask = os.path.join(self.temp_dir, "output_mask.bin")
             img = Image.open(self.image_path).convert("RGB")
             W, H = img.size
-    
-            mask = np.fromfile(output_mask, dtype=np.uint8).reshape((H, W))
+            mask = self.mask
     
             img_arr = np.array(img)
             rgba = np.zeros((H, W, 4), dtype=np.uint8)
@@ -15,6 +15,7 @@ a = Analysis(
         'PyQt6.QtWidgets',
         'numpy',
         'PIL',
+        'pyreimage',  # optional, in-process segmentation when built
     ],
     hookspath=[],
     hooksconfig={},